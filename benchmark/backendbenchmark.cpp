@@ -0,0 +1,172 @@
+/**
+ * @file backendbenchmark.cpp
+ * @brief 数字分类器各后端的准确率和耗时
+ * @details 在同一组带标签的数字图像上依次加载各后端的模型, 输出准确率、单张和成批推理时单张图像的耗时以及加载耗时,
+ * 用于在给定的机器上挑选满足准确率要求的最便宜的后端. 图像的类别按 darknet 的规则从图像目录下的相对路径中读取,
+ * 路径中出现的最后一个标签即为类别, 因此图像可以按类别分子目录存放.
+ * 用法: backend_benchmark [-accuracy 95] <names> <图像目录> <后端> <cfg> <weights> [<后端> <cfg> <weights> ...]
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "classifier.h"
+
+using namespace cv;
+using namespace std;
+
+/// 重复次数, 取最快的一次
+static const int ROUNDS = 5;
+
+/// 成批推理时一次处理的图像数
+static const int BATCH = 16;
+
+/// 一个后端的测试结果
+struct BackendResult {
+    string backend;
+    string weights;
+    double load_ms;
+    double single_us;
+    double batch_us;
+    int batch;
+    int correct;
+};
+
+/**
+ * @brief 以每次 batch 张对全部图像推理, 返回单张图像的耗时
+ *
+ * @return 单张耗时, 单位为微秒
+ */
+static double measure(Classifier &classifier, const vector<Mat> &images, int batch,
+                      vector<Classifier::Prediction> &results) {
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < images.size(); i += batch) {
+            int count = min(batch, static_cast<int>(images.size() - i));
+            classifier.predictBatch(&images[i], count, &results[i]);
+        }
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / images.size();
+        best = r == 0 ? us : min(best, us);
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    // 可选的准确率要求, 给出时推荐满足它的最快后端
+    double required = -1;
+    vector<char *> args;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "-accuracy") == 0 && i + 1 < argc) {
+            required = atof(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 6 || (args.size() - 3) % 3 != 0) {
+        cerr << "usage: " << argv[0] << " [-accuracy 95] <names> <image dir> <backend> <cfg> <weights> "
+             << "[<backend> <cfg> <weights> ...]" << endl;
+        return 1;
+    }
+    string names = args[1];
+    string directory = args[2];
+
+    vector<string> labels;
+    ifstream f_label(names);
+    string label;
+    while (getline(f_label, label)) {
+        labels.push_back(label);
+    }
+
+    // 图像及其类别, 没有标签出现在路径中的图像只计时
+    vector<Mat> images;
+    vector<int> truths;
+    vector<String> files;
+    glob(directory, files, true);
+    for (const String &file : files) {
+        Mat image = imread(file);
+        if (image.empty()) {
+            continue;
+        }
+        resize(image, image, Size(28, 28));
+        images.push_back(image);
+        string relative = file.substr(min(file.size(), directory.size()));
+        int truth = -1;
+        for (size_t j = 0; j < labels.size(); ++j) {
+            if (!labels[j].empty() && relative.find(labels[j]) != string::npos) {
+                truth = static_cast<int>(j);
+            }
+        }
+        truths.push_back(truth);
+    }
+    if (images.empty()) {
+        cerr << "no images in " << directory << endl;
+        return 1;
+    }
+    int labeled = static_cast<int>(count_if(truths.begin(), truths.end(), [](int t) { return t >= 0; }));
+
+    vector<BackendResult> results;
+    vector<Classifier::Prediction> predictions(images.size());
+    for (size_t i = 3; i + 2 < args.size(); i += 3) {
+        BackendResult result;
+        result.backend = args[i];
+        result.weights = args[i + 2];
+        auto start = chrono::steady_clock::now();
+        Classifier classifier(args[i], args[i + 1], args[i + 2], names);
+        result.load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        classifier.reserve(1);
+        result.single_us = measure(classifier, images, 1, predictions);
+        result.correct = 0;
+        for (size_t j = 0; j < images.size(); ++j) {
+            result.correct += predictions[j].label == truths[j];
+        }
+        result.batch = classifier.reserve(BATCH);
+        result.batch_us = measure(classifier, images, result.batch, predictions);
+        results.push_back(result);
+    }
+
+    cout << images.size() << " images, " << labeled << " labeled" << endl;
+    printf("%-8s %10s %10s %12s %10s  %s\n", "backend", "accuracy", "batch 1", "batched", "load", "weights");
+    for (const BackendResult &result : results) {
+        char accuracy[16] = "-";
+        if (labeled) {
+            snprintf(accuracy, sizeof(accuracy), "%.2f%%", 100. * result.correct / labeled);
+        }
+        char batched[32];
+        snprintf(batched, sizeof(batched), "%.2f us/%d", result.batch_us, result.batch);
+        printf("%-8s %10s %7.2f us %12s %7.1f ms  %s\n", result.backend.c_str(), accuracy, result.single_us, batched,
+               result.load_ms, result.weights.c_str());
+    }
+
+    if (required >= 0 && labeled) {
+        const BackendResult *best = nullptr;
+        for (const BackendResult &result : results) {
+            if (100. * result.correct / labeled >= required && (!best || result.single_us < best->single_us)) {
+                best = &result;
+            }
+        }
+        if (best) {
+            cout << "fastest backend with accuracy >= " << required << "%: " << best->backend << " "
+                 << best->weights << endl;
+        } else {
+            cout << "no backend reaches " << required << "% accuracy" << endl;
+        }
+    }
+    return 0;
+}
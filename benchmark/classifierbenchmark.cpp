@@ -0,0 +1,106 @@
+/**
+ * @file classifierbenchmark.cpp
+ * @brief 数字分类器性能测试
+ * @details 用同一个 Classifier 分别以 darknet 解释执行和 darknet codegen 生成的网络推理,
+ * 输出单张图像的平均耗时, 并核对两者的分类结果和置信度是否一致.
+ * 用法: classifier_benchmark <cfg> <weights> <names> [图像目录], 不给目录时使用随机图像
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "classifier.h"
+
+using namespace cv;
+using namespace std;
+
+/// 随机图像张数
+static const int SYNTHETIC_IMAGES = 500;
+
+/// 重复次数, 取最快的一次
+static const int ROUNDS = 5;
+
+/**
+ * @brief 对全部图像推理, 返回单张图像的耗时
+ *
+ * @return 单张耗时, 单位为微秒
+ */
+static double measure(Classifier &classifier, const vector<Mat> &images, vector<Classifier::Prediction> &results) {
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < images.size(); ++i) {
+            classifier.predictBatch(&images[i], 1, &results[i]);
+        }
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / images.size();
+        best = r == 0 ? us : min(best, us);
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " <cfg> <weights> <names> [image dir]" << endl;
+        return 1;
+    }
+    Classifier classifier("darknet", argv[1], argv[2], argv[3]);
+
+    vector<Mat> images;
+    if (argc > 4) {
+        vector<String> files;
+        glob(string(argv[4]), files);
+        for (const String &file : files) {
+            Mat image = imread(file);
+            if (!image.empty()) {
+                resize(image, image, Size(28, 28));
+                images.push_back(image);
+            }
+        }
+    } else {
+        RNG rng(2222222);
+        for (int i = 0; i < SYNTHETIC_IMAGES; ++i) {
+            Mat image(28, 28, CV_8UC3);
+            rng.fill(image, RNG::UNIFORM, 0, 256);
+            images.push_back(image);
+        }
+    }
+    if (images.empty()) {
+        cerr << "no images" << endl;
+        return 1;
+    }
+
+    vector<Classifier::Prediction> expected(images.size()), actual(images.size());
+    classifier.useGenerated(false);
+    double darknet_time = measure(classifier, images, expected);
+    if (!classifier.useGenerated(true)) {
+        cerr << "generated network does not match " << argv[1] << endl;
+        return 1;
+    }
+    double generated_time = measure(classifier, images, actual);
+
+    int mismatches = 0;
+    float max_error = 0;
+    for (size_t i = 0; i < images.size(); ++i) {
+        mismatches += expected[i].label != actual[i].label;
+        max_error = max(max_error, fabs(expected[i].confidence - actual[i].confidence));
+    }
+    cout << images.size() << " images"
+         << "  darknet: " << darknet_time << " us"
+         << ", generated: " << generated_time << " us"
+         << ", speedup: " << darknet_time / generated_time << "x"
+         << ", mismatches: " << mismatches
+         << ", max confidence error: " << max_error
+         << endl;
+    return 0;
+}
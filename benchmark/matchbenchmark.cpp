@@ -0,0 +1,124 @@
+/**
+ * @file matchbenchmark.cpp
+ * @brief 灯条配对性能测试
+ * @details 生成含 10 到 200 个灯条的合成帧, 其中一部分灯条两两组成装甲板, 其余随机散布.
+ * 对比原来的两两遍历与 LightbarMatcher 的平均耗时, 并核对两者找到的灯条对和得分是否完全一致
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-12
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "lightbarmatcher.h"
+
+using namespace cv;
+using namespace std;
+
+/// 与 param.xml 中的默认值相同
+static const MatchParam PARAM = {2.0, 6.0, 0.5, 2.0, 20.0, 30.0, 20.0};
+
+/// 每种灯条数量生成的帧数
+static const int FRAMES = 200;
+
+/// 每帧的重复次数
+static const int ITERATIONS = 20;
+
+/**
+ * @brief 生成一帧灯条, 大约一半的灯条成对组成装甲板
+ */
+static void generateFrame(mt19937 &engine, int count, vector<RotatedRect> &lightbars) {
+    uniform_real_distribution<float> x_dist(0, 1280);
+    uniform_real_distribution<float> y_dist(0, 1024);
+    uniform_real_distribution<float> height_dist(8, 80);
+    uniform_real_distribution<float> angle_dist(-25, 25);
+    uniform_real_distribution<float> tilt_dist(-20, 20);
+    uniform_real_distribution<float> spread_dist(1.5f, 4.5f);
+
+    lightbars.clear();
+    while (static_cast<int>(lightbars.size()) < count) {
+        float height = height_dist(engine);
+        Point2f center(x_dist(engine), y_dist(engine));
+        float angle = angle_dist(engine);
+        lightbars.emplace_back(center, Size2f(height / 5, height), angle);
+        if (static_cast<int>(lightbars.size()) < count && lightbars.size() % 2 == 0) {
+            // 同一块装甲板的另一侧灯条
+            float tilt = tilt_dist(engine) * static_cast<float>(CV_PI) / 180;
+            float distance = spread_dist(engine) * height;
+            Point2f partner(center.x + distance * cos(tilt), center.y + distance * sin(tilt));
+            float partner_height = height * uniform_real_distribution<float>(0.7f, 1.4f)(engine);
+            lightbars.emplace_back(partner, Size2f(partner_height / 5, partner_height), angle + tilt_dist(engine) / 2);
+        }
+    }
+    shuffle(lightbars.begin(), lightbars.end(), engine);
+}
+
+/**
+ * @brief 原来 ArmorDetector::findArmors 中的两两遍历
+ */
+static void bruteForce(const vector<RotatedRect> &lightbars, vector<LightbarPair> &pairs) {
+    pairs.clear();
+    for (int i = 0; i + 1 < static_cast<int>(lightbars.size()); ++i) {
+        for (int j = i + 1; j < static_cast<int>(lightbars.size()); ++j) {
+            double score;
+            if (LightbarMatcher::evaluate(lightbars[i], lightbars[j], PARAM, score)) {
+                pairs.push_back({i, j, score});
+            }
+        }
+    }
+}
+
+int main() {
+    mt19937 engine(2021);
+    LightbarMatcher matcher;
+    vector<RotatedRect> lightbars;
+    vector<LightbarPair> expected, actual;
+    bool all_match = true;
+
+    cout << "lightbars  brute force(us)  matcher(us)  speedup  pairs/frame" << endl;
+    for (int count : {10, 20, 50, 100, 200}) {
+        double brute_time = 0;
+        double matcher_time = 0;
+        size_t pair_count = 0;
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            generateFrame(engine, count, lightbars);
+
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < ITERATIONS; ++i) {
+                bruteForce(lightbars, expected);
+            }
+            auto middle = chrono::steady_clock::now();
+            for (int i = 0; i < ITERATIONS; ++i) {
+                matcher.match(lightbars, PARAM, actual);
+            }
+            auto end = chrono::steady_clock::now();
+            brute_time += chrono::duration<double, micro>(middle - start).count();
+            matcher_time += chrono::duration<double, micro>(end - middle).count();
+            pair_count += expected.size();
+
+            // 灯条对、顺序和得分都应完全相同
+            bool same = expected.size() == actual.size();
+            for (size_t k = 0; same && k < expected.size(); ++k) {
+                same = expected[k].left == actual[k].left && expected[k].right == actual[k].right &&
+                       expected[k].score == actual[k].score;
+            }
+            all_match = all_match && same;
+        }
+        brute_time /= FRAMES * ITERATIONS;
+        matcher_time /= FRAMES * ITERATIONS;
+        cout << count << "\t\t" << brute_time << "\t\t" << matcher_time << "\t\t"
+             << brute_time / matcher_time << "x\t" << static_cast<double>(pair_count) / FRAMES << endl;
+    }
+    cout << (all_match ? "results match" : "RESULTS DIFFER") << endl;
+    return all_match ? 0 : 1;
+}
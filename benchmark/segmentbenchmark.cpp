@@ -0,0 +1,101 @@
+/**
+ * @file segmentbenchmark.cpp
+ * @brief 颜色分割性能测试
+ * @details 在 640x480 和 1280x1024 两种分辨率下, 对比原来的 OpenCV 调用链与融合的 ColorSegmenter,
+ * 输出平均耗时并逐像素核对两者结果是否一致
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-10
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "colorsegmenter.h"
+#include "types.h"
+
+using namespace cv;
+using namespace std;
+
+/// 与 param.xml 中的默认值相同
+static const int GREY_THRES = 20;
+static const int SUBTRACT_THRES = 40;
+
+/// 每种情况的重复次数
+static const int ITERATIONS = 200;
+
+/**
+ * @brief 原来 ArmorDetector::Preprocess 中的调用链, 不含形态学运算
+ */
+static void opencvChain(const Mat &roi_image, Mat &processed_image, int enemy_color) {
+    Mat gray_image;
+    Mat subtract_image;
+    vector<Mat> channels;
+    cvtColor(roi_image, gray_image, COLOR_BGR2GRAY);
+    threshold(gray_image, gray_image, GREY_THRES, 255, THRESH_BINARY);
+    split(roi_image, channels);
+    if (enemy_color == COLOR_BLUE) {
+        subtract(channels[0], channels[2], subtract_image);
+    } else {
+        subtract(channels[2], channels[0], subtract_image);
+    }
+    threshold(subtract_image, subtract_image, SUBTRACT_THRES, 255, THRESH_BINARY);
+    processed_image = gray_image & subtract_image;
+}
+
+/**
+ * @brief 对同一输入重复运行, 返回平均耗时
+ *
+ * @return 单次耗时, 单位为毫秒
+ */
+template <class Function>
+static double measure(Function function) {
+    function();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        function();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / ITERATIONS;
+}
+
+int main() {
+    const Size sizes[] = {Size(640, 480), Size(1280, 1024)};
+    for (const Size &size : sizes) {
+        // 随机噪声再叠加几条饱和的灯条, 两种阈值都有通过和不通过的像素
+        Mat image(size, CV_8UC3);
+        randu(image, Scalar::all(0), Scalar::all(256));
+        for (int i = 0; i < 8; ++i) {
+            rectangle(image, Rect(size.width * i / 8, size.height / 3, size.width / 80, size.height / 4),
+                      Scalar(90, 90, 255), FILLED);
+        }
+
+        for (int enemy_color : {COLOR_RED, COLOR_BLUE}) {
+            Mat expected, actual, scalar;
+            double opencv_time = measure([&] { opencvChain(image, expected, enemy_color); });
+            ColorSegmenter::forceScalar(true);
+            double scalar_time = measure([&] {
+                ColorSegmenter::segment(image, scalar, GREY_THRES, SUBTRACT_THRES, enemy_color);
+            });
+            ColorSegmenter::forceScalar(false);
+            double fused_time = measure([&] {
+                ColorSegmenter::segment(image, actual, GREY_THRES, SUBTRACT_THRES, enemy_color);
+            });
+
+            cout << size.width << "x" << size.height
+                 << (enemy_color == COLOR_BLUE ? " blue" : " red ")
+                 << "  opencv: " << opencv_time << " ms"
+                 << ", scalar: " << scalar_time << " ms"
+                 << ", " << ColorSegmenter::getInstructionSet() << ": " << fused_time << " ms"
+                 << ", speedup: " << opencv_time / fused_time << "x"
+                 << ", mismatches: " << countNonZero(expected != actual) << "/" << countNonZero(expected != scalar)
+                 << endl;
+        }
+    }
+    return 0;
+}
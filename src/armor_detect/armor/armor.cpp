@@ -1,5 +1,6 @@
-#include <omp.h>
+#include <algorithm>
 #include <util.h>
+#include "threadpool.h"
 #include "timer.h"
 #include "armor.h"
 
@@ -21,75 +22,12 @@ Armor::Armor(const cv::Mat &src,
                                                       score(score),
                                                       number(0),
                                                       priority(0),
-                                                      is_valid(true) {
-
-    // 扩大旋转矩形高度, 尽可能保留数字的全部特征
-    //Armor::rotated_rect.size.width *= ROTATEDRECT_WIDTH_RATE;
-    //Armor::rotated_rect.size.height *= ROTATEDRECT_HEIGHT_RATE;
-
-    float width = Armor::rotated_rect.size.width;
-    float height = Armor::rotated_rect.size.height;
-
-    // 为透视变换做准备
-    // 装甲板角点排列顺序: 左上角, 右上角, 右下角, 左下角
-    cv::Point2f P[4];
-    Armor::rotated_rect.points(P);
-
-    // 源图像中的角点排列
-    //cv::Point2f src_rect[4];
-    //src_rect[0] = P[1];
-    //src_rect[1] = P[2];
-    //src_rect[2] = P[3];
-    //src_rect[3] = P[0];
-
-    // 变换后的角点排列
-    cv::Point2f dst_rect[4];
-    dst_rect[0] = cv::Point2f(0, 0);
-    dst_rect[1] = cv::Point2f(width, 0);
-    dst_rect[2] = cv::Point2f(width, height);
-    dst_rect[3] = cv::Point2f(0, height);
-
-    // 应用透视变换,将装甲板区域矫正成规则矩形
-    cv::Mat transform = cv::getPerspectiveTransform(vertices, dst_rect);
-    cv::Mat perspect_img;
-    cv::warpPerspective(src, perspect_img, transform, src.size());
-
-    // 防止超出边界
-    width = src.cols < width ? src.cols : width;
-    height = src.rows < height ? src.rows : height;
-
-    // 提取数字编号区域
-    // 提取数字编号区域
-    //imshow("per", perspect_img);
-    number_img = perspect_img(cv::Rect(0, 0, width, height));
-    //number_img = number_img(cv::Rect(0.15 * width, 0, 0.8 * width, height));
-    //cv::imshow("la", number_img);
-    //number_img = perspect_img(cv::Rect(0, 0, width, height));
-    cv::resize(number_img, number_img, cv::Size(28, 28));
-
-    // 伽马矫正
-    // here！！！
-
-    //cvtColor(number_img, number_img, COLOR_BGR2GRAY);
-    //imshow("number_img", number_img);
-
-    //imshow("gray", number_img);
-    //gammaCorrect(number_img, number_img);
-    //imshow("gamma", number_img);
-
-    // 按阈值筛选
-    //threshold(number_img, number_img, 31, 255, THRESH_BINARY);
-    //imshow("gamma_final", number_img);
-    //++count;
-    cv::imwrite("../save/1.jpg", number_img);
-    //waitKey();
-    // 展示图像
-    // cv::imshow("number_img", number_img);
-    //number_img = Util::convertTo3Channels(number_img);
-    // 大小还原
-    //Armor::rotated_rect.size.width /= ROTATEDRECT_WIDTH_RATE;
-    //Armor::rotated_rect.size.height /= ROTATEDRECT_HEIGHT_RATE;
-
+                                                      is_valid(true),
+                                                      source(src) {
+    // 大多数候选装甲板不会送进分类器, 这里只记下角点, 不做透视变换
+    for (int i = 0; i < 4; ++i) {
+        number_vertices[i] = vertices[i];
+    }
 }
 
 Armor::~Armor() = default;
@@ -133,6 +71,10 @@ bool Armor::priorityComparator(const Armor &a, const Armor &b) {
 
 Armor &Armor::operator=(const Armor &armor) {
     this->number_img = armor.number_img;
+    this->source = armor.source;
+    for (int i = 0; i < 4; ++i) {
+        this->number_vertices[i] = armor.number_vertices[i];
+    }
     this->number = armor.number;
     this->rotated_rect = armor.rotated_rect;
     //this->rect = armor.rect;
@@ -147,48 +89,67 @@ cv::Rect Armor::rect() const {
     return rotated_rect.boundingRect();
 }
 
+const cv::Mat &Armor::getNumberImage() {
+    if (!number_img.empty() || source.empty()) {
+        return number_img;
+    }
+
+    // 装甲板角点排列顺序: 左上角, 右上角, 右下角, 左下角
+    float width = rotated_rect.size.width;
+    float height = rotated_rect.size.height;
+    cv::Point2f dst_rect[4];
+    dst_rect[0] = cv::Point2f(0, 0);
+    dst_rect[1] = cv::Point2f(width, 0);
+    dst_rect[2] = cv::Point2f(width, height);
+    dst_rect[3] = cv::Point2f(0, height);
+
+    // 防止超出边界
+    int crop_width = static_cast<int>(std::min(width, static_cast<float>(source.cols)));
+    int crop_height = static_cast<int>(std::min(height, static_cast<float>(source.rows)));
+    if (crop_width <= 0 || crop_height <= 0) {
+        number_img = cv::Mat::zeros(NUMBER_IMAGE_SIZE, NUMBER_IMAGE_SIZE, source.type());
+        source.release();
+        return number_img;
+    }
+
+    // 透视变换把数字区域矫正成 width x height 的矩形, 再左乘缩放矩阵把左上角 crop_width x crop_height 的部分
+    // 映射到 28x28, 一次变换直接得到数字图像, 不再生成源图像大小的中间图像, 也不需要再次缩放
+    cv::Mat transform = cv::getPerspectiveTransform(number_vertices, dst_rect);
+    cv::Matx33d scale(static_cast<double>(NUMBER_IMAGE_SIZE) / crop_width, 0, 0,
+                      0, static_cast<double>(NUMBER_IMAGE_SIZE) / crop_height, 0,
+                      0, 0, 1);
+    cv::Mat number_transform = cv::Mat(scale) * transform;
+    cv::warpPerspective(source, number_img, number_transform, cv::Size(NUMBER_IMAGE_SIZE, NUMBER_IMAGE_SIZE));
+
+    // 数字图像已生成, 不再占用源图像
+    source.release();
+    return number_img;
+}
+
+void Armor::releaseSource() {
+    source.release();
+}
+
 void Armor::gammaCorrect(Mat &src, Mat &dst, double gammaG, double gammaC) {
     int rows = src.rows;
     int cols = src.cols;
-    uchar *p_src, *p_dst;
-    double val;
-
-    // 直接原地修改
-    // openmp并行化, 加速效果待测试
-    if (&src == &dst) {
-#pragma omp parallel for num_threads(4) default(none) shared(src, rows, cols, gammaG) private(val, p_src, i, j) \
-    schedule(static, 1)
-        for (int i = 0; i < rows; i++) {
-            // 获取图像每一行的首地址
-            p_src = src.ptr<uchar>(i);
-            for (int j = 0; j < cols; j++) {
-                // 每次迭代获取图像列的地址
-                uchar &pix_src = *p_src++;
-                // 归一化处理
-                val = static_cast<double>(pix_src) / 255;
-                // 按公式计算并逆归一化
-                pix_src = static_cast<uchar>((pow(val / gammaC, 1 / gammaG) * 255));
-            }
-        }
-    } else {
-        Mat _dst = Mat(rows, cols, src.type());
 
-#pragma omp parallel for num_threads(4) default(none) shared(src, dst, rows, cols, gammaG) private(val, p_src, p_dst, i, j) \
-    schedule(static, 1)
-        for (int i = 0; i < rows; i++) {
+    // 直接原地修改, 否则写到新图像再交给 dst
+    Mat _dst = &src == &dst ? src : Mat(rows, cols, src.type());
+
+    // 每个像素一次 pow, 按几十次乘加计入工作量, 小图由调用线程直接完成
+    ThreadPool::parallelFor(0, rows, 50.0 * rows * cols, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
             // 获取图像每一行的首地址
-            p_src = src.ptr<uchar>(i);
-            p_dst = _dst.ptr<uchar>(i);
+            const uchar *p_src = src.ptr<uchar>(i);
+            uchar *p_dst = _dst.ptr<uchar>(i);
             for (int j = 0; j < cols; j++) {
-                // 每次迭代获取图像列的地址
-                uchar &pix_src = *p_src++;
-                uchar &pix_dst = *p_dst++;
                 // 归一化处理
-                val = static_cast<double>(pix_src) / 255;
+                double val = static_cast<double>(p_src[j]) / 255;
                 // 按公式计算并逆归一化
-                pix_dst = static_cast<uchar>((pow(val / gammaC, 1 / gammaG) * 255));
+                p_dst[j] = static_cast<uchar>((pow(val / gammaC, 1 / gammaG) * 255));
             }
         }
-        dst = _dst;
-    }
+    });
+    dst = _dst;
 }
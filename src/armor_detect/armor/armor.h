@@ -40,7 +40,7 @@ public:
     /// 装甲板打击优先级, 优先级越高越优先击打
     int priority;
 
-    /// 装甲板数字编号的图像
+    /// 装甲板数字编号的图像, 28x28, 调用 getNumberImage() 时才生成
     cv::Mat number_img;
 
     /// 装甲板颜色
@@ -59,6 +59,15 @@ private:
     /// 装甲板数字编号
     int number;
 
+    /// 截取数字图像的源图像, 只引用不拷贝, 生成数字图像后即释放
+    cv::Mat source;
+
+    /// 源图像中数字区域的四个角点, 依次为左上角, 右上角, 右下角, 左下角
+    cv::Point2f number_vertices[4];
+
+    /// 数字图像的边长, 与分类网络的输入尺寸一致
+    constexpr static int NUMBER_IMAGE_SIZE = 28;
+
     /// 旋转矩形宽度放大倍率, 尽可能保证截取数字区域的全部特征
     constexpr static double ROTATEDRECT_WIDTH_RATE = 1.0;
 
@@ -73,12 +82,13 @@ public:
 
     /**
      * @brief 构造函数
-     * @detail 对旋转矩形框出的装甲板图像进行透视变换，提取数字图像
+     * @detail 只记录源图像和数字区域的角点, 数字图像在需要分类时由 getNumberImage() 生成
      * 
      * @param src 源图像
      * @param rotated_rect 贴合装甲板的旋转矩形
      * @param color 敌方颜色
      * @param score 误差得分
+     * @param vertices 数字区域的四个角点
      */
     Armor(const cv::Mat &src,
           const cv::RotatedRect &rotated_rect,
@@ -93,6 +103,18 @@ public:
 
     cv::Rect rect() const;
 
+    /**
+     * @brief 获取装甲板数字图像, 首次调用时由透视变换直接生成 28x28 的图像
+     *
+     * @return 数字图像, 源图像已释放且未生成过时为空
+     */
+    const cv::Mat &getNumberImage();
+
+    /**
+     * @brief 释放对源图像的引用, 装甲板需要在源图像之后继续保留时调用
+     */
+    void releaseSource();
+
     /**
      * @brief 获取装甲板数字编号
      *
@@ -9,9 +9,7 @@
 using namespace cv;
 using namespace std;
 
-ArmorDetector::ArmorDetector() : classifier((char *) "../src/armor_detect/classifier/darknet/cfg/mnist_cifar10.cfg",
-                                            (char *) "../src/armor_detect/classifier/darknet/backup/mnist_cifar10_4.weights",
-                                            (char *) "../src/armor_detect/classifier/darknet/data/names.list") {}
+ArmorDetector::ArmorDetector() = default;
 
 ArmorDetector::~ArmorDetector() = default;
 
@@ -30,6 +28,49 @@ void ArmorDetector::init(const FileStorage &file_storage) {
 
     // 最大预选数量相关参数传入
     MAX_CANDIDATE_NUM = arm_detect["MAX_CANDIDATE_NUM"];
+    // 数字图像采样相关参数传入
+    NUMBER_SAMPLE_INTERVAL = arm_detect["NUMBER_SAMPLE_INTERVAL"];
+    NUMBER_SAMPLE_PATH = static_cast<string>(arm_detect["NUMBER_SAMPLE_PATH"]);
+    number_sampler.open(NUMBER_SAMPLE_PATH, NUMBER_SAMPLE_INTERVAL);
+    // 数字分类器相关参数传入, 重新加载和量化都会改写权重, 先停止共用权重的异步分类器
+    async_classifier.close();
+    string backend = static_cast<string>(arm_detect["NUMBER_BACKEND"]);
+    string cfg = static_cast<string>(arm_detect["NUMBER_CFG"]);
+    string weights = static_cast<string>(arm_detect["NUMBER_WEIGHTS"]);
+    string names = static_cast<string>(arm_detect["NUMBER_NAMES"]);
+    if (!classifier || backend != NUMBER_BACKEND || cfg != NUMBER_CFG || weights != NUMBER_WEIGHTS ||
+        names != NUMBER_NAMES) {
+        NUMBER_BACKEND = backend;
+        NUMBER_CFG = cfg;
+        NUMBER_WEIGHTS = weights;
+        NUMBER_NAMES = names;
+        // 先释放旧模型, 两份模型不同时驻留
+        classifier.reset();
+        classifier.reset(new Classifier(NUMBER_BACKEND, NUMBER_CFG, NUMBER_WEIGHTS, NUMBER_NAMES));
+    }
+    NUMBER_INT8_RANGES = static_cast<string>(arm_detect["NUMBER_INT8_RANGES"]);
+    classifier->quantize(NUMBER_INT8_RANGES);
+    NUMBER_GENERATED = arm_detect["NUMBER_GENERATED"];
+    classifier->useGenerated(NUMBER_GENERATED != 0);
+    // 数字识别缓存相关参数传入
+    NUMBER_CACHE_FRAMES = arm_detect["NUMBER_CACHE_FRAMES"];
+    NUMBER_CACHE_HASH_DISTANCE = arm_detect["NUMBER_CACHE_HASH_DISTANCE"];
+    // 异步分类相关参数传入, 异步分类的结果按轨迹合并, 不沿用结果时也要维护轨迹
+    NUMBER_ASYNC = arm_detect["NUMBER_ASYNC"];
+    NUMBER_ASYNC_POLICY = arm_detect["NUMBER_ASYNC_POLICY"];
+    number_cache.init(NUMBER_CACHE_FRAMES, NUMBER_CACHE_HASH_DISTANCE, NUMBER_ASYNC != 0);
+    // 分类器的输入缓冲区和分类结果按最大数量预先分配
+    MAX_CANDIDATE_NUM = max(0, min(MAX_CANDIDATE_NUM, classifier->reserve(MAX_CANDIDATE_NUM)));
+    number_images.resize(MAX_CANDIDATE_NUM);
+    number_predictions.resize(MAX_CANDIDATE_NUM);
+    number_hashes.resize(MAX_CANDIDATE_NUM);
+    number_misses.resize(MAX_CANDIDATE_NUM);
+    number_labels.resize(MAX_CANDIDATE_NUM);
+    async_images.resize(MAX_CANDIDATE_NUM);
+    async_ids.resize(MAX_CANDIDATE_NUM);
+    if (NUMBER_ASYNC) {
+        async_classifier.open(*classifier, MAX_CANDIDATE_NUM);
+    }
     // 装甲板筛选限定条件相关参数传入
     MIN_LIGHTBAR_AREA = arm_detect["MIN_LIGHTBAR_AREA"];
     MIN_ASPECT_RATIO = arm_detect["MIN_ASPECT_RATIO"];
@@ -48,35 +89,60 @@ void ArmorDetector::init(const FileStorage &file_storage) {
 }
 
 bool ArmorDetector::run(const Mat &src, const int enemy_color, Armor &target_armor) {
-    Timer timer;
-    timer.start();
-    Preprocess(src, enemy_color);
+    preprocess(src, enemy_color, detection_frame);
+    processed_image = detection_frame.processed_image;
+    return detect(detection_frame, target_armor);
+}
+
+void ArmorDetector::preprocess(const Mat &src, const int enemy_color, DetectionFrame &frame) {
+    {
+        lock_guard<mutex> lock(roi_mutex);
+        frame.roi_rect = ROI_ENABLE ? roi_rect : Rect();
+    }
+    frame.enemy_color = enemy_color;
+#ifdef DISTORTION_CORRECT
+    // 畸变矫正会改写 ROI 图像, 必须拷贝一份, 不能改动源图像
+    if (!frame.roi_rect.empty()) {
+        src(frame.roi_rect).copyTo(frame.roi_image);
+    } else {
+        src.copyTo(frame.roi_image);
+    }
+#else
+    // 之后只读 ROI 图像, 直接引用源图像中的区域, 省去一次拷贝
+    frame.roi_image = frame.roi_rect.empty() ? src : src(frame.roi_rect);
+#endif // DISTORTION_CORRECT
+    Preprocess(frame);
+}
+
+bool ArmorDetector::detect(DetectionFrame &frame, Armor &target_armor) {
     vector<Armor> vec_armors;
-    findTarget(enemy_color, vec_armors);
-    selectTarget(vec_armors);
+    findTarget(frame, vec_armors);
+    selectTarget(frame, vec_armors);
 
     if (!vec_armors.empty()) {
         target_armor = vec_armors.at(0);
-        if (!roi_rect.empty()) {
-            target_armor.rotated_rect.center.x += roi_rect.x;
-            target_armor.rotated_rect.center.y += roi_rect.y;
+        // 目标装甲板会随任务保留到下一帧, 不能继续引用本帧的图像
+        target_armor.releaseSource();
+        // 用本帧实际使用的 ROI 还原坐标, 流水线模式下它可能已经不是当前的 ROI
+        if (!frame.roi_rect.empty()) {
+            target_armor.rotated_rect.center.x += frame.roi_rect.x;
+            target_armor.rotated_rect.center.y += frame.roi_rect.y;
         }
         if (ROI_ENABLE) {
             setRoiRect(target_armor.rect());
         }
         return true;
     } else {
+        lock_guard<mutex> lock(roi_mutex);
         roi_rect = Rect();
         return false;
     }
 }
 
-void ArmorDetector::Preprocess(const Mat &src, const int enemy_color) {
-    if (ROI_ENABLE && !roi_rect.empty()) {
-        src(roi_rect).copyTo(roi_image);
-    } else {
-        src.copyTo(roi_image);
-    }
+void ArmorDetector::Preprocess(DetectionFrame &frame) {
+    Mat &roi_image = frame.roi_image;
+    Mat &processed_image = frame.processed_image;
+    const int enemy_color = frame.enemy_color;
     // imshow("roi", roi_image);
 
 #ifndef COMPILE_WITH_CUDA
@@ -89,28 +155,9 @@ void ArmorDetector::Preprocess(const Mat &src, const int enemy_color) {
     remap(roi_image, roi_image, map1, map2, INTER_LINEAR);
 #endif // DISTORTION_CORRECT
 
-    Mat gray_image;
-    Mat subtract_image;
-    vector<Mat> channels;
-
-    // 转灰度图
-    cvtColor(roi_image, gray_image, COLOR_BGR2GRAY);
-
-    // 按阈值筛选
-    threshold(gray_image, gray_image, GREY_THRES, 255, THRESH_BINARY);
-
-    // 通道分离相减
-    split(roi_image, channels);
-    if (enemy_color == COLOR_BLUE) {
-        subtract(channels[0], channels[2], subtract_image);
-    } else {
-        subtract(channels[2], channels[0], subtract_image);
-    }
-
-    threshold(subtract_image, subtract_image, SUBTRACT_THRES, 255, THRESH_BINARY);
-    // 取图像交集
-    processed_image = gray_image & subtract_image;
-    // 开运算
+    // 灰度阈值、通道相减阈值和取交集在一次遍历中完成, 直接写出二值图像
+    ColorSegmenter::segment(roi_image, processed_image, GREY_THRES, SUBTRACT_THRES, enemy_color);
+    // 闭运算
     morphologyEx(processed_image, processed_image, MORPH_CLOSE, kernel);
 #else
     // 畸变矫正
@@ -151,142 +198,72 @@ void ArmorDetector::Preprocess(const Mat &src, const int enemy_color) {
 #endif // COMPILE_WITH_CUDA
 }
 
-void ArmorDetector::findTarget(const int enemy_color, vector<Armor> &armors) {
-    // 找出所有轮廓
-    vector<vector<Point>> contours;
-    vector<Vec4i> hierarchy;
-    RotatedRect temp_rect;
-    findContours(processed_image, contours, hierarchy, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-
-    // 按照面积初步筛选出灯条
+void ArmorDetector::findTarget(const DetectionFrame &frame, vector<Armor> &armors) {
+    // 连通域标记, 由各连通域的矩直接得到灯条, 并按照面积初步筛选
     vector<RotatedRect> lightbars;
-    for (auto &contour : contours) {
-        temp_rect = minAreaRect(contour);
-        if (temp_rect.size.width * temp_rect.size.height > MIN_LIGHTBAR_AREA) {
-            adjustLightBar(temp_rect);
-            lightbars.emplace_back(temp_rect);
-        }
-    }
+    lightbar_extractor.extract(frame.processed_image, MIN_LIGHTBAR_AREA, lightbars);
     // 寻找装甲板
-    findArmors(lightbars, enemy_color, armors);
+    findArmors(lightbars, frame, armors);
 }
 
-void ArmorDetector::findArmors(vector<RotatedRect> &lightbars, const int enemy_color,
+void ArmorDetector::findArmors(vector<RotatedRect> &lightbars, const DetectionFrame &frame,
                                vector<Armor> &armors) {
     if (lightbars.empty() || lightbars.size() == 1)
         return;
 
+    // 按中心横坐标排序后只在可能的距离内配对, 得到的灯条对和得分与两两遍历相同
+    MatchParam param = {MIN_ASPECT_RATIO, MAX_ASPECT_RATIO,
+                        MIN_LENGTH_RATIO, MAX_LENGTH_RATIO,
+                        MAX_LIGHTBAR_DELTA, MAX_ARMOR_ANGLE, MAX_ARMOR_LIGHTBAR_DELTA};
+    lightbar_matcher.match(lightbars, param, lightbar_pairs);
+
     /// 左右灯条中心点
     Point2f left_center, right_center;
 
-    /// 装甲宽，高，宽高比，灯条长度比
-    double armor_width, armor_height, aspect_ratio, length_ratio;
-
-    /// 灯条倾斜度差值，装甲板倾斜角度，灯甲倾斜度之差
-    double lightbar_delta, armor_angle, armor_lightbar_delta;
-
-    /// 得分情况
-    double score;
-
-    /// 寻找结果
-    bool result;
-
     Point2f left_vertices[4], right_vertices[4];
     vector<Point2f> armor_vertices;
     RotatedRect temp_rect;
 
-    for (int i = 0; i < lightbars.size() - 1; ++i) {
+    for (const LightbarPair &pair : lightbar_pairs) {
+        int i = pair.left;
+        int j = pair.right;
         left_center = lightbars[i].center;
+        right_center = lightbars[j].center;
 
-        for (int j = i + 1; j < lightbars.size(); ++j) {
-            right_center = lightbars[j].center;
-
-            // 计算装甲板宽高比
-            armor_width = sqrt((right_center.x - left_center.x) *
-                               (right_center.x - left_center.x) +
-                               (right_center.y - left_center.y) *
-                               (right_center.y - left_center.y));
-            armor_height = (lightbars[i].size.height + lightbars[j].size.height) / 2;
-
-            aspect_ratio = armor_width / armor_height;
-
-            // 计算两灯条长度比
-            length_ratio = lightbars[i].size.height / lightbars[j].size.height;
-
-            // 计算灯条倾斜度之差
-            lightbar_delta = fabs(lightbars[i].angle - lightbars[j].angle);
-
-            // 计算装甲板倾斜度
-            armor_angle = atan((right_center.y - left_center.y) / (right_center.x - left_center.x)) * 180 / Util::PI;
-
-            // 计算灯甲倾斜度之差
-            armor_lightbar_delta = fabs((lightbars[i].angle + lightbars[j].angle) / 2.0 - armor_angle);
-
-            // 判断
-            result = 1;
-            score = 0;
-
-            // 长宽比在范围内
-            result = result && aspect_ratio > MIN_ASPECT_RATIO && aspect_ratio < MAX_ASPECT_RATIO;
-            score += fabs(aspect_ratio - 3.31) * 10.0 / 3.31;
-
-            // 两灯条长度相差不过大
-            result = result && length_ratio > MIN_LENGTH_RATIO && length_ratio < MAX_LENGTH_RATIO;
-            if (length_ratio > 1.0) {
-                score += (length_ratio - 1.0) * 10.0 / (MAX_LENGTH_RATIO - 1.0);
-            } else {
-                score += (1.0 - length_ratio) * 10.0 / (1.0 - MIN_LENGTH_RATIO);
-            }
-
-            // 两灯条倾斜度之差不过大
-            result = result && lightbar_delta < MAX_LIGHTBAR_DELTA;
-            score += lightbar_delta * 10.0 / MAX_LIGHTBAR_DELTA;
-
-            // 装甲板倾斜度不过大
-            result = result && fabs(armor_angle) < MAX_ARMOR_ANGLE;
-            score += fabs(armor_angle) * 10.0 / MAX_ARMOR_ANGLE;
-
-            // 灯甲倾斜度相差不过大
-            result = result && armor_lightbar_delta < MAX_ARMOR_LIGHTBAR_DELTA;
-            score += armor_lightbar_delta * 10.0 / MAX_ARMOR_LIGHTBAR_DELTA;
-
-            if (result) {
-                lightbars[i].points(left_vertices);
-                lightbars[j].points(right_vertices);
-                for (int k = 0; k < 4; ++k) {
-                    armor_vertices.emplace_back(left_vertices[k]);
-                    armor_vertices.emplace_back(right_vertices[k]);
-                }
-
-                //将灯条的四个顶点传入容器中
-                // 为了截取出完整的数字，设定一个截取比例ratio
-                Point2f perspect_vertices[4];
-                Point2f left_up, left_down, right_up, right_down;
-                left_up.x = left_center.x;
-                left_up.y = left_center.y - ratio * lightbars[i].size.height;
-                left_down.x = left_center.x;
-                left_down.y = left_center.y + ratio * lightbars[i].size.height;
-                right_up.x = right_center.x;
-                right_up.y = right_center.y - ratio * lightbars[j].size.height;
-                right_down.x = right_center.x;
-                right_down.y = right_center.y + ratio * lightbars[j].size.height;
-                perspect_vertices[0] = left_up;
-                perspect_vertices[1] = right_up;
-                perspect_vertices[2] = right_down;
-                perspect_vertices[3] = left_down;
-
-
-                // 得到装甲板
-                temp_rect = minAreaRect(armor_vertices);
-                adjustArmor(temp_rect);
-                armors.emplace_back(Armor(roi_image, temp_rect, enemy_color, score, perspect_vertices));
-                armor_vertices.clear();
-            }
+        lightbars[i].points(left_vertices);
+        lightbars[j].points(right_vertices);
+        for (int k = 0; k < 4; ++k) {
+            armor_vertices.emplace_back(left_vertices[k]);
+            armor_vertices.emplace_back(right_vertices[k]);
         }
+
+        //将灯条的四个顶点传入容器中
+        // 为了截取出完整的数字，设定一个截取比例ratio
+        Point2f perspect_vertices[4];
+        Point2f left_up, left_down, right_up, right_down;
+        left_up.x = left_center.x;
+        left_up.y = left_center.y - ratio * lightbars[i].size.height;
+        left_down.x = left_center.x;
+        left_down.y = left_center.y + ratio * lightbars[i].size.height;
+        right_up.x = right_center.x;
+        right_up.y = right_center.y - ratio * lightbars[j].size.height;
+        right_down.x = right_center.x;
+        right_down.y = right_center.y + ratio * lightbars[j].size.height;
+        perspect_vertices[0] = left_up;
+        perspect_vertices[1] = right_up;
+        perspect_vertices[2] = right_down;
+        perspect_vertices[3] = left_down;
+
+
+        // 得到装甲板
+        temp_rect = minAreaRect(armor_vertices);
+        adjustArmor(temp_rect);
+        armors.emplace_back(Armor(frame.roi_image, temp_rect, frame.enemy_color, pair.score, perspect_vertices));
+        armor_vertices.clear();
     }
 }
 
-void ArmorDetector::selectTarget(vector<Armor> &armors) {
+void ArmorDetector::selectTarget(const DetectionFrame &frame, vector<Armor> &armors) {
     // 无候选装甲板, 无需再挑选
     if (armors.empty()) {
         return;
@@ -295,32 +272,89 @@ void ArmorDetector::selectTarget(vector<Armor> &armors) {
     // 先根据误差得分升序排列
     sort(armors.begin(), armors.end(), Armor::scoreComparator);
 
-    // 已经进行分类的装甲板数量
-    // 考虑的分类推理的耗时, 需要对数量进行限制
-    int cnt = 0;
+    // 考虑的分类推理的耗时, 需要对送进分类器的数量进行限制
+    int count = min(static_cast<int>(armors.size()), MAX_CANDIDATE_NUM);
 
-    // 根据数字识别结果筛选, 删除误识别的候选者
-    for (auto iter = armors.begin(); (iter != armors.end()) && (cnt < MAX_CANDIDATE_NUM);) {
+    // 只为送进分类器的候选装甲板生成数字图像
+    for (int i = 0; i < count; ++i) {
+        number_images[i] = armors[i].getNumberImage();
+        number_sampler.submit(number_images[i]);
+    }
+
+    // 根据数字识别结果设置打击优先级, 所有候选者在一次推理中完成分类
 #ifdef USE_MODEL
-        Timer timer1;
-        timer1.start();
-        imshow("img", iter->number_img);
-        Mat img = imread("../image/23408.jpg");
-        classifier.predict(img);
-        //iter->setNumber(classifier.predict(iter->number_img));
-        timer1.printTime("predict:");
-#else
-        iter->setNumber(1);
-#endif
-        if (iter->getNumber() == 0) {
-            //iter = armors.erase(iter);
-            ++iter;
-            ++cnt;
-        } else {
-            ++iter;
-            ++cnt;
+    // 轨迹用整幅图像中的位置匹配, ROI 随目标移动时坐标仍然连续
+    auto frameRect = [&frame](const Armor &armor) {
+        RotatedRect rect = armor.rotated_rect;
+        rect.center.x += frame.roi_rect.x;
+        rect.center.y += frame.roi_rect.y;
+        return rect;
+    };
+    number_cache.beginFrame();
+    // 合并上一批异步分类的结果, 它们对应的轨迹从下一次查找起使用新的类别
+    int result_count = async_classifier.collect(async_result_ids, async_predictions);
+    for (int k = 0; k < result_count; ++k) {
+        number_cache.confirm(async_result_ids[k], async_predictions[k]);
+    }
+    // 后台线程还在处理上一批时, 本帧不再送出新的请求
+    bool async_ready = NUMBER_ASYNC && async_classifier.ready();
+    int async_count = 0;
+
+    // 同一轨迹上数字图像没有明显变化的候选者沿用上次的分类结果, 其余的送进分类器.
+    // 异步模式下已有轨迹的候选者先沿用上次确认的类别, 新目标按 NUMBER_ASYNC_POLICY 处理
+    int miss_count = 0;
+    Classifier::Prediction prediction;
+    for (int i = 0; i < count; ++i) {
+        RotatedRect rect = frameRect(armors[i]);
+        number_hashes[i] = number_cache.enabled() ? NumberCache::hash(number_images[i]) : 0;
+        if (number_cache.lookup(rect, number_hashes[i], prediction)) {
+            number_labels[i] = prediction.label;
+            continue;
+        }
+        bool known = NUMBER_ASYNC && number_cache.recall(rect, prediction);
+        if (!NUMBER_ASYNC || (!known && NUMBER_ASYNC_POLICY == UNLABELED_SYNC)) {
+            number_images[miss_count] = number_images[i];
+            number_misses[miss_count++] = i;
+            continue;
+        }
+        if (!known) {
+            prediction = {NumberCache::UNKNOWN, 0};
         }
+        number_labels[i] = prediction.label;
+        uint64_t id = async_ready ? number_cache.store(rect, number_hashes[i], prediction, true) : 0;
+        if (id != 0) {
+            async_images[async_count] = number_images[i];
+            async_ids[async_count++] = id;
+        } else if (known) {
+            // 后台线程忙时轨迹只跟随装甲板移动, 下一帧再送出
+            number_cache.follow(rect);
+        }
+    }
+    if (async_count > 0) {
+        async_classifier.submit(async_images.data(), async_ids.data(), async_count);
+    }
+    if (miss_count > 0) {
+        classifier->predictBatch(number_images.data(), miss_count, number_predictions.data());
+    }
+    for (int k = 0; k < miss_count; ++k) {
+        int i = number_misses[k];
+        number_cache.store(frameRect(armors[i]), number_hashes[i], number_predictions[k]);
+        number_labels[i] = number_predictions[k].label;
+    }
+
+    // 尚无类别的新目标保持编号 0, 或按策略从候选装甲板中移除
+    for (int i = count - 1; i >= 0; --i) {
+        if (number_labels[i] != NumberCache::UNKNOWN) {
+            armors[i].setNumber(number_labels[i]);
+        } else if (NUMBER_ASYNC_POLICY == UNLABELED_SKIP) {
+            armors.erase(armors.begin() + i);
+        }
+    }
+#else
+    for (int i = 0; i < count; ++i) {
+        armors[i].setNumber(1);
     }
+#endif
 
     // 根据打击优先级降序排列
     sort(armors.begin(), armors.end(), Armor::priorityComparator);
@@ -339,6 +373,10 @@ void ArmorDetector::adjustArmor(RotatedRect &rect) {
     }
 }
 
+const NumberCache &ArmorDetector::getNumberCache() const {
+    return number_cache;
+}
+
 const Rect &ArmorDetector::getRoiRect() const {
     return roi_rect;
 }
@@ -353,6 +391,7 @@ void ArmorDetector::setRoiRect(const Rect &roiRect) {
     detect_y = roiRect.y - (detect_height - roiRect.height) / 2;
 
     preventROIExceed(detect_x, detect_y, detect_width, detect_height);
+    lock_guard<mutex> lock(roi_mutex);
     roi_rect = Rect(detect_x, detect_y, detect_width, detect_height);
 }
 
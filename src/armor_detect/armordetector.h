@@ -14,11 +14,19 @@
 #define ARMORDETECTOR_H
 
 #include <opencv2/opencv.hpp>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "armor/armor.h"
 #include "base.h"
+#include "classifier/asyncclassifier.h"
 #include "classifier/classifier.h"
+#include "classifier/numbercache.h"
+#include "segmenter/colorsegmenter.h"
+#include "lightbar/lightbarextractor.h"
+#include "lightbar/lightbarmatcher.h"
+#include "imagesampler.h"
 
 #ifdef COMPILE_WITH_CUDA
 #include <opencv2/cudaarithm.hpp>
@@ -28,8 +36,42 @@
 
 class Debugger;
 
+/**
+ * @brief 一帧图像在装甲板检测各阶段之间传递的中间结果
+ * 预处理和检测分别在不同线程中运行时, 每一帧的中间结果各自独立, 互不覆盖
+ */
+struct DetectionFrame {
+    /// 本帧使用的 ROI 区域, 为空表示使用全图
+    cv::Rect roi_rect;
+
+    /// ROI 图像
+    cv::Mat roi_image;
+
+    /// 预处理得到的二值图像, 用于寻找灯条
+    cv::Mat processed_image;
+
+    /// 敌方颜色
+    int enemy_color = COLOR_DEFAULT;
+};
+
+/**
+ * @brief 枚举异步分类时尚无类别的新目标的处理方式
+ * 已有轨迹的目标沿用上次确认的类别, 新目标要等到下一帧才有异步分类的结果
+ */
+enum UnlabeledPolicy {
+    /// 当帧同步分类, 只有新目标出现时才等待推理
+    UNLABELED_SYNC = 0,
+
+    /// 暂按编号 0 参与排序, 优先级最低
+    UNLABELED_LOWEST,
+
+    /// 本帧不作为候选装甲板
+    UNLABELED_SKIP
+};
+
 /**
  * @brief 装甲板检测类
+ * 检测分为预处理和检测两个阶段, 可以在同一线程中依次运行, 也可以作为流水线的两级分别在两个线程中运行
  */
 class ArmorDetector
 {
@@ -44,6 +86,8 @@ public:
 
     void setRoiRect(const cv::Rect &roiRect);
 
+    const NumberCache &getNumberCache() const;
+
 private:
 
     /// 是否使用ROI
@@ -52,6 +96,9 @@ private:
     /// ROI区域
     cv::Rect roi_rect;
 
+    /// 保护 `roi_rect`, 流水线模式下预处理线程读取、检测线程更新
+    std::mutex roi_mutex;
+
     /// 图像帧宽度
     int FRAME_WIDTH;
 
@@ -60,8 +107,8 @@ private:
 
 private:
     constexpr static double ratio = 1.5;
-    /// ROI图片
-    cv::Mat roi_image;
+    /// run() 使用的中间结果, 各帧之间复用内存
+    DetectionFrame detection_frame;
 
     /// 轮廓被视为灯条的最小面积
     double MIN_LIGHTBAR_AREA;
@@ -90,6 +137,42 @@ private:
     /// 每帧送进分类器的候选装甲板的最大数量
     int MAX_CANDIDATE_NUM = 1;
 
+    /// 数字图像采样间隔, 0 表示不保存
+    int NUMBER_SAMPLE_INTERVAL = 0;
+
+    /// 数字图像保存目录
+    std::string NUMBER_SAMPLE_PATH;
+
+    /// 数字分类器后端: darknet, linear 或 mlp
+    std::string NUMBER_BACKEND;
+
+    /// 数字分类器的 darknet 配置文件
+    std::string NUMBER_CFG;
+
+    /// 数字分类器的权重文件
+    std::string NUMBER_WEIGHTS;
+
+    /// 数字分类器的标签文件
+    std::string NUMBER_NAMES;
+
+    /// 数字分类器 INT8 量化范围文件, 为空时按 FP32 推理
+    std::string NUMBER_INT8_RANGES;
+
+    /// 数字分类器是否使用预先生成的网络
+    int NUMBER_GENERATED = 0;
+
+    /// 同一轨迹沿用上次分类结果的最大帧数, 0 表示每帧都分类
+    int NUMBER_CACHE_FRAMES = 0;
+
+    /// 数字图像感知哈希的汉明距离上限, 超过时重新分类
+    int NUMBER_CACHE_HASH_DISTANCE = 0;
+
+    /// 是否在后台线程中异步分类, 结果最迟在下一帧合并
+    int NUMBER_ASYNC = 0;
+
+    /// 异步分类时尚无类别的新目标的处理方式, 取值见 UnlabeledPolicy
+    int NUMBER_ASYNC_POLICY = UNLABELED_SYNC;
+
     /// 源图像灰度阈值
     int GREY_THRES;
 
@@ -110,8 +193,53 @@ private:
     cv::Ptr<cv::cuda::Filter> kernel;
 #endif // COMPILE_WITH_CUDA
 
-    /// 数字分类器
-    Classifier classifier;
+    /// 数字分类器, 按参数中的后端和模型文件加载, 参数不变时重新初始化不再加载
+    std::unique_ptr<Classifier> classifier;
+
+    /// 灯条提取器, 只在检测阶段使用
+    LightbarExtractor lightbar_extractor;
+
+    /// 灯条配对器, 只在检测阶段使用
+    LightbarMatcher lightbar_matcher;
+
+    /// 配对成功的灯条对, 在各帧之间复用
+    std::vector<LightbarPair> lightbar_pairs;
+
+    /// 数字图像采样器, 在后台线程中保存送进分类器的数字图像
+    ImageSampler number_sampler;
+
+    /// 本帧送进分类器的数字图像
+    std::vector<cv::Mat> number_images;
+
+    /// 数字图像的分类结果
+    std::vector<Classifier::Prediction> number_predictions;
+
+    /// 按轨迹缓存的分类结果, ROI 跟踪锁定同一块装甲板时不必每帧重新分类
+    NumberCache number_cache;
+
+    /// 本帧各候选装甲板数字图像的感知哈希
+    std::vector<uint64_t> number_hashes;
+
+    /// 未命中缓存、送进分类器的候选装甲板下标
+    std::vector<int> number_misses;
+
+    /// 本帧各候选装甲板的类别, 异步分类尚无结果的新目标为 NumberCache::UNKNOWN
+    std::vector<int> number_labels;
+
+    /// 异步分类器, 与 classifier 共用权重
+    AsyncClassifier async_classifier;
+
+    /// 送去异步分类的数字图像
+    std::vector<cv::Mat> async_images;
+
+    /// 送去异步分类的装甲板所在的轨迹
+    std::vector<uint64_t> async_ids;
+
+    /// 取回的异步分类结果所属的轨迹
+    std::vector<uint64_t> async_result_ids;
+
+    /// 取回的异步分类结果
+    std::vector<Classifier::Prediction> async_predictions;
 
 public:
     /**
@@ -143,45 +271,63 @@ public:
      */
     bool run(const cv::Mat &src, const int enemy_color, Armor &target_armor);
 
-private:
     /**
-     * @brief 根据对方装甲板颜色, 将图像预处理成二值图像
+     * @brief 预处理阶段: 按当前 ROI 截取图像, 并根据对方装甲板颜色预处理成二值图像
      *
      * @param src 源图像
      * @param enemy_color 敌方颜色
+     * @param frame 存储本帧的中间结果
+     */
+    void preprocess(const cv::Mat &src, const int enemy_color, DetectionFrame &frame);
+
+    /**
+     * @brief 检测阶段: 寻找灯条, 匹配并识别装甲板, 然后更新 ROI
+     *
+     * @param frame 预处理阶段得到的中间结果
+     * @param target_armor 存储最终找到的目标装甲板
+     * @return 是否找到装甲板
      */
-    void Preprocess(const cv::Mat &src, const int enemy_color);
+    bool detect(DetectionFrame &frame, Armor &target_armor);
+
+private:
+    /**
+     * @brief 根据对方装甲板颜色, 将 ROI 图像预处理成二值图像
+     *
+     * @param frame 本帧的中间结果, 需已截取好 ROI 图像
+     */
+    void Preprocess(DetectionFrame &frame);
 
     /**
      * @brief 找出所有灯条, 匹配成装甲板
      *
-     * @param enemy_color 敌方颜色
+     * @param frame 本帧的中间结果
      * @param armors 存放找到的候选装甲板
      */
-    void findTarget(const int enemy_color, std::vector<Armor> &armors);
+    void findTarget(const DetectionFrame &frame, std::vector<Armor> &armors);
 
     /**
-     * @brief 对灯条进行两两匹配, 根据一系列标准选出候选装甲板
+     * @brief 对灯条进行配对, 根据一系列标准选出候选装甲板
      *
-     * @param src 源图像
      * @param lightbars 灯条数组
-     * @param enemy_color 敌方颜色
+     * @param frame 本帧的中间结果
      * @param armors 存储找到的候选装甲板
      */
-    void findArmors(std::vector<cv::RotatedRect> &lightbars, const int enemy_color,
+    void findArmors(std::vector<cv::RotatedRect> &lightbars, const DetectionFrame &frame,
                     std::vector<Armor> &armors);
 
     /**
      * @brief 从候选装甲板中选出最合适的目标装甲板, 最终按照优先级从高到低排列
      *
+     * @param frame 本帧的中间结果
      * @param armors 候选装甲板
      */
-    void selectTarget(std::vector<Armor> &armors);
+    void selectTarget(const DetectionFrame &frame, std::vector<Armor> &armors);
 
     /**
      * @brief 统一灯条的旋转矩形的样式, height>width
      * 
      * @param rect 源旋转矩形
+     * @note LightbarExtractor 输出的灯条已是该样式
      */
     static void adjustLightBar(cv::RotatedRect &rect);
 
@@ -0,0 +1,92 @@
+#include "asyncclassifier.h"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+AsyncClassifier::~AsyncClassifier() {
+    close();
+}
+
+void AsyncClassifier::open(const Classifier &shared, int capacity) {
+    close();
+    classifier.reset(new Classifier(&shared));
+    this->capacity = classifier->reserve(max(1, capacity));
+    images.resize(this->capacity);
+    ids.resize(this->capacity);
+    predictions.resize(this->capacity);
+    state = IDLE;
+    worker = thread(&AsyncClassifier::classifyFunc, this);
+}
+
+void AsyncClassifier::close() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state = STOP;
+    }
+    condition.notify_one();
+    worker.join();
+    classifier.reset();
+    // 释放对上一批图像的引用
+    fill(images.begin(), images.end(), Mat());
+}
+
+bool AsyncClassifier::isOpen() const {
+    return worker.joinable();
+}
+
+bool AsyncClassifier::ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return isOpen() && state == IDLE;
+}
+
+bool AsyncClassifier::submit(const Mat *images, const uint64_t *ids, int count) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isOpen() || state != IDLE) {
+            return false;
+        }
+        this->count = min(count, capacity);
+        for (int i = 0; i < this->count; ++i) {
+            this->images[i] = images[i];
+            this->ids[i] = ids[i];
+        }
+        state = QUEUED;
+    }
+    condition.notify_one();
+    return true;
+}
+
+int AsyncClassifier::collect(vector<uint64_t> &ids, vector<Classifier::Prediction> &predictions) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != DONE) {
+        return 0;
+    }
+    ids.assign(this->ids.begin(), this->ids.begin() + count);
+    predictions.assign(this->predictions.begin(), this->predictions.begin() + count);
+    state = IDLE;
+    return count;
+}
+
+void AsyncClassifier::classifyFunc() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        condition.wait(lock, [this] { return state == QUEUED || state == STOP; });
+        if (state == STOP) {
+            break;
+        }
+        // 推理期间检测线程不会改写请求, 不必持有锁
+        state = RUNNING;
+        lock.unlock();
+        classifier->predictBatch(images.data(), count, predictions.data());
+        lock.lock();
+        if (state == STOP) {
+            break;
+        }
+        state = DONE;
+    }
+}
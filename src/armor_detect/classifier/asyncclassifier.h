@@ -0,0 +1,130 @@
+/**
+ * @file asyncclassifier.h
+ * @brief 异步数字分类器
+ * @details 在后台线程中对数字图像分类, 检测线程提交后立即返回, 下一帧再取回结果,
+ * 装甲板的几何解算和弹道计算不再等待推理. 同一时间只有一批请求在处理, 后台线程忙时不接受新请求
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef ASYNCCLASSIFIER_H
+#define ASYNCCLASSIFIER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "classifier.h"
+
+/**
+ * @brief 异步数字分类器类
+ * 每个请求附带调用者给定的编号, 结果按相同编号返回. 只应由一个线程提交和取回
+ */
+class AsyncClassifier {
+private:
+    /// 请求的处理状态
+    enum State {
+        /// 没有请求, 可以提交
+        IDLE,
+        /// 已提交, 等待后台线程处理
+        QUEUED,
+        /// 后台线程正在推理
+        RUNNING,
+        /// 已完成, 等待取回
+        DONE,
+        /// 通知后台线程退出
+        STOP
+    };
+
+    /// 与检测线程的分类器共用权重的分类器, 只在后台线程中推理
+    std::unique_ptr<Classifier> classifier;
+
+    /// 一批请求最多包含的图像数
+    int capacity = 0;
+
+    State state = IDLE;
+
+    /// 保护请求状态和请求、结果缓冲区
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    /// 请求的图像, 只引用不拷贝, 提交后调用者不应改写
+    std::vector<cv::Mat> images;
+
+    /// 请求的编号
+    std::vector<uint64_t> ids;
+
+    /// 本批请求的图像数
+    int count = 0;
+
+    /// 分类结果
+    std::vector<Classifier::Prediction> predictions;
+
+    /// 后台线程
+    std::thread worker;
+
+public:
+    /**
+     * @brief 析构函数, 等待正在处理的请求完成后退出
+     */
+    ~AsyncClassifier();
+
+    /**
+     * @brief 开启后台线程
+     *
+     * @param shared 检测线程使用的分类器, 需已完成量化等改写权重的设置
+     * @param capacity 一批请求最多包含的图像数
+     */
+    void open(const Classifier &shared, int capacity);
+
+    /**
+     * @brief 关闭后台线程, 丢弃尚未取回的结果
+     */
+    void close();
+
+    /**
+     * @brief 返回是否已开启
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief 返回当前是否可以提交请求
+     */
+    bool ready();
+
+    /**
+     * @brief 提交一批图像, 不阻塞
+     *
+     * @param images 图像数组
+     * @param ids 各图像的编号
+     * @param count 图像数, 超出 capacity 的部分不处理
+     * @return 是否已提交, 后台线程还有未取回的请求时不提交
+     */
+    bool submit(const cv::Mat *images, const uint64_t *ids, int count);
+
+    /**
+     * @brief 取回已完成的分类结果, 不阻塞
+     *
+     * @param ids 存放结果对应的编号
+     * @param predictions 存放分类结果
+     * @return 结果数, 没有已完成的请求时为 0
+     */
+    int collect(std::vector<uint64_t> &ids, std::vector<Classifier::Prediction> &predictions);
+
+private:
+    /**
+     * @brief 后台线程函数
+     */
+    void classifyFunc();
+};
+
+#endif // ASYNCCLASSIFIER_H
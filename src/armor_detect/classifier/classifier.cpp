@@ -1,12 +1,15 @@
 #include "classifier.h"
 
+#include <algorithm>
+#include <fstream>
+
 using namespace cv;
 using namespace std;
 
-Classifier::Classifier(char *cfg_file, char *weight_file, const char *name_file) {
-    net = load_network(cfg_file, weight_file, 0);
-    set_batch_network(net, 1);
-    srand(2222222);
+Classifier::Classifier(const string &backend_name, const string &cfg_file, const string &weight_file,
+                       const string &name_file) : backend(ClassifierBackend::create(backend_name, cfg_file, weight_file)),
+                                                  capacity(0) {
+    CV_Assert(backend);
 
     // 标签文件
     ifstream f_label(name_file);
@@ -17,30 +20,67 @@ Classifier::Classifier(char *cfg_file, char *weight_file, const char *name_file)
         }
     }
 
-    size_t srcSize = 28 * 28 * 3 * sizeof(float);
-    input = (float *) malloc(srcSize);
+    reserve(1);
 }
 
-int Classifier::predict(const cv::Mat &src) {
-    // 将图像转为yolo形式
-    imgConvert(src, input);
+Classifier::Classifier(const Classifier *shared) : labels(shared->labels),
+                                                   backend(shared->backend->share()),
+                                                   capacity(0) {
+    reserve(1);
+}
 
-    // 网络推理
-    float *predictions = network_predict(net, input);
+const char *Classifier::backendName() const {
+    return backend->name();
+}
 
-    if (net->hierarchy) {
-        hierarchy_predictions(predictions, net->outputs, net->hierarchy, 1, 1);
-    }
-    int *indexes = (int *) calloc(TOP, sizeof(int));
-    top_k(predictions, net->outputs, TOP, indexes);
-    for (int i = 0; i < TOP; ++i) {
-        int index = indexes[i];
-        printf("%5.2f%%: %s\n", predictions[index] * 100, labels[index].c_str());
+int Classifier::reserve(int batch) {
+    capacity = backend->reserve(batch);
+    input.resize(capacity * backend->inputs());
+    return capacity;
+}
+
+bool Classifier::quantize(const std::string &ranges_file) {
+    return backend->quantize(ranges_file);
+}
+
+bool Classifier::useGenerated(bool enable) {
+    return backend->useGenerated(enable);
+}
+
+void Classifier::predictBatch(const cv::Mat *images, int count, Prediction *results) {
+    int inputs = backend->inputs();
+    int outputs = backend->outputs();
+    for (int start = 0; start < count; start += capacity) {
+        int batch = min(capacity, count - start);
+
+        // 将图像转为yolo形式, 依次排列在输入缓冲区中
+        for (int i = 0; i < batch; ++i) {
+            imgConvert(images[start + i], input.data() + i * inputs);
+        }
+
+        // 一次前向推理处理所有图像, 各层的固定开销由这些图像分摊
+        const float *predictions = backend->forward(input.data(), batch);
+
+        for (int i = 0; i < batch; ++i) {
+            decode(predictions + i * outputs, results[start + i]);
+        }
     }
-    return indexes[0];
+}
+
+void Classifier::decode(const float *prediction, Prediction &result) {
+    int index = static_cast<int>(max_element(prediction, prediction + backend->outputs()) - prediction);
+    result.label = index;
+    result.confidence = prediction[index];
+}
+
+int Classifier::predict(const cv::Mat &src) {
+    Prediction result;
+    predictBatch(&src, 1, &result);
+    return result.label;
 }
 
 void Classifier::imgConvert(const cv::Mat &img, float *dst) {
+    CV_Assert(img.rows * img.cols * img.channels() == backend->inputs() && img.isContinuous());
     uchar *data = img.data;
     int h = img.rows;
     int w = img.cols;
@@ -1,9 +1,13 @@
 /**
  * @file classifier.h
  * @brief 数字分类器
- * @details 以28*28的cv::Mat图像为输入, 进行分类返回装甲板数字
+ * @details 以28*28的cv::Mat图像为输入, 进行分类返回装甲板数字.
+ * 支持一次前向推理处理多张图像, 推理过程中不分配内存, 不输出日志.
+ * 多个分类器可以共用一份权重, 各自只持有激活缓冲区, 在不同线程上同时推理.
+ * 推理由可替换的后端完成, 按名称选择 darknet 网络、像素特征线性模型或小型 MLP
  * @author 陆展
  * @version 2021 Season
+ * @update 董行健
  * @email 965105951@qq.com
  * @date 2020-10-03
  * @license Copyright© 2021 HITwh HERO-RoboMaster Group
@@ -11,23 +15,108 @@
 #ifndef CLASSIFIER_H
 #define CLASSIFIER_H
 
+#include <memory>
+
 #include <opencv2/opencv.hpp>
-#include <darknet.h>
+
+#include "classifierbackend.h"
 
 class Classifier {
 public:
+    /// 单张图像的分类结果
+    struct Prediction {
+        /// 类别编号, 即装甲板数字
+        int label;
+
+        /// 置信度
+        float confidence;
+    };
+
     std::vector<std::string> labels;
 private:
-    network *net;
-    constexpr static int TOP = 1;
-    float *input;
+    /// 推理后端, 共用权重的分类器各自持有一个与首个分类器共用权重的后端
+    std::unique_ptr<ClassifierBackend> backend;
+
+    std::vector<float> input;
+
+    /// 输入缓冲区能容纳的图像数
+    int capacity;
 public:
-    Classifier(char *cfg_file, char *weight_file, const char *name_list);
+    /**
+     * @brief 加载模型和标签, 后端名称未知或模型与后端不符时终止
+     *
+     * @param backend_name 后端名称: darknet, linear 或 mlp
+     * @param cfg_file darknet 配置文件
+     * @param weight_file 权重文件
+     * @param name_file 标签文件, 每行一个类别
+     */
+    Classifier(const std::string &backend_name, const std::string &cfg_file, const std::string &weight_file,
+               const std::string &name_file);
+
+    /**
+     * @brief 与 shared 共用权重和标签, 不再加载文件, 只按 reserve() 的图像数分配激活缓冲区.
+     * 两个分类器可以在不同线程上同时推理
+     *
+     * @param shared 已加载的分类器
+     */
+    explicit Classifier(const Classifier *shared);
+
+    Classifier(const Classifier &) = delete;
 
+    Classifier &operator=(const Classifier &) = delete;
+
+    /// 后端名称
+    const char *backendName() const;
+
+    /**
+     * @brief 设置一次推理最多处理的图像数, 预先分配输入缓冲区, 需在推理前调用
+     *
+     * @param batch 图像数, darknet 后端不超过网络加载时的批大小
+     * @return 实际的最大图像数
+     */
+    int reserve(int batch);
+
+    /**
+     * @brief 按标定好的各层输入范围把卷积层量化为 INT8 推理, 范围文件由 darknet int8 calibrate 生成.
+     * 会改写权重, 只能在创建共用权重的分类器之前, 由加载权重的分类器调用; 只有 darknet 后端支持
+     *
+     * @param ranges_file 范围文件路径, 为空时保持 FP32 推理
+     * @return 是否已量化
+     */
+    bool quantize(const std::string &ranges_file);
+
+    /**
+     * @brief 切换到由 darknet codegen 预先生成的网络推理, 与 darknet 解释执行的结果一致.
+     * 需以 CLASSIFIER_CODEGEN 编译进生成的源文件, 且它与加载的网络输入输出一致;
+     * 生成的网络按 FP32 推理, 不受 quantize() 影响; 只有 darknet 后端支持
+     *
+     * @param enable 是否使用生成的网络
+     * @return 是否已切换到生成的网络
+     */
+    bool useGenerated(bool enable);
+
+    /**
+     * @brief 一次前向推理对多张图像进行分类
+     *
+     * @param images 图像数组, 每张都是 28x28 的三通道图像, 像素数须与模型输入一致
+     * @param count 图像数, 超出 reserve() 设置的数量时分多次推理
+     * @param results 存放分类结果, 由调用者提供, 长度不小于 count
+     */
+    void predictBatch(const cv::Mat *images, int count, Prediction *results);
+
+    /**
+     * @brief 对单张图像进行分类
+     *
+     * @param src 28x28 的三通道图像
+     * @return 类别编号
+     */
     int predict(const cv::Mat &src);
 
 private:
     void imgConvert(const cv::Mat &img, float *dst);
+
+    /// 取概率最大的类别
+    void decode(const float *prediction, Prediction &result);
 };
 
 
@@ -0,0 +1,154 @@
+#include "classifierbackend.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#include <darknet.h>
+
+#include "darknetbackend.h"
+#include "linearbackend.h"
+#include "mlpbackend.h"
+
+using namespace std;
+
+unique_ptr<ClassifierBackend> ClassifierBackend::create(const string &name, const string &cfg_file,
+                                                        const string &weight_file) {
+    if (name == "darknet") {
+        return unique_ptr<ClassifierBackend>(new DarknetBackend(cfg_file, weight_file));
+    }
+    if (name != "linear" && name != "mlp") {
+        cerr << "unknown classifier backend: " << name << endl;
+        return nullptr;
+    }
+    vector<DenseLayer> layers;
+    float temperature;
+    if (!loadDenseLayers(cfg_file, weight_file, layers, temperature)) {
+        cerr << cfg_file << ": " << name << " backend needs connected layers followed by softmax" << endl;
+        return nullptr;
+    }
+    if (name == "linear" && layers.size() == 1) {
+        return unique_ptr<ClassifierBackend>(new LinearBackend(layers[0], temperature));
+    }
+    if (name == "mlp" && layers.size() == 2 && layers[0].outputs == MlpBackend::HIDDEN) {
+        return unique_ptr<ClassifierBackend>(new MlpBackend(layers[0], layers[1], temperature));
+    }
+    cerr << cfg_file << ": " << name << " backend needs "
+         << (name == "linear" ? "one connected layer" : "two connected layers, the first with 32 outputs") << endl;
+    return nullptr;
+}
+
+bool ClassifierBackend::quantize(const string &) {
+    return false;
+}
+
+bool ClassifierBackend::useGenerated(bool) {
+    return false;
+}
+
+bool ClassifierBackend::loadDenseLayers(const string &cfg_file, const string &weight_file,
+                                        vector<DenseLayer> &layers, float &temperature) {
+    vector<char> cfg(cfg_file.begin(), cfg_file.end());
+    vector<char> weights(weight_file.begin(), weight_file.end());
+    cfg.push_back('\0');
+    weights.push_back('\0');
+    network *net = load_inference_network(cfg.data(), weights.data());
+    layers.clear();
+    temperature = 0;
+    bool dense = true;
+    for (int i = 0; i < net->n && dense; ++i) {
+        const layer &l = net->layers[i];
+        if (l.type == DROPOUT) {
+            // 推理时 dropout 层原样输出
+            continue;
+        }
+        if (l.type == SOFTMAX) {
+            dense = i == net->n - 1 && l.groups == 1 && !l.softmax_tree;
+            temperature = l.temperature;
+            continue;
+        }
+        if (l.type != CONNECTED) {
+            dense = false;
+            break;
+        }
+        DenseLayer dense_layer;
+        dense_layer.inputs = l.inputs;
+        dense_layer.outputs = l.outputs;
+        switch (l.activation) {
+            case LINEAR:
+                dense_layer.activation = netkernels::Activation::LINEAR;
+                break;
+            case RELU:
+                dense_layer.activation = netkernels::Activation::RELU;
+                break;
+            case LEAKY:
+                dense_layer.activation = netkernels::Activation::LEAKY;
+                break;
+            case LOGISTIC:
+                dense_layer.activation = netkernels::Activation::LOGISTIC;
+                break;
+            case TANH:
+                dense_layer.activation = netkernels::Activation::TANH;
+                break;
+            default:
+                dense = false;
+                continue;
+        }
+        dense_layer.weights.assign(l.weights, l.weights + l.inputs * l.outputs);
+        dense_layer.biases.assign(l.biases, l.biases + l.outputs);
+        // darknet 只在加载时折叠卷积层的批归一化, 全连接层的在这里折叠
+        if (l.batch_normalize) {
+            for (int o = 0; o < l.outputs; ++o) {
+                float scale = l.scales[o] / (sqrtf(l.rolling_variance[o]) + .000001f);
+                for (int k = 0; k < l.inputs; ++k) {
+                    dense_layer.weights[o * l.inputs + k] *= scale;
+                }
+                dense_layer.biases[o] -= l.rolling_mean[o] * scale;
+            }
+        }
+        layers.push_back(move(dense_layer));
+    }
+    free_network(net);
+    return dense && !layers.empty();
+}
+
+void ClassifierBackend::activate(netkernels::Activation activation, float *x, int n) {
+    using netkernels::Activation;
+    for (int i = 0; i < n; ++i) {
+        switch (activation) {
+            case Activation::LINEAR:
+                break;
+            case Activation::RELU:
+                x[i] = netkernels::activate<Activation::RELU>(x[i]);
+                break;
+            case Activation::LEAKY:
+                x[i] = netkernels::activate<Activation::LEAKY>(x[i]);
+                break;
+            case Activation::LOGISTIC:
+                x[i] = netkernels::activate<Activation::LOGISTIC>(x[i]);
+                break;
+            case Activation::TANH:
+                x[i] = netkernels::activate<Activation::TANH>(x[i]);
+                break;
+        }
+    }
+}
+
+void ClassifierBackend::softmax(float *x, int n, float temperature) {
+    if (temperature == 0) {
+        return;
+    }
+    float largest = -FLT_MAX;
+    for (int i = 0; i < n; ++i) {
+        largest = max(largest, x[i]);
+    }
+    float sum = 0;
+    for (int i = 0; i < n; ++i) {
+        x[i] = expf(x[i] / temperature - largest / temperature);
+        sum += x[i];
+    }
+    for (int i = 0; i < n; ++i) {
+        x[i] /= sum;
+    }
+}
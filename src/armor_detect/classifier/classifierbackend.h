@@ -0,0 +1,115 @@
+/**
+ * @file classifierbackend.h
+ * @brief 数字分类器的推理后端
+ * @details Classifier 把图像转换为 CHW 排列、归一化到 [0, 1] 的输入后交给后端, 后端只负责由输入得到各类别的概率.
+ * 现有三种后端: darknet 网络, 像素特征线性模型, 隐层宽度固定的小型 MLP. 后两者的权重也由 darknet 训练,
+ * 配置文件只含全连接层和末尾的 softmax, 加载后换成各自的排列, 推理不经过 darknet
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef CLASSIFIERBACKEND_H
+#define CLASSIFIERBACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "netkernels.h"
+
+class ClassifierBackend {
+public:
+    /// 全连接层, 权重按 darknet 的 [输出][输入] 排列, 批归一化已折叠进权重和偏置
+    struct DenseLayer {
+        int inputs;
+        int outputs;
+        netkernels::Activation activation;
+        std::vector<float> weights;
+        std::vector<float> biases;
+    };
+
+    virtual ~ClassifierBackend() = default;
+
+    /**
+     * @brief 按名称创建后端并加载模型
+     *
+     * @param name 后端名称: darknet, linear 或 mlp
+     * @param cfg_file darknet 配置文件
+     * @param weight_file 权重文件
+     * @return 后端, 名称未知或模型与后端不符时为空
+     */
+    static std::unique_ptr<ClassifierBackend> create(const std::string &name, const std::string &cfg_file,
+                                                     const std::string &weight_file);
+
+    /// 后端名称, 与 create() 使用的名称一致
+    virtual const char *name() const = 0;
+
+    /// 单张图像的输入长度
+    virtual int inputs() const = 0;
+
+    /// 类别数
+    virtual int outputs() const = 0;
+
+    /**
+     * @brief 创建与本后端共用权重的后端, 新后端只持有自己的缓冲区, 两者可在不同线程上同时推理
+     *
+     * @return 新后端, 需再调用 reserve()
+     */
+    virtual std::unique_ptr<ClassifierBackend> share() const = 0;
+
+    /**
+     * @brief 设置一次推理最多处理的图像数, 预先分配缓冲区
+     *
+     * @param batch 图像数
+     * @return 实际的最大图像数
+     */
+    virtual int reserve(int batch) = 0;
+
+    /**
+     * @brief 前向推理, 不分配内存
+     *
+     * @param input 依次排列的各图像的输入
+     * @param batch 图像数, 不超过 reserve() 的返回值
+     * @return 依次排列的各图像各类别的概率, 下次推理前有效
+     */
+    virtual const float *forward(const float *input, int batch) = 0;
+
+    /**
+     * @brief 按 darknet int8 calibrate 生成的范围文件量化, 只有 darknet 后端支持
+     *
+     * @return 是否已量化
+     */
+    virtual bool quantize(const std::string &ranges_file);
+
+    /**
+     * @brief 切换到 darknet codegen 预先生成的网络, 只有 darknet 后端支持
+     *
+     * @return 是否已切换
+     */
+    virtual bool useGenerated(bool enable);
+
+protected:
+    /**
+     * @brief 读取只含全连接层、可选的 dropout 层和末尾 softmax 层的 darknet 网络
+     *
+     * @param cfg_file 配置文件
+     * @param weight_file 权重文件
+     * @param layers 各全连接层
+     * @param temperature softmax 的温度, 没有 softmax 层时为 0
+     * @return 网络是否只含这些层
+     */
+    static bool loadDenseLayers(const std::string &cfg_file, const std::string &weight_file,
+                                std::vector<DenseLayer> &layers, float &temperature);
+
+    /// 对 n 个值原地应用激活函数
+    static void activate(netkernels::Activation activation, float *x, int n);
+
+    /// 与 darknet softmax 层一致的原地归一化, temperature 为 0 时保持不变
+    static void softmax(float *x, int n, float temperature);
+};
+
+#endif //CLASSIFIERBACKEND_H
@@ -0,0 +1,52 @@
+/**
+ * @file generatednetwork.h
+ * @brief 预先生成的分类网络
+ * @details 由 darknet codegen 从配置文件和权重生成的网络源文件实现 GENERATED_NETWORK,
+ * 各层形状在编译期确定, 权重嵌入在程序中, 工作区的划分在生成时就已确定.
+ * 编译时以 CLASSIFIER_CODEGEN 指定生成的源文件, 分类器即可改用它推理
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef GENERATEDNETWORK_H
+#define GENERATEDNETWORK_H
+
+/**
+ * @brief 生成的网络
+ */
+struct GeneratedNetwork {
+    /// 生成时使用的配置文件
+    const char *cfg;
+
+    /// 输入图像宽度
+    int w;
+
+    /// 输入图像高度
+    int h;
+
+    /// 输入图像通道数
+    int c;
+
+    /// 输出个数, 即类别数
+    int outputs;
+
+    /// 一次推理需要的工作区大小, 以 float 计
+    int workspace;
+
+    /**
+     * @brief 对一张图像前向推理
+     *
+     * @param input 输入, 与 darknet 的输入排列相同
+     * @param output 输出, 长度为 outputs
+     * @param workspace 工作区, 长度不小于 workspace, 不同线程需各自提供
+     */
+    void (*forward)(const float *input, float *output, float *workspace);
+};
+
+extern const GeneratedNetwork GENERATED_NETWORK;
+
+#endif // GENERATEDNETWORK_H
@@ -0,0 +1,327 @@
+/**
+ * @file netkernels.h
+ * @brief 生成网络使用的各层计算模板
+ * @details 形状全部作为模板参数, 循环边界在编译期确定, 编译器可以完全展开和向量化.
+ * 卷积的内层循环使用 GCC/Clang 的向量扩展.
+ * 由 darknet codegen 生成的网络源文件按层顺序实例化这些模板, 不依赖 darknet 运行时,
+ * 计算结果与 darknet 对应层的前向推理一致
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef NETKERNELS_H
+#define NETKERNELS_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace netkernels {
+
+/// 激活函数, 与 darknet 中同名的激活函数一致. RELU 和 LEAKY 写成 max, 编译为无分支的指令,
+/// 输出正负混杂时不会因分支预测失败变慢
+enum class Activation {
+    LINEAR,
+    RELU,
+    LEAKY,
+    LOGISTIC,
+    TANH
+};
+
+/// 各层工作区大小的最大值, 生成的网络用它确定工作区的划分
+constexpr int maxOf(int a) {
+    return a;
+}
+
+template <class... Ts>
+constexpr int maxOf(int a, int b, Ts... rest) {
+    return maxOf(a > b ? a : b, rest...);
+}
+
+template <Activation A>
+inline float activate(float x);
+
+template <>
+inline float activate<Activation::LINEAR>(float x) {
+    return x;
+}
+
+template <>
+inline float activate<Activation::RELU>(float x) {
+    return std::max(x, 0.f);
+}
+
+template <>
+inline float activate<Activation::LEAKY>(float x) {
+    return std::max(x, .1f * x);
+}
+
+template <>
+inline float activate<Activation::LOGISTIC>(float x) {
+    return 1.f / (1.f + std::exp(-x));
+}
+
+template <>
+inline float activate<Activation::TANH>(float x) {
+    return (std::exp(2 * x) - 1) / (std::exp(2 * x) + 1);
+}
+
+/// 向量宽度, 与编译目标的 SIMD 寄存器一致, 没有 AVX 时按 SSE/NEON 的 4 个 float
+#if defined(__AVX__)
+constexpr int VEC_WIDTH = 8;
+#else
+constexpr int VEC_WIDTH = 4;
+#endif
+
+typedef float Vec __attribute__((vector_size(VEC_WIDTH * sizeof(float))));
+
+inline Vec loadVec(const float *p) {
+    Vec v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void storeVec(float *p, Vec v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+/**
+ * @brief 卷积层, 权重按 darknet 的 [filter][channel][ky][kx] 排列
+ * 先把输入展开到工作区中 (im2col, 行宽补齐到 TILE), 再按编译期确定的尺寸做矩阵乘法,
+ * 每次计算 ROWS 个卷积核 x TILE 个输出像素, 累加器全部留在寄存器中; 偏置和激活函数在写回时完成
+ *
+ * @tparam C 输入通道数
+ * @tparam H 输入高度
+ * @tparam W 输入宽度
+ * @tparam N 卷积核个数
+ * @tparam K 卷积核尺寸
+ * @tparam S 步长
+ * @tparam P 补零宽度
+ * @tparam G 分组数
+ * @tparam A 激活函数
+ */
+template <int C, int H, int W, int N, int K, int S, int P, int G, Activation A>
+struct Convolution {
+    constexpr static int OUT_H = (H + 2 * P - K) / S + 1;
+    constexpr static int OUT_W = (W + 2 * P - K) / S + 1;
+    constexpr static int PIXELS = OUT_H * OUT_W;
+
+    /// 一次计算的卷积核个数和输出像素个数
+    constexpr static int ROWS = 6;
+    constexpr static int TILE = 2 * VEC_WIDTH;
+
+    /// 展开后矩阵的行宽, 补齐到 TILE 个像素
+    constexpr static int LDC = (PIXELS + TILE - 1) / TILE * TILE;
+
+    constexpr static int GROUP_C = C / G;
+    constexpr static int GROUP_N = N / G;
+    constexpr static int GROUP_K = GROUP_C * K * K;
+
+    /// 需要的工作区大小, 以 float 计
+    constexpr static int WORKSPACE = GROUP_K * LDC;
+
+    static_assert(C % G == 0 && N % G == 0, "channels must divide into groups");
+
+    static void forward(const float *in, const float *weights, const float *biases, float *out, float *workspace) {
+        for (int g = 0; g < G; ++g) {
+            im2col(in + g * GROUP_C * H * W, workspace);
+            int n = 0;
+            for (; n + ROWS <= GROUP_N; n += ROWS) {
+                block<ROWS>(g * GROUP_N + n, workspace, weights, biases, out);
+            }
+            switch (GROUP_N - n) {
+                case 5: block<5>(g * GROUP_N + n, workspace, weights, biases, out); break;
+                case 4: block<4>(g * GROUP_N + n, workspace, weights, biases, out); break;
+                case 3: block<3>(g * GROUP_N + n, workspace, weights, biases, out); break;
+                case 2: block<2>(g * GROUP_N + n, workspace, weights, biases, out); break;
+                case 1: block<1>(g * GROUP_N + n, workspace, weights, biases, out); break;
+                default: break;
+            }
+        }
+    }
+
+private:
+    static void im2col(const float *in, float *cols) {
+        for (int c = 0; c < GROUP_C; ++c) {
+            for (int ky = 0; ky < K; ++ky) {
+                for (int kx = 0; kx < K; ++kx) {
+                    float *dst = cols + ((c * K + ky) * K + kx) * LDC;
+                    for (int y = 0; y < OUT_H; ++y) {
+                        int iy = y * S + ky - P;
+                        for (int x = 0; x < OUT_W; ++x) {
+                            int ix = x * S + kx - P;
+                            dst[y * OUT_W + x] = iy >= 0 && iy < H && ix >= 0 && ix < W ? in[(c * H + iy) * W + ix] : 0;
+                        }
+                    }
+                    for (int i = PIXELS; i < LDC; ++i) {
+                        dst[i] = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    /// R 个卷积核对全部输出像素的矩阵乘法
+    template <int R>
+    static void block(int filter, const float *cols, const float *weights, const float *biases, float *out) {
+        const float *w = weights + filter * GROUP_K;
+        for (int p = 0; p < LDC; p += TILE) {
+            Vec acc[R][2];
+            for (int r = 0; r < R; ++r) {
+                acc[r][0] = Vec{} + biases[filter + r];
+                acc[r][1] = acc[r][0];
+            }
+            for (int k = 0; k < GROUP_K; ++k) {
+                Vec b0 = loadVec(cols + k * LDC + p);
+                Vec b1 = loadVec(cols + k * LDC + p + VEC_WIDTH);
+                for (int r = 0; r < R; ++r) {
+                    acc[r][0] += w[r * GROUP_K + k] * b0;
+                    acc[r][1] += w[r * GROUP_K + k] * b1;
+                }
+            }
+            for (int r = 0; r < R; ++r) {
+                float tile[TILE];
+                storeVec(tile, acc[r][0]);
+                storeVec(tile + VEC_WIDTH, acc[r][1]);
+                float *dst = out + (filter + r) * PIXELS + p;
+                for (int i = 0; i < TILE && p + i < PIXELS; ++i) {
+                    dst[i] = activate<A>(tile[i]);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief 最大池化层, 输出尺寸和窗口偏移与 darknet 的 maxpool 层一致
+ *
+ * @tparam C 通道数
+ * @tparam H 输入高度
+ * @tparam W 输入宽度
+ * @tparam SIZE 窗口尺寸
+ * @tparam S 步长
+ * @tparam PAD 补齐宽度
+ */
+template <int C, int H, int W, int SIZE, int S, int PAD>
+struct MaxPool {
+    constexpr static int OUT_H = (H + PAD - SIZE) / S + 1;
+    constexpr static int OUT_W = (W + PAD - SIZE) / S + 1;
+    constexpr static int WORKSPACE = 0;
+
+    static void forward(const float *in, float *out) {
+        for (int c = 0; c < C; ++c) {
+            for (int y = 0; y < OUT_H; ++y) {
+                for (int x = 0; x < OUT_W; ++x) {
+                    float max = -FLT_MAX;
+                    for (int n = 0; n < SIZE; ++n) {
+                        int iy = y * S + n - PAD / 2;
+                        if (iy < 0 || iy >= H) continue;
+                        for (int m = 0; m < SIZE; ++m) {
+                            int ix = x * S + m - PAD / 2;
+                            if (ix >= 0 && ix < W && in[(c * H + iy) * W + ix] > max) {
+                                max = in[(c * H + iy) * W + ix];
+                            }
+                        }
+                    }
+                    out[(c * OUT_H + y) * OUT_W + x] = max;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief 全局平均池化层
+ *
+ * @tparam C 通道数
+ * @tparam H 输入高度
+ * @tparam W 输入宽度
+ */
+template <int C, int H, int W>
+struct AvgPool {
+    constexpr static int WORKSPACE = 0;
+
+    static void forward(const float *in, float *out) {
+        for (int c = 0; c < C; ++c) {
+            float sum = 0;
+            for (int i = 0; i < H * W; ++i) {
+                sum += in[c * H * W + i];
+            }
+            out[c] = sum / (H * W);
+        }
+    }
+};
+
+/**
+ * @brief 全连接层, 权重按 darknet 的 [output][input] 排列
+ *
+ * @tparam INPUTS 输入个数
+ * @tparam OUTPUTS 输出个数
+ * @tparam A 激活函数
+ */
+template <int INPUTS, int OUTPUTS, Activation A>
+struct Connected {
+    constexpr static int WORKSPACE = 0;
+
+    constexpr static int BODY = INPUTS / VEC_WIDTH * VEC_WIDTH;
+
+    static void forward(const float *in, const float *weights, const float *biases, float *out) {
+        for (int o = 0; o < OUTPUTS; ++o) {
+            const float *w = weights + o * INPUTS;
+            Vec acc = Vec{};
+            for (int i = 0; i < BODY; i += VEC_WIDTH) {
+                acc += loadVec(w + i) * loadVec(in + i);
+            }
+            float lanes[VEC_WIDTH];
+            storeVec(lanes, acc);
+            float sum = 0;
+            for (int i = 0; i < VEC_WIDTH; ++i) {
+                sum += lanes[i];
+            }
+            for (int i = BODY; i < INPUTS; ++i) {
+                sum += w[i] * in[i];
+            }
+            out[o] = activate<A>(sum + biases[o]);
+        }
+    }
+};
+
+/**
+ * @brief softmax 层, 各组分别归一化
+ *
+ * @tparam INPUTS 输入个数
+ * @tparam G 分组数
+ */
+template <int INPUTS, int G>
+struct Softmax {
+    constexpr static int WORKSPACE = 0;
+    constexpr static int GROUP_SIZE = INPUTS / G;
+
+    static void forward(const float *in, float *out, float temperature) {
+        for (int g = 0; g < G; ++g) {
+            const float *x = in + g * GROUP_SIZE;
+            float *y = out + g * GROUP_SIZE;
+            float largest = -FLT_MAX;
+            for (int i = 0; i < GROUP_SIZE; ++i) {
+                if (x[i] > largest) largest = x[i];
+            }
+            float sum = 0;
+            for (int i = 0; i < GROUP_SIZE; ++i) {
+                y[i] = std::exp(x[i] / temperature - largest / temperature);
+                sum += y[i];
+            }
+            for (int i = 0; i < GROUP_SIZE; ++i) {
+                y[i] /= sum;
+            }
+        }
+    }
+};
+
+} // namespace netkernels
+
+#endif // NETKERNELS_H
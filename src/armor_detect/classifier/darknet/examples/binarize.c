@@ -0,0 +1,240 @@
+#include "darknet.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Binary (xnor) inference of a classifier compared against FP32.
+ *
+ *   xnor report [cfg] [weights] [image dir] [-names names.list] [-layers 2,3,5] [-batch 16]
+ *
+ * binarizes the convolutional layers the cfg marks xnor=1, or the ones given
+ * with -layers, or else every convolutional layer but the first and the last,
+ * which XNOR networks keep in full precision. The images are run three ways:
+ * FP32 with no layer binarized, the float emulation darknet trains xnor
+ * layers with, and the bit-packed engine. The engine is checked against the
+ * emulation, which it should match up to rounding, and compared with FP32 on
+ * top-1 agreement, probability error, accuracy when the labels can be read
+ * from the file names as the classifier example does, and latency per patch.
+ *
+ * Images are loaded in the BGR order Classifier::imgConvert feeds the network,
+ * so the patches saved by the armor sampler can be used as they are.
+ */
+
+static int xnor_is_image(char *name)
+{
+    char *ext = strrchr(name, '.');
+    if(!ext) return 0;
+    return !strcmp(ext, ".jpg") || !strcmp(ext, ".png") || !strcmp(ext, ".bmp") || !strcmp(ext, ".jpeg");
+}
+
+static float *xnor_load_images(network *net, char *dir, char ***paths, int *n)
+{
+    DIR *d = opendir(dir);
+    if(!d) error(dir);
+    struct dirent *entry;
+    char **files = 0;
+    int count = 0;
+    while((entry = readdir(d))){
+        if(!xnor_is_image(entry->d_name)) continue;
+        char *path = calloc(strlen(dir) + strlen(entry->d_name) + 2, sizeof(char));
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        files = realloc(files, (count + 1)*sizeof(char *));
+        files[count++] = path;
+    }
+    closedir(d);
+    if(!count) error("No images found");
+
+    float *X = calloc((size_t)count*net->inputs, sizeof(float));
+    int i;
+    for(i = 0; i < count; ++i){
+        image im = load_image_color(files[i], net->w, net->h);
+        rgbgr_image(im);
+        memcpy(X + (size_t)i*net->inputs, im.data, net->inputs*sizeof(float));
+        free_image(im);
+    }
+    *paths = files;
+    *n = count;
+    return X;
+}
+
+/* predicts every image at the given batch, returns the best ms per image over a few rounds */
+static double xnor_predict(network *net, float *X, int n, int batch, float *out)
+{
+    int rounds = 5;
+    double best = 0;
+    int r, i;
+    set_batch_network(net, batch);
+    for(r = 0; r < rounds; ++r){
+        double start = what_time_is_it_now();
+        for(i = 0; i + batch <= n; i += batch){
+            float *p = network_predict(net, X + (size_t)i*net->inputs);
+            if(out) memcpy(out + (size_t)i*net->outputs, p, (size_t)batch*net->outputs*sizeof(float));
+        }
+        double ms = (what_time_is_it_now() - start)*1000/(i ? i : 1);
+        if(r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+/* marks the layers to binarize, returns how many */
+static int xnor_select_layers(network *net, char *list, int *selected)
+{
+    int i, count = 0;
+    int first = -1, last = -1;
+    for(i = 0; i < net->n; ++i){
+        selected[i] = 0;
+        if(net->layers[i].type != CONVOLUTIONAL) continue;
+        if(first < 0) first = i;
+        last = i;
+    }
+    if(list){
+        char *p = list;
+        while(*p){
+            i = atoi(p);
+            if(i < 0 || i >= net->n || net->layers[i].type != CONVOLUTIONAL) error("-layers must name convolutional layers");
+            selected[i] = 1;
+            while(*p && *p != ',') ++p;
+            if(*p) ++p;
+        }
+    } else {
+        for(i = 0; i < net->n; ++i) selected[i] = net->layers[i].xnor;
+        for(i = 0; i < net->n && !selected[i]; ++i);
+        if(i == net->n){
+            for(i = first + 1; i < last; ++i) selected[i] = net->layers[i].type == CONVOLUTIONAL;
+        }
+    }
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(selected[i] && l->groups != 1){
+            fprintf(stderr, "layer %d: grouped convolutions stay in FP32\n", i);
+            selected[i] = 0;
+        }
+        count += selected[i];
+    }
+    return count;
+}
+
+/* turns the selected layers into xnor layers or back, with the scratch the float emulation needs */
+static void xnor_set_layers(network *net, int *selected, int xnor)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(!selected[i]) continue;
+        l->xnor = xnor;
+        if(xnor && !l->binary_weights) l->binary_weights = calloc(l->nweights, sizeof(float));
+        if(xnor && !l->binary_input) l->binary_input = calloc((size_t)l->inputs*l->batch, sizeof(float));
+    }
+    pack_network_weights(net);
+}
+
+static void xnor_compare(float *a, float *b, int n, int outputs, int *agree, float *max_error, double *mean_error)
+{
+    int i, j;
+    double sum = 0;
+    *agree = 0;
+    *max_error = 0;
+    for(i = 0; i < n; ++i){
+        float *x = a + (size_t)i*outputs;
+        float *y = b + (size_t)i*outputs;
+        *agree += max_index(x, outputs) == max_index(y, outputs);
+        for(j = 0; j < outputs; ++j){
+            float e = fabsf(x[j] - y[j]);
+            if(e > *max_error) *max_error = e;
+            sum += e;
+        }
+    }
+    *mean_error = sum/((double)n*outputs);
+}
+
+static void xnor_report(char *cfg, char *weights, char *dir, char *names, char *list, int batch)
+{
+    network *net = load_inference_network(cfg, weights);
+    char **files;
+    int n, i, j;
+    float *X = xnor_load_images(net, dir, &files, &n);
+    int outputs = net->outputs;
+    float *fp32 = calloc((size_t)n*outputs, sizeof(float));
+    float *emulated = calloc((size_t)n*outputs, sizeof(float));
+    float *xnor = calloc((size_t)n*outputs, sizeof(float));
+    int *selected = calloc(net->n, sizeof(int));
+    /* the layers are allocated for the batch of the cfg */
+    if(batch > net->batch) batch = net->batch;
+    if(batch > n) batch = n;
+
+    int count = xnor_select_layers(net, list, selected);
+    if(!count) error("No layers to binarize");
+
+    xnor_set_layers(net, selected, 0);
+    double fp32_single = xnor_predict(net, X, n, 1, fp32);
+    double fp32_batch = xnor_predict(net, X, n, batch, 0);
+    xnor_set_layers(net, selected, 1);
+    unbinarize_xnor_network(net);
+    double emulated_single = xnor_predict(net, X, n, 1, emulated);
+    double emulated_batch = xnor_predict(net, X, n, batch, 0);
+    binarize_xnor_network(net);
+    double xnor_single = xnor_predict(net, X, n, 1, xnor);
+    double xnor_batch = xnor_predict(net, X, n, batch, 0);
+
+    char **labels = names ? get_labels(names) : 0;
+    int classes = labels ? outputs : 0;
+    int fp32_correct = 0, xnor_correct = 0, labeled = 0;
+    for(i = 0; i < n; ++i){
+        int truth = -1;
+        for(j = 0; j < classes; ++j){
+            if(strstr(files[i], labels[j])) truth = j;
+        }
+        if(truth < 0) continue;
+        ++labeled;
+        fp32_correct += max_index(fp32 + (size_t)i*outputs, outputs) == truth;
+        xnor_correct += max_index(xnor + (size_t)i*outputs, outputs) == truth;
+    }
+    int agree;
+    float max_error;
+    double mean_error;
+
+    printf("%d images, xnor kernel %s, binarized layers", n, xnor_kernel_name());
+    for(i = 0; i < net->n; ++i){
+        if(selected[i]) printf(" %d", i);
+    }
+    printf("\n");
+    xnor_compare(emulated, xnor, n, outputs, &agree, &max_error, &mean_error);
+    printf("vs float emulation   %.2f%% top-1 agreement, max |prob error| %g\n", 100.*agree/n, max_error);
+    xnor_compare(fp32, xnor, n, outputs, &agree, &max_error, &mean_error);
+    printf("top-1 agreement      %.2f%% (%d/%d)\n", 100.*agree/n, agree, n);
+    printf("max |prob error|     %g\n", max_error);
+    printf("mean |prob error|    %g\n", mean_error);
+    if(labeled){
+        printf("fp32 accuracy        %.2f%% (%d labeled)\n", 100.*fp32_correct/labeled, labeled);
+        printf("xnor accuracy        %.2f%%\n", 100.*xnor_correct/labeled);
+    }
+    printf("%-20s %10s %10s %10s\n", "ms per patch", "fp32", "emulated", "xnor");
+    printf("%-20s %10.4f %10.4f %10.4f\n", "batch 1", fp32_single, emulated_single, xnor_single);
+    printf("batch %-14d %10.4f %10.4f %10.4f\n", batch, fp32_batch, emulated_batch, xnor_batch);
+
+    free(selected);
+    free(fp32);
+    free(emulated);
+    free(xnor);
+    free(X);
+    free_ptrs((void **)files, n);
+    free_network(net);
+}
+
+void run_xnor(int argc, char **argv)
+{
+    if(argc < 6){
+        fprintf(stderr, "usage: %s %s report [cfg] [weights] [image dir] [-names names.list] [-layers 2,3,5] [-batch 16]\n", argv[0], argv[1]);
+        return;
+    }
+    gpu_index = -1;
+    char *names = find_char_arg(argc, argv, "-names", 0);
+    char *list = find_char_arg(argc, argv, "-layers", 0);
+    int batch = find_int_arg(argc, argv, "-batch", 16);
+    if(0 == strcmp(argv[2], "report")) xnor_report(argv[3], argv[4], argv[5], names, list, batch);
+    else fprintf(stderr, "Not an option: %s\n", argv[2]);
+}
@@ -0,0 +1,165 @@
+#include "darknet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Ahead-of-time code generation of a classifier.
+ *
+ *   codegen [cfg] [weights] [output.cpp]
+ *
+ * writes a C++ translation unit that defines GENERATED_NETWORK (see
+ * classifier/codegen/generatednetwork.h): every layer becomes an instance of
+ * the netkernels.h templates with its shapes as template arguments, weights
+ * are embedded as arrays with batch norm already folded, and the two
+ * ping-pong activation buffers plus the padding scratch are laid out in one
+ * workspace whose size is fixed here. Only the layers the armor classifiers
+ * use are supported; anything else stops the generator.
+ */
+
+static const char *codegen_activation(ACTIVATION a)
+{
+    switch(a){
+        case LINEAR: return "Activation::LINEAR";
+        case RELU: return "Activation::RELU";
+        case LEAKY: return "Activation::LEAKY";
+        case LOGISTIC: return "Activation::LOGISTIC";
+        case TANH: return "Activation::TANH";
+        default: break;
+    }
+    error("codegen: unsupported activation");
+    return 0;
+}
+
+/* a float literal with enough digits to read back the same value */
+static char *codegen_float(char *buf, float x)
+{
+    sprintf(buf, "%.9g", x);
+    if(!strpbrk(buf, ".en")) strcat(buf, ".");
+    strcat(buf, "f");
+    return buf;
+}
+
+static void codegen_array(FILE *fp, const char *name, int index, float *x, int n)
+{
+    int i;
+    char buf[32];
+    fprintf(fp, "alignas(32) const float %s_%d[] = {", name, index);
+    for(i = 0; i < n; ++i){
+        fprintf(fp, "%s%s%s", i ? "," : "", i % 8 ? " " : "\n    ", codegen_float(buf, x[i]));
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+static int codegen_is_compute(layer l)
+{
+    return l.type != DROPOUT && l.type != COST;
+}
+
+void run_codegen(int argc, char **argv)
+{
+    if(argc < 5){
+        fprintf(stderr, "usage: %s %s [cfg] [weights] [output.cpp]\n", argv[0], argv[1]);
+        return;
+    }
+    char *cfg = argv[2];
+    char *weights = argv[3];
+    char *outfile = argv[4];
+
+    gpu_index = -1;
+    network *net = load_inference_network(cfg, weights);
+    int i;
+    int last = -1;
+    size_t buffer_size = 0;
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(!codegen_is_compute(l)) continue;
+        if(l.type == CONVOLUTIONAL){
+            if(l.binary || l.xnor) error("codegen: binary convolutions are not supported");
+            codegen_activation(l.activation);
+        } else if(l.type == CONNECTED){
+            if(l.batch_normalize) error("codegen: batch normalized connected layers are not supported");
+            codegen_activation(l.activation);
+        } else if(l.type == SOFTMAX){
+            if(l.softmax_tree) error("codegen: softmax trees are not supported");
+        } else if(l.type != MAXPOOL && l.type != AVGPOOL){
+            fprintf(stderr, "codegen: layer %d: type not supported\n", i);
+            error("codegen: unsupported layer");
+        }
+        if((size_t)l.outputs > buffer_size) buffer_size = l.outputs;
+        last = i;
+    }
+    if(last < 0) error("codegen: no layers to generate");
+
+    FILE *fp = fopen(outfile, "w");
+    if(!fp) error(outfile);
+    char *cfg_name = strrchr(cfg, '/') ? strrchr(cfg, '/') + 1 : cfg;
+    char *weights_name = strrchr(weights, '/') ? strrchr(weights, '/') + 1 : weights;
+    fprintf(fp, "// Generated by darknet codegen from %s and %s, do not edit.\n\n", cfg_name, weights_name);
+    fprintf(fp, "#include \"generatednetwork.h\"\n#include \"netkernels.h\"\n\n");
+    fprintf(fp, "using namespace netkernels;\n\nnamespace {\n\n");
+
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(l.type == CONVOLUTIONAL){
+            fprintf(fp, "// %d: conv %d %dx%d/%d %dx%dx%d -> %dx%dx%d\n", i, l.n, l.size, l.size, l.stride, l.w, l.h, l.c, l.out_w, l.out_h, l.out_c);
+            fprintf(fp, "typedef Convolution<%d, %d, %d, %d, %d, %d, %d, %d, %s> Layer%d;\n\n",
+                    l.c, l.h, l.w, l.n, l.size, l.stride, l.pad, l.groups, codegen_activation(l.activation), i);
+            codegen_array(fp, "WEIGHTS", i, l.weights, l.nweights);
+            codegen_array(fp, "BIASES", i, l.biases, l.n);
+        } else if(l.type == CONNECTED){
+            fprintf(fp, "// %d: connected %d -> %d\n", i, l.inputs, l.outputs);
+            fprintf(fp, "typedef Connected<%d, %d, %s> Layer%d;\n\n", l.inputs, l.outputs, codegen_activation(l.activation), i);
+            codegen_array(fp, "WEIGHTS", i, l.weights, l.inputs*l.outputs);
+            codegen_array(fp, "BIASES", i, l.biases, l.outputs);
+        } else if(l.type == MAXPOOL){
+            fprintf(fp, "// %d: max %dx%d/%d %dx%dx%d -> %dx%dx%d\n", i, l.size, l.size, l.stride, l.w, l.h, l.c, l.out_w, l.out_h, l.out_c);
+            fprintf(fp, "typedef MaxPool<%d, %d, %d, %d, %d, %d> Layer%d;\n\n", l.c, l.h, l.w, l.size, l.stride, l.pad, i);
+        } else if(l.type == AVGPOOL){
+            fprintf(fp, "// %d: avg %dx%dx%d -> %d\n", i, l.w, l.h, l.c, l.outputs);
+            fprintf(fp, "typedef AvgPool<%d, %d, %d> Layer%d;\n\n", l.c, l.h, l.w, i);
+        } else if(l.type == SOFTMAX){
+            fprintf(fp, "// %d: softmax %d\n", i, l.inputs);
+            fprintf(fp, "typedef Softmax<%d, %d> Layer%d;\n\n", l.inputs, l.groups, i);
+        }
+    }
+
+    fprintf(fp, "// workspace: two ping-pong activation buffers, then the scratch the layers share\n");
+    fprintf(fp, "constexpr int BUFFER_SIZE = %d;\n", (int)buffer_size);
+    fprintf(fp, "constexpr int SCRATCH_SIZE = maxOf(0");
+    for(i = 0; i < net->n; ++i){
+        if(codegen_is_compute(net->layers[i])) fprintf(fp, ", Layer%d::WORKSPACE", i);
+    }
+    fprintf(fp, ");\n");
+
+    fprintf(fp, "\nvoid forward(const float *input, float *output, float *workspace) {\n");
+    fprintf(fp, "    float *buffer0 = workspace;\n");
+    fprintf(fp, "    float *buffer1 = workspace + BUFFER_SIZE;\n");
+    fprintf(fp, "    float *scratch = workspace + 2 * BUFFER_SIZE;\n");
+    const char *src = "input";
+    char buf[32];
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(!codegen_is_compute(l)) continue;
+        const char *dst = i == last ? "output" : (strcmp(src, "buffer0") ? "buffer0" : "buffer1");
+        if(l.type == CONVOLUTIONAL){
+            fprintf(fp, "    Layer%d::forward(%s, WEIGHTS_%d, BIASES_%d, %s, scratch);\n", i, src, i, i, dst);
+        } else if(l.type == CONNECTED){
+            fprintf(fp, "    Layer%d::forward(%s, WEIGHTS_%d, BIASES_%d, %s);\n", i, src, i, i, dst);
+        } else if(l.type == SOFTMAX){
+            fprintf(fp, "    Layer%d::forward(%s, %s, %s);\n", i, src, dst, codegen_float(buf, l.temperature));
+        } else {
+            fprintf(fp, "    Layer%d::forward(%s, %s);\n", i, src, dst);
+        }
+        src = dst;
+    }
+    fprintf(fp, "}\n\n} // namespace\n\n");
+    fprintf(fp, "const GeneratedNetwork GENERATED_NETWORK = {\n");
+    fprintf(fp, "    \"%s\", %d, %d, %d, %d, 2 * BUFFER_SIZE + SCRATCH_SIZE, forward\n", cfg_name, net->w, net->h, net->c, net->layers[last].outputs);
+    fprintf(fp, "};\n");
+    fclose(fp);
+
+    fprintf(stderr, "Generated %s\n", outfile);
+    free_network(net);
+}
@@ -0,0 +1,144 @@
+#include "darknet.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Per-layer timing of the CPU convolution algorithms.
+ *
+ * Every convolutional layer of the cfg is run through im2col + GEMM, the
+ * direct loop and Winograd F(2x2, 3x3) where the algorithm applies, on the
+ * same random input. The output of each is compared against GEMM and the
+ * algorithm select_conv_algorithm() picks for the layer is marked with '*'.
+ * A last line times the whole network with and without the selection.
+ * Batch norm is folded as load_inference_network does unless -fold 0.
+ */
+
+static int convbench_applicable(layer l, CONV_ALGORITHM a)
+{
+    if(l.groups != 1 || l.binary || l.xnor) return a == CONV_GEMM;
+    if(a == CONV_WINOGRAD) return l.size == 3 && l.stride == 1;
+    return 1;
+}
+
+/* best of several rounds, the layers are small enough for scheduler noise to dominate a plain mean;
+ * times the whole network on input when l is null */
+static double convbench_time(network *net, layer *l, float *input, int iters)
+{
+    int rounds = 10;
+    int per_round = (iters + rounds - 1)/rounds;
+    double best = 0;
+    int r, i;
+    pack_network_weights(net);
+    for(r = 0; r < rounds; ++r){
+        double start = what_time_is_it_now();
+        for(i = 0; i < per_round; ++i){
+            if(l) l->forward(*l, *net);
+            else network_predict(net, input);
+        }
+        double ms = (what_time_is_it_now() - start)/per_round*1000;
+        if(r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+void run_convbench(int argc, char **argv)
+{
+    if(argc < 3){
+        fprintf(stderr, "usage: %s %s [cfg] [weights/optional] [-iters 100] [-fold 1]\n", argv[0], argv[1]);
+        return;
+    }
+    char *cfg = argv[2];
+    char *weights = (argc > 3 && argv[3][0] != '-') ? argv[3] : 0;
+    int iters = find_int_arg(argc, argv, "-iters", 100);
+    int fold = find_int_arg(argc, argv, "-fold", 1);
+
+    gpu_index = -1;
+    network *net = parse_network_cfg(cfg);
+    if(weights) load_weights(net, weights);
+    if(fold) fold_batchnorm_network(net);
+    set_batch_network(net, 1);
+    net->train = 0;
+
+    int i, a, j;
+    size_t workspace_size = 0;
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(l.type != CONVOLUTIONAL) continue;
+        for(a = CONV_GEMM; a <= CONV_WINOGRAD; ++a){
+            l.conv_algorithm = a;
+            size_t size = conv_algorithm_workspace_size(l);
+            if(size > workspace_size) workspace_size = size;
+        }
+        if(l.workspace_size > workspace_size) workspace_size = l.workspace_size;
+    }
+    float *workspace = calloc(workspace_size/sizeof(float) + 1, sizeof(float));
+
+    printf("ms per forward for %s, batch 1, %d iterations, * = selected\n", cfg, iters);
+    printf("%3s %4s %4s %4s %9s %5s %10s %10s %10s %9s\n", "#", "c", "n", "size", "out", "str", "gemm", "direct", "winograd", "max err");
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type != CONVOLUTIONAL) continue;
+        float *input = calloc(l->inputs, sizeof(float));
+        float *expected = calloc(l->outputs, sizeof(float));
+        for(j = 0; j < l->inputs; ++j){
+            input[j] = rand_uniform(-1, 1);
+        }
+        float *saved_input = net->input;
+        float *saved_workspace = net->workspace;
+        net->input = input;
+        net->workspace = workspace;
+
+        CONV_ALGORITHM selected = l->conv_algorithm;
+        double max_error = 0;
+        printf("%3d %4d %4d %2dx%-2d %4dx%-4d %5d", i, l->c, l->n, l->size, l->size, l->out_w, l->out_h, l->stride);
+        for(a = CONV_GEMM; a <= CONV_WINOGRAD; ++a){
+            if(!convbench_applicable(*l, a)){
+                printf(" %10s", "-");
+                continue;
+            }
+            l->conv_algorithm = a;
+            double ms = convbench_time(net, l, 0, iters);
+            printf(" %9.3f%c", ms, a == selected ? '*' : ' ');
+            if(a == CONV_GEMM){
+                memcpy(expected, l->output, l->outputs*sizeof(float));
+                continue;
+            }
+            for(j = 0; j < l->outputs; ++j){
+                double error = fabs(l->output[j] - expected[j])/(fabs(expected[j]) + 1);
+                if(error > max_error) max_error = error;
+            }
+        }
+        printf(" %9.2g\n", max_error);
+
+        l->conv_algorithm = selected;
+        net->input = saved_input;
+        net->workspace = saved_workspace;
+        free(input);
+        free(expected);
+    }
+    free(workspace);
+
+    /* the whole network once with every layer on GEMM and once with the selected algorithms */
+    float *input = calloc(net->inputs, sizeof(float));
+    CONV_ALGORITHM *selected = calloc(net->n, sizeof(CONV_ALGORITHM));
+    for(j = 0; j < net->inputs; ++j){
+        input[j] = rand_uniform(0, 1);
+    }
+    for(i = 0; i < net->n; ++i){
+        selected[i] = net->layers[i].conv_algorithm;
+        net->layers[i].conv_algorithm = CONV_GEMM;
+    }
+    double gemm_ms = convbench_time(net, 0, input, iters);
+    for(i = 0; i < net->n; ++i){
+        net->layers[i].conv_algorithm = selected[i];
+    }
+    double selected_ms = convbench_time(net, 0, input, iters);
+    printf("network: %.3f ms all gemm, %.3f ms selected\n", gemm_ms, selected_ms);
+
+    free(input);
+    free(selected);
+    free_network(net);
+}
@@ -21,6 +21,14 @@ extern void run_go(int argc, char **argv);
 extern void run_art(int argc, char **argv);
 extern void run_super(int argc, char **argv);
 extern void run_lsd(int argc, char **argv);
+extern void run_gemmbench(int argc, char **argv);
+extern void run_convbench(int argc, char **argv);
+extern void run_int8(int argc, char **argv);
+extern void run_xnor(int argc, char **argv);
+extern void run_codegen(int argc, char **argv);
+extern void run_memory(int argc, char **argv);
+extern void run_pack(int argc, char **argv);
+extern void run_profiler(int argc, char **argv);
 
 void average(int argc, char *argv[])
 {
@@ -419,6 +427,15 @@ int main(int argc, char **argv)
     }
 #endif
 
+    int threads = find_int_arg(argc, argv, "-threads", 0);
+    char *core_list = find_char_arg(argc, argv, "-cores", 0);
+    if(threads || core_list){
+        int ncores = 0;
+        int *cores = core_list ? read_intlist(core_list, &ncores, 0) : 0;
+        thread_pool_init(threads, cores, ncores);
+        free(cores);
+    }
+
     if (0 == strcmp(argv[1], "average")){
         average(argc, argv);
     } else if (0 == strcmp(argv[1], "yolo")){
@@ -477,6 +494,22 @@ int main(int argc, char **argv)
         rescale_net(argv[2], argv[3], argv[4]);
     } else if (0 == strcmp(argv[1], "ops")){
         operations(argv[2]);
+    } else if (0 == strcmp(argv[1], "gemmbench")){
+        run_gemmbench(argc, argv);
+    } else if (0 == strcmp(argv[1], "convbench")){
+        run_convbench(argc, argv);
+    } else if (0 == strcmp(argv[1], "int8")){
+        run_int8(argc, argv);
+    } else if (0 == strcmp(argv[1], "xnor")){
+        run_xnor(argc, argv);
+    } else if (0 == strcmp(argv[1], "codegen")){
+        run_codegen(argc, argv);
+    } else if (0 == strcmp(argv[1], "memory")){
+        run_memory(argc, argv);
+    } else if (0 == strcmp(argv[1], "pack")){
+        run_pack(argc, argv);
+    } else if (0 == strcmp(argv[1], "profile")){
+        run_profiler(argc, argv);
     } else if (0 == strcmp(argv[1], "speed")){
         speed(argv[2], (argc > 3 && argv[3]) ? atoi(argv[3]) : 0);
     } else if (0 == strcmp(argv[1], "oneoff")){
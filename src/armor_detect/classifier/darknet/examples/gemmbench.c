@@ -0,0 +1,121 @@
+#include "darknet.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * GEMM throughput for the exact shapes a network runs at inference time.
+ *
+ * Every convolutional and connected layer of the cfg is turned into the
+ * M/N/K of the gemm() call its forward pass makes, then timed with the
+ * reference triple loops and with each blocked kernel the CPU supports
+ * (weights pre-packed, as load_network does).
+ */
+
+static float *gemmbench_matrix(int rows, int cols)
+{
+    int i;
+    float *m = calloc((size_t)rows*cols, sizeof(float));
+    for(i = 0; i < rows*cols; ++i){
+        m[i] = rand_uniform(-1, 1);
+    }
+    return m;
+}
+
+static void gemmbench_layer(int index, char *type, int TB, int M, int N, int K, int iters)
+{
+    float *a = gemmbench_matrix(M, K);
+    float *b = TB ? gemmbench_matrix(N, K) : gemmbench_matrix(K, N);
+    int ldb = TB ? K : N;
+    float *expected = calloc((size_t)M*N, sizeof(float));
+    float *c = calloc((size_t)M*N, sizeof(float));
+    double flops = 2.*M*N*K*iters;
+    int i, t;
+
+    gemm_cpu_naive(0, TB, M, N, K, 1, a, K, b, ldb, 0, expected, N);
+    double start = what_time_is_it_now();
+    for(i = 0; i < iters; ++i){
+        gemm_cpu_naive(0, TB, M, N, K, 1, a, K, b, ldb, 0, c, N);
+    }
+    double naive = flops/(what_time_is_it_now() - start)/1e9;
+    printf("%3d %-5s %5d %5d %5d %9.2f", index, type, M, N, K, naive);
+
+    int original = gemm_get_kernel();
+    double max_error = 0;
+    for(t = 0; t < gemm_kernel_count(); ++t){
+        if(!gemm_kernel_supported(t)){
+            printf(" %9s", "-");
+            continue;
+        }
+        gemm_set_kernel(t);
+        float *packed;
+        if(TB){
+            packed = calloc(gemm_packed_size_b(K, N), sizeof(float));
+            gemm_pack_b(TB, K, N, b, ldb, packed);
+        } else {
+            packed = calloc(gemm_packed_size_a(M, K), sizeof(float));
+            gemm_pack_a(0, M, K, a, K, packed);
+        }
+        float *packed_a = TB ? 0 : packed;
+        float *packed_b = TB ? packed : 0;
+
+        gemm_cpu_packed(0, TB, M, N, K, 1, a, K, packed_a, b, ldb, packed_b, 0, c, N);
+        start = what_time_is_it_now();
+        for(i = 0; i < iters; ++i){
+            gemm_cpu_packed(0, TB, M, N, K, 1, a, K, packed_a, b, ldb, packed_b, 0, c, N);
+        }
+        double gflops = flops/(what_time_is_it_now() - start)/1e9;
+        printf(" %9.2f", gflops);
+
+        for(i = 0; i < M*N; ++i){
+            double error = fabs(c[i] - expected[i])/(fabs(expected[i]) + 1);
+            if(error > max_error) max_error = error;
+        }
+        free(packed);
+    }
+    gemm_set_kernel(original);
+    printf(" %9.2g\n", max_error);
+
+    free(a);
+    free(b);
+    free(expected);
+    free(c);
+}
+
+void run_gemmbench(int argc, char **argv)
+{
+    if(argc < 3){
+        fprintf(stderr, "usage: %s %s [cfg] [-iters 100] [-batch 1]\n", argv[0], argv[1]);
+        return;
+    }
+    char *cfg = argv[2];
+    int iters = find_int_arg(argc, argv, "-iters", 100);
+    int batch = find_int_arg(argc, argv, "-batch", 1);
+
+    gpu_index = -1;
+    network *net = parse_network_cfg(cfg);
+    set_batch_network(net, batch);
+
+    int t, i;
+    printf("GFLOP/s for %s, batch %d, %d iterations, default kernel %s\n", cfg, batch, iters, gemm_kernel_name(gemm_get_kernel()));
+    printf("%3s %-5s %5s %5s %5s %9s", "#", "type", "M", "N", "K", "naive");
+    for(t = 0; t < gemm_kernel_count(); ++t){
+        printf(" %9s", gemm_kernel_name(t));
+    }
+    printf(" %9s\n", "max err");
+
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(l.type == CONVOLUTIONAL){
+            int m = l.n/l.groups;
+            int k = l.size*l.size*l.c/l.groups;
+            int n = l.out_w*l.out_h;
+            gemmbench_layer(i, "conv", 0, m, n, k, iters);
+        } else if(l.type == CONNECTED){
+            gemmbench_layer(i, "conn", 1, l.batch, l.outputs, l.inputs, iters);
+        }
+    }
+    free_network(net);
+}
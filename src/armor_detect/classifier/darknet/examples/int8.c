@@ -0,0 +1,178 @@
+#include "darknet.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * INT8 post-training quantization of a classifier.
+ *
+ *   int8 calibrate [cfg] [weights] [image dir] [ranges]
+ *       runs the FP32 network over every image of the directory and writes the
+ *       input range of each convolutional layer to the ranges file.
+ *   int8 report [cfg] [weights] [ranges] [image dir] [-names names.list]
+ *       compares the INT8 network against FP32 on the images: top-1 agreement,
+ *       probability error, accuracy when the labels can be read from the file
+ *       names as the classifier example does, and latency per patch.
+ *
+ * Images are loaded in the BGR order Classifier::imgConvert feeds the network,
+ * so the patches saved by the armor sampler can be used as they are.
+ */
+
+static int int8_is_image(char *name)
+{
+    char *ext = strrchr(name, '.');
+    if(!ext) return 0;
+    return !strcmp(ext, ".jpg") || !strcmp(ext, ".png") || !strcmp(ext, ".bmp") || !strcmp(ext, ".jpeg");
+}
+
+static float *int8_load_images(network *net, char *dir, char ***paths, int *n)
+{
+    DIR *d = opendir(dir);
+    if(!d) error(dir);
+    struct dirent *entry;
+    char **files = 0;
+    int count = 0;
+    while((entry = readdir(d))){
+        if(!int8_is_image(entry->d_name)) continue;
+        char *path = calloc(strlen(dir) + strlen(entry->d_name) + 2, sizeof(char));
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        files = realloc(files, (count + 1)*sizeof(char *));
+        files[count++] = path;
+    }
+    closedir(d);
+    if(!count) error("No images found");
+
+    float *X = calloc((size_t)count*net->inputs, sizeof(float));
+    int i;
+    for(i = 0; i < count; ++i){
+        image im = load_image_color(files[i], net->w, net->h);
+        rgbgr_image(im);
+        memcpy(X + (size_t)i*net->inputs, im.data, net->inputs*sizeof(float));
+        free_image(im);
+    }
+    *paths = files;
+    *n = count;
+    return X;
+}
+
+/* predicts every image at the given batch, returns the best ms per image over a few rounds */
+static double int8_predict(network *net, float *X, int n, int batch, float *out)
+{
+    int rounds = 5;
+    double best = 0;
+    int r, i;
+    set_batch_network(net, batch);
+    for(r = 0; r < rounds; ++r){
+        double start = what_time_is_it_now();
+        for(i = 0; i + batch <= n; i += batch){
+            float *p = network_predict(net, X + (size_t)i*net->inputs);
+            if(out) memcpy(out + (size_t)i*net->outputs, p, (size_t)batch*net->outputs*sizeof(float));
+        }
+        double ms = (what_time_is_it_now() - start)*1000/(i ? i : 1);
+        if(r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+static void int8_calibrate(char *cfg, char *weights, char *dir, char *ranges)
+{
+    network *net = load_inference_network(cfg, weights);
+    char **paths;
+    int n;
+    float *X = int8_load_images(net, dir, &paths, &n);
+    calibrate_int8_network(net, X, n);
+    save_int8_ranges(net, ranges);
+
+    int i;
+    printf("calibrated on %d images\n", n);
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(l.type == CONVOLUTIONAL) printf("%3d conv %4d input range [%g, %g]\n", i, l.n, l.int8_min, l.int8_max);
+    }
+    free(X);
+    free_ptrs((void **)paths, n);
+    free_network(net);
+}
+
+static void int8_report(char *cfg, char *weights, char *ranges, char *dir, char *names, int batch)
+{
+    network *net = load_inference_network(cfg, weights);
+    char **files;
+    int n, i, j;
+    float *X = int8_load_images(net, dir, &files, &n);
+    int outputs = net->outputs;
+    float *fp32 = calloc((size_t)n*outputs, sizeof(float));
+    float *int8 = calloc((size_t)n*outputs, sizeof(float));
+    /* the layers are allocated for the batch of the cfg */
+    if(batch > net->batch) batch = net->batch;
+    if(batch > n) batch = n;
+
+    double fp32_single = int8_predict(net, X, n, 1, fp32);
+    double fp32_batch = int8_predict(net, X, n, batch, 0);
+    load_int8_ranges(net, ranges);
+    quantize_int8_network(net);
+    double int8_single = int8_predict(net, X, n, 1, int8);
+    double int8_batch = int8_predict(net, X, n, batch, 0);
+
+    char **labels = names ? get_labels(names) : 0;
+    int classes = labels ? outputs : 0;
+    int agree = 0, fp32_correct = 0, int8_correct = 0, labeled = 0;
+    float max_error = 0;
+    double sum_error = 0;
+    for(i = 0; i < n; ++i){
+        float *a = fp32 + (size_t)i*outputs;
+        float *b = int8 + (size_t)i*outputs;
+        int top_a = max_index(a, outputs);
+        int top_b = max_index(b, outputs);
+        agree += top_a == top_b;
+        for(j = 0; j < outputs; ++j){
+            float e = fabsf(a[j] - b[j]);
+            if(e > max_error) max_error = e;
+            sum_error += e;
+        }
+        int truth = -1;
+        for(j = 0; j < classes; ++j){
+            if(strstr(files[i], labels[j])) truth = j;
+        }
+        if(truth < 0) continue;
+        ++labeled;
+        fp32_correct += top_a == truth;
+        int8_correct += top_b == truth;
+    }
+
+    printf("%d images, int8 kernel %s\n", n, int8_kernel_name());
+    printf("top-1 agreement      %.2f%% (%d/%d)\n", 100.*agree/n, agree, n);
+    printf("max |prob error|     %g\n", max_error);
+    printf("mean |prob error|    %g\n", sum_error/((double)n*outputs));
+    if(labeled){
+        printf("fp32 accuracy        %.2f%% (%d labeled)\n", 100.*fp32_correct/labeled, labeled);
+        printf("int8 accuracy        %.2f%%\n", 100.*int8_correct/labeled);
+    }
+    printf("%-20s %10s %10s\n", "ms per patch", "fp32", "int8");
+    printf("%-20s %10.4f %10.4f\n", "batch 1", fp32_single, int8_single);
+    printf("batch %-14d %10.4f %10.4f\n", batch, fp32_batch, int8_batch);
+
+    free(fp32);
+    free(int8);
+    free(X);
+    free_ptrs((void **)files, n);
+    free_network(net);
+}
+
+void run_int8(int argc, char **argv)
+{
+    if(argc < 7){
+        fprintf(stderr, "usage: %s %s calibrate [cfg] [weights] [image dir] [ranges]\n", argv[0], argv[1]);
+        fprintf(stderr, "       %s %s report [cfg] [weights] [ranges] [image dir] [-names names.list] [-batch 16]\n", argv[0], argv[1]);
+        return;
+    }
+    gpu_index = -1;
+    char *names = find_char_arg(argc, argv, "-names", 0);
+    int batch = find_int_arg(argc, argv, "-batch", 16);
+    if(0 == strcmp(argv[2], "calibrate")) int8_calibrate(argv[3], argv[4], argv[5], argv[6]);
+    else if(0 == strcmp(argv[2], "report")) int8_report(argv[3], argv[4], argv[5], argv[6], names, batch);
+    else fprintf(stderr, "Not an option: %s\n", argv[2]);
+}
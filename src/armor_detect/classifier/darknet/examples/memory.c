@@ -0,0 +1,76 @@
+#include "darknet.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Memory a network holds once loaded.
+ *
+ *   memory [cfg] [weights] [-iters 100]
+ *
+ * loads the network for training and for inference and reports the heap each
+ * keeps, measured by the allocator, and the ms per forward pass. Inference
+ * drops the training buffers and shares the layer outputs. A context shares
+ * the inference network's weights and holds only its own activations.
+ */
+
+static size_t memory_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 m = mallinfo2();
+#else
+    struct mallinfo m = mallinfo();
+#endif
+    return (size_t)m.uordblks + (size_t)m.hblkhd;
+}
+
+static double memory_forward(network *net, int iters)
+{
+    float *X = calloc(net->inputs*net->batch, sizeof(float));
+    int i;
+    for(i = 0; i < net->inputs*net->batch; ++i) X[i] = rand_uniform(0, 1);
+    network_predict(net, X);
+    double start = what_time_is_it_now();
+    for(i = 0; i < iters; ++i) network_predict(net, X);
+    double ms = (what_time_is_it_now() - start)*1000/iters;
+    free(X);
+    return ms;
+}
+
+void run_memory(int argc, char **argv)
+{
+    if(argc < 3){
+        fprintf(stderr, "usage: %s %s [cfg] [weights] [-iters 100]\n", argv[0], argv[1]);
+        return;
+    }
+    gpu_index = -1;
+    int iters = find_int_arg(argc, argv, "-iters", 100);
+    char *cfg = argv[2];
+    char *weights = (argc > 3 && argv[3][0] != '-') ? argv[3] : 0;
+
+    size_t base = memory_in_use();
+    network *net = load_network(cfg, weights, 0);
+    size_t train = memory_in_use() - base;
+    double train_ms = memory_forward(net, iters);
+    free_network(net);
+
+    base = memory_in_use();
+    net = load_inference_network(cfg, weights);
+    size_t inference = memory_in_use() - base;
+    double inference_ms = memory_forward(net, iters);
+    int batch = net->batch;
+
+    base = memory_in_use();
+    network *ctx = make_network_context(net, 0);
+    size_t context = memory_in_use() - base;
+    double context_ms = memory_forward(ctx, iters);
+    free_network(ctx);
+    free_network(net);
+
+    printf("batch %d\n", batch);
+    printf("%-12s %12s %12s\n", "", "KB", "ms");
+    printf("%-12s %12.1f %12.4f\n", "training", train/1024., train_ms);
+    printf("%-12s %12.1f %12.4f\n", "inference", inference/1024., inference_ms);
+    printf("%-12s %12.1f %12.4f\n", "context", context/1024., context_ms);
+}
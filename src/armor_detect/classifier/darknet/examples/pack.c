@@ -0,0 +1,142 @@
+#include "darknet.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Packed networks for fast startup.
+ *
+ *   pack convert [cfg] [weights] [output]
+ *       loads the network for inference and writes the cfg, the folded
+ *       weights and the packed GEMM panels into one file the classifier maps.
+ *   pack bench [cfg] [weights] [packed] [-rounds 5]
+ *       times load plus first prediction for both formats, cold with the files
+ *       dropped from the page cache first and warm straight after.
+ *
+ * Both check that every layer of the mapped network gives the same output as
+ * the network loaded from cfg and weights, convert removes a packed file that
+ * does not.
+ */
+
+/*
+ * runs both networks layer by layer on random inputs, feeding each layer of
+ * the mapped network the reference input so a mismatch names its layer,
+ * returns whether all outputs match
+ */
+static int pack_verify(char *cfg, char *weights, char *packed)
+{
+    network *ref = load_inference_network(cfg, weights);
+    network *map = load_packed_network(packed);
+    set_batch_network(ref, 1);
+    set_batch_network(map, 1);
+    if(ref->n != map->n || ref->inputs != map->inputs) error("Packed network does not match the cfg");
+    float *X = calloc(ref->inputs, sizeof(float));
+    srand(2222222);
+    int match = 1;
+    int t, i, j;
+    for(t = 0; t < 4 && match; ++t){
+        for(j = 0; j < ref->inputs; ++j) X[j] = rand_uniform(0, 1);
+        network a = *ref;
+        network b = *map;
+        a.input = X;
+        for(i = 0; i < a.n && match; ++i){
+            layer la = a.layers[i];
+            layer lb = b.layers[i];
+            if(la.outputs != lb.outputs) error("Packed network does not match the cfg");
+            a.index = b.index = i;
+            b.input = a.input;
+            la.forward(la, a);
+            lb.forward(lb, b);
+            for(j = 0; j < la.outputs && match; ++j){
+                float e = fabsf(lb.output[j] - la.output[j])/(fabsf(la.output[j]) + 1);
+                if(!(e <= 1e-4f)){
+                    fprintf(stderr, "Layer %d output %d: %g from %s, %g from %s\n", i, j, la.output[j], weights, lb.output[j], packed);
+                    match = 0;
+                }
+            }
+            a.input = la.output;
+        }
+    }
+    free(X);
+    free_network(ref);
+    free_network(map);
+    return match;
+}
+
+/* drops the file from the page cache, the next read comes from disk */
+static void pack_evict(char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/* ms to load and run the first prediction, the mapped weights are only read then */
+static double pack_start(char *cfg, char *weights, char *packed, int cold)
+{
+    if(cold){
+        if(cfg) pack_evict(cfg);
+        if(weights) pack_evict(weights);
+        if(packed) pack_evict(packed);
+    }
+    double start = what_time_is_it_now();
+    network *net = packed ? load_packed_network(packed) : load_inference_network(cfg, weights);
+    float *X = calloc(net->inputs, sizeof(float));
+    set_batch_network(net, 1);
+    network_predict(net, X);
+    double ms = (what_time_is_it_now() - start)*1000;
+    free(X);
+    free_network(net);
+    return ms;
+}
+
+static void pack_bench(char *cfg, char *weights, char *packed, int rounds)
+{
+    double best[4] = {0};
+    int r, i;
+    for(r = 0; r < rounds; ++r){
+        double t[4];
+        t[0] = pack_start(cfg, weights, 0, 1);
+        t[1] = pack_start(cfg, weights, 0, 0);
+        t[2] = pack_start(0, 0, packed, 1);
+        t[3] = pack_start(0, 0, packed, 0);
+        for(i = 0; i < 4; ++i){
+            if(r == 0 || t[i] < best[i]) best[i] = t[i];
+        }
+    }
+    printf("%-20s %10s %10s\n", "ms to first output", "cold", "warm");
+    printf("%-20s %10.3f %10.3f\n", "cfg + weights", best[0], best[1]);
+    printf("%-20s %10.3f %10.3f\n", "packed", best[2], best[3]);
+}
+
+void run_pack(int argc, char **argv)
+{
+    if(argc < 6){
+        fprintf(stderr, "usage: %s %s convert [cfg] [weights] [output]\n", argv[0], argv[1]);
+        fprintf(stderr, "       %s %s bench [cfg] [weights] [packed] [-rounds 5]\n", argv[0], argv[1]);
+        return;
+    }
+    gpu_index = -1;
+    int rounds = find_int_arg(argc, argv, "-rounds", 5);
+    if(0 == strcmp(argv[2], "convert")){
+        network *net = load_inference_network(argv[3], argv[4]);
+        save_packed_network(net, argv[3], argv[5]);
+        free_network(net);
+        if(!pack_verify(argv[3], argv[4], argv[5])){
+            unlink(argv[5]);
+            error("Packed network output differs, file removed");
+        }
+        fprintf(stderr, "Packed %s\n", argv[5]);
+    } else if(0 == strcmp(argv[2], "bench")){
+        if(!pack_verify(argv[3], argv[4], argv[5])) error("Packed network output differs");
+        pack_bench(argv[3], argv[4], argv[5], rounds);
+    } else {
+        fprintf(stderr, "Not an option: %s\n", argv[2]);
+    }
+}
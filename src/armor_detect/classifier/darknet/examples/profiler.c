@@ -0,0 +1,106 @@
+#include "darknet.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Per-layer profile of a classifier.
+ *
+ *   profile [cfg] [weights] [image dir] [-iters 1000] [-batch 1] [-warmup 20] [-ranges file]
+ *
+ * loads the network for inference the way Classifier does, mapping a packed
+ * file when given one and quantizing to INT8 with a ranges file, then runs
+ * iters predictions cycling through the patches of the directory and prints
+ * the time of each layer as percentiles, its share of the pass, and the FLOPs
+ * and bytes it moves per image with the rates they come to. Without a
+ * directory the input is random.
+ */
+
+static int profile_is_image(char *name)
+{
+    char *ext = strrchr(name, '.');
+    if(!ext) return 0;
+    return !strcmp(ext, ".jpg") || !strcmp(ext, ".png") || !strcmp(ext, ".bmp") || !strcmp(ext, ".jpeg");
+}
+
+/* in the BGR order Classifier::imgConvert feeds the network */
+static float *profile_load_images(network *net, char *dir, int *n)
+{
+    DIR *d = opendir(dir);
+    if(!d) error(dir);
+    struct dirent *entry;
+    float *X = 0;
+    int count = 0;
+    char path[4096];
+    while((entry = readdir(d))){
+        if(!profile_is_image(entry->d_name)) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        image im = load_image_color(path, net->w, net->h);
+        rgbgr_image(im);
+        X = realloc(X, (size_t)(count + 1)*net->inputs*sizeof(float));
+        memcpy(X + (size_t)count*net->inputs, im.data, net->inputs*sizeof(float));
+        free_image(im);
+        ++count;
+    }
+    closedir(d);
+    if(!count) error("No images found");
+    *n = count;
+    return X;
+}
+
+void run_profiler(int argc, char **argv)
+{
+    if(argc < 4){
+        fprintf(stderr, "usage: %s %s [cfg] [weights] [image dir] [-iters 1000] [-batch 1] [-warmup 20] [-ranges file]\n", argv[0], argv[1]);
+        return;
+    }
+    gpu_index = -1;
+    /* before the options are taken out of argv */
+    char *dir = (argc > 4 && argv[4][0] != '-') ? argv[4] : 0;
+    int iters = find_int_arg(argc, argv, "-iters", 1000);
+    int batch = find_int_arg(argc, argv, "-batch", 1);
+    int warmup = find_int_arg(argc, argv, "-warmup", 20);
+    char *ranges = find_char_arg(argc, argv, "-ranges", 0);
+    char *cfg = argv[2];
+    char *weights = argv[3];
+
+    network *net = is_packed_network(weights) ? load_packed_network(weights) : load_inference_network(cfg, weights);
+    if(ranges){
+        load_int8_ranges(net, ranges);
+        quantize_int8_network(net);
+    }
+    if(batch < 1) batch = 1;
+    if(batch > net->batch) batch = net->batch;
+    set_batch_network(net, batch);
+
+    int n = 0;
+    float *X = 0;
+    if(dir){
+        X = profile_load_images(net, dir, &n);
+    } else {
+        int i;
+        n = batch;
+        X = calloc((size_t)n*net->inputs, sizeof(float));
+        for(i = 0; i < n*net->inputs; ++i) X[i] = rand_uniform(0, 1);
+    }
+    /* patches are taken batch at a time, wrapping around the end of the directory */
+    float *input = calloc((size_t)batch*net->inputs, sizeof(float));
+    int next = 0;
+    int i, j;
+    for(i = 0; i < warmup + iters; ++i){
+        if(i == warmup) start_network_profile(net, iters);
+        for(j = 0; j < batch; ++j){
+            memcpy(input + (size_t)j*net->inputs, X + (size_t)next*net->inputs, net->inputs*sizeof(float));
+            next = (next + 1) % n;
+        }
+        network_predict(net, input);
+    }
+    printf("%s, %s, %d threads\n", weights, ranges ? "int8" : "fp32", thread_pool_threads());
+    print_network_profile(net, stdout);
+
+    free(input);
+    free(X);
+    free_network(net);
+}
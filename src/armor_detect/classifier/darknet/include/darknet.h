@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #ifdef GPU
@@ -94,6 +95,10 @@ typedef enum{
     SSE, MASKED, L1, SEG, SMOOTH,WGAN
 } COST_TYPE;
 
+typedef enum{
+    CONV_GEMM, CONV_DIRECT, CONV_WINOGRAD
+} CONV_ALGORITHM;
+
 typedef struct{
     int batch;
     float learning_rate;
@@ -109,6 +114,9 @@ typedef struct{
 struct network;
 typedef struct network network;
 
+struct network_profile;
+typedef struct network_profile network_profile;
+
 struct layer;
 typedef struct layer layer;
 
@@ -141,6 +149,7 @@ struct layer{
     int size;
     int side;
     int stride;
+    CONV_ALGORITHM conv_algorithm;
     int reverse;
     int flatten;
     int spatial;
@@ -237,6 +246,15 @@ struct layer{
 
     float * weights;
     float * weight_updates;
+    float * packed_weights;
+    float * algorithm_weights;
+    signed char * int8_weights;
+    float * int8_scales;
+    int * int8_offsets;
+    float int8_min;
+    float int8_max;
+    uint64_t * xnor_weights;
+    float * xnor_scales;
 
     float * delta;
     float * output;
@@ -422,6 +440,7 @@ struct layer{
 };
 
 void free_layer(layer);
+void free_layer_training(layer *l);
 
 typedef enum {
     CONSTANT, STEP, EXP, POLY, STEPS, SIG, RANDOM
@@ -482,6 +501,13 @@ typedef struct network{
     float *delta;
     float *workspace;
     int train;
+    int inference;
+    float **output_buffers;
+    int n_output_buffers;
+    void *mapping;
+    size_t mapping_size;
+    struct network *shared;
+    network_profile *profile;
     int index;
     float *cost;
     float clip;
@@ -585,6 +611,7 @@ typedef struct{
 
 
 network *load_network(char *cfg, char *weights, int clear);
+network *load_inference_network(char *cfg, char *weights);
 load_args get_base_args(network *net);
 
 void free_data(data d);
@@ -680,8 +707,12 @@ int option_find_int(list *l, char *key, int def);
 int option_find_int_quiet(list *l, char *key, int def);
 
 network *parse_network_cfg(char *filename);
+network *parse_inference_network_cfg(char *filename);
 void save_weights(network *net, char *filename);
 void load_weights(network *net, char *filename);
+int is_packed_network(char *filename);
+void save_packed_network(network *net, char *cfgfile, char *filename);
+network *load_packed_network(char *filename);
 void save_weights_upto(network *net, char *filename, int cutoff);
 void load_weights_upto(network *net, char *filename, int start, int cutoff);
 
@@ -690,6 +721,12 @@ void get_region_detections(layer l, int w, int h, int netw, int neth, float thre
 int get_yolo_detections(layer l, int w, int h, int netw, int neth, float thresh, int *map, int relative, detection *dets);
 void free_network(network *net);
 void set_batch_network(network *net, int b);
+void fold_batchnorm_network(network *net);
+void share_network_outputs(network *net);
+network *make_network_context(network *net, int batch);
+void pack_layer_weights(layer *l);
+void pack_network_weights(network *net);
+void unpack_network_weights(network *net);
 void set_temp_network(network *net, float t);
 image load_image(char *filename, int w, int h, int c);
 image load_image_color(char *filename, int w, int h);
@@ -799,6 +836,53 @@ size_t rand_size_t();
 float rand_normal();
 float rand_uniform(float min, float max);
 
+void gemm_cpu_naive(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda,
+        float *B, int ldb,
+        float BETA,
+        float *C, int ldc);
+void gemm_cpu_packed(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda, float *packed_a,
+        float *B, int ldb, float *packed_b,
+        float BETA,
+        float *C, int ldc);
+size_t gemm_packed_size_a(int M, int K);
+size_t gemm_packed_size_b(int K, int N);
+void gemm_pack_a(int TA, int M, int K, float *A, int lda, float *packed);
+void gemm_pack_b(int TB, int K, int N, float *B, int ldb, float *packed);
+int gemm_kernel_count();
+const char *gemm_kernel_name(int index);
+int gemm_kernel_supported(int index);
+int gemm_get_kernel();
+void gemm_set_kernel(int index);
+
+typedef void (*parallel_range)(void *args, int begin, int end);
+void thread_pool_init(int threads, int *cores, int ncores);
+void thread_pool_free();
+int thread_pool_threads();
+void parallel_for(int n, double work, parallel_range fn, void *args);
+
+void start_network_profile(network *net, int runs);
+void stop_network_profile(network *net);
+void reset_network_profile(network *net);
+void print_network_profile(network *net, FILE *fp);
+double layer_flops(layer l);
+double layer_bytes(layer l, int batch);
+
+CONV_ALGORITHM select_conv_algorithm(layer l);
+size_t conv_algorithm_workspace_size(layer l);
+
+void calibrate_int8_network(network *net, float *X, int n);
+void quantize_int8_network(network *net);
+void dequantize_int8_network(network *net);
+void save_int8_ranges(network *net, char *filename);
+void load_int8_ranges(network *net, char *filename);
+const char *int8_kernel_name();
+
+void binarize_xnor_network(network *net);
+void unbinarize_xnor_network(network *net);
+const char *xnor_kernel_name();
+
 #ifdef __cplusplus
 }
 #endif
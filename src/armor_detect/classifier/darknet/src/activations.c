@@ -98,11 +98,75 @@ float activate(float x, ACTIVATION a)
 }
 
 void activate_array(float *x, const int n, const ACTIVATION a)
+{
+    if(a == LINEAR) return;
+    bias_activate_array(x, n, 0, a);
+}
+
+static void bias_activate_scalar(float *x, const int n, const float bias, const ACTIVATION a)
 {
     int i;
-    for(i = 0; i < n; ++i){
-        x[i] = activate(x[i], a);
+    switch(a){
+        case LINEAR:
+            for(i = 0; i < n; ++i) x[i] += bias;
+            break;
+        case LEAKY:
+            for(i = 0; i < n; ++i) x[i] = leaky_activate(x[i] + bias);
+            break;
+        case RELU:
+            for(i = 0; i < n; ++i) x[i] = relu_activate(x[i] + bias);
+            break;
+        default:
+            for(i = 0; i < n; ++i) x[i] = activate(x[i] + bias, a);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* leaky_activate scales in double, so does this to give the same bits */
+__attribute__((target("avx2")))
+static inline __m256 leaky_avx2(__m256 v)
+{
+    __m256d k = _mm256_set1_pd(.1);
+    __m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(k, _mm256_cvtps_pd(_mm256_castps256_ps128(v))));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(k, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1))));
+    __m256 scaled = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    return _mm256_blendv_ps(scaled, v, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+__attribute__((target("avx2")))
+static void bias_activate_avx2(float *x, const int n, const float bias, const ACTIVATION a)
+{
+    __m256 b = _mm256_set1_ps(bias);
+    __m256 zero = _mm256_setzero_ps();
+    int i;
+    for(i = 0; i + 8 <= n; i += 8){
+        __m256 v = _mm256_add_ps(_mm256_loadu_ps(x + i), b);
+        if(a == LEAKY) v = leaky_avx2(v);
+        /* relu_activate as -Ofast compiles it, zero for negatives and NaN */
+        else if(a == RELU) v = _mm256_max_ps(v, zero);
+        _mm256_storeu_ps(x + i, v);
+    }
+    bias_activate_scalar(x + i, n - i, bias, a);
+}
+
+static int activations_avx2_supported(ACTIVATION a)
+{
+    return (a == LINEAR || a == LEAKY || a == RELU) && __builtin_cpu_supports("avx2");
+}
+#endif
+
+/* add_bias and activate_array for one output channel in a single pass, the common cases without the switch and 8 wide with AVX2 */
+void bias_activate_array(float *x, const int n, const float bias, const ACTIVATION a)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(activations_avx2_supported(a)){
+        bias_activate_avx2(x, n, bias, a);
+        return;
     }
+#endif
+    bias_activate_scalar(x, n, bias, a);
 }
 
 float gradient(float x, ACTIVATION a)
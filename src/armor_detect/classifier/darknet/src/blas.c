@@ -190,6 +190,11 @@ void scal_cpu(int N, float ALPHA, float *X, int INCX)
 void fill_cpu(int N, float ALPHA, float *X, int INCX)
 {
     int i;
+    /* clearing an output before accumulating into it, the common case */
+    if(ALPHA == 0 && INCX == 1){
+        memset(X, 0, N*sizeof(float));
+        return;
+    }
     for(i = 0; i < N; ++i) X[i*INCX] = ALPHA;
 }
 
@@ -302,11 +307,55 @@ float dot_cpu(int N, float *X, int INCX, float *Y, int INCY)
     return dot;
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/*
+ * Contiguous softmax with the max and the normalization 8 wide. exp stays the
+ * libm call of the loop below so the probabilities come out the same.
+ */
+__attribute__((target("avx2")))
+static void softmax_avx2(float *input, int n, float temp, float *output)
+{
+    int i;
+    float sum = 0;
+    float largest = -FLT_MAX;
+    __m256 max = _mm256_set1_ps(-FLT_MAX);
+    for(i = 0; i + 8 <= n; i += 8) max = _mm256_max_ps(_mm256_loadu_ps(input + i), max);
+    float lanes[8];
+    _mm256_storeu_ps(lanes, max);
+    for(; i < n; ++i) if(input[i] > largest) largest = input[i];
+    for(i = 0; i < 8; ++i) if(lanes[i] > largest) largest = lanes[i];
+    if(temp == 1){
+        for(i = 0; i < n; ++i){
+            float e = exp(input[i] - largest);
+            sum += e;
+            output[i] = e;
+        }
+    } else {
+        for(i = 0; i < n; ++i){
+            float e = exp(input[i]/temp - largest/temp);
+            sum += e;
+            output[i] = e;
+        }
+    }
+    __m256 s = _mm256_set1_ps(sum);
+    for(i = 0; i + 8 <= n; i += 8) _mm256_storeu_ps(output + i, _mm256_div_ps(_mm256_loadu_ps(output + i), s));
+    for(; i < n; ++i) output[i] /= sum;
+}
+#endif
+
 void softmax(float *input, int n, float temp, int stride, float *output)
 {
     int i;
     float sum = 0;
     float largest = -FLT_MAX;
+#if defined(__x86_64__) || defined(__i386__)
+    if(stride == 1 && __builtin_cpu_supports("avx2")){
+        softmax_avx2(input, n, temp, output);
+        return;
+    }
+#endif
     for(i = 0; i < n; ++i){
         if(input[i*stride] > largest) largest = input[i*stride];
     }
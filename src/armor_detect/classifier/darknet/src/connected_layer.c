@@ -11,7 +11,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-layer make_connected_layer(int batch, int inputs, int outputs, ACTIVATION activation, int batch_normalize, int adam)
+layer make_connected_layer(int batch, int inputs, int outputs, ACTIVATION activation, int batch_normalize, int adam, int train)
 {
     int i;
     layer l = {0};
@@ -30,7 +30,8 @@ layer make_connected_layer(int batch, int inputs, int outputs, ACTIVATION activa
     l.out_c = outputs;
 
     l.output = calloc(batch*outputs, sizeof(float));
-    l.delta = calloc(batch*outputs, sizeof(float));
+    /* the per-image buffers only backward reads are left out for inference */
+    if(train) l.delta = calloc(batch*outputs, sizeof(float));
 
     l.weight_updates = calloc(inputs*outputs, sizeof(float));
     l.bias_updates = calloc(outputs, sizeof(float));
@@ -75,8 +76,10 @@ layer make_connected_layer(int batch, int inputs, int outputs, ACTIVATION activa
         l.rolling_mean = calloc(outputs, sizeof(float));
         l.rolling_variance = calloc(outputs, sizeof(float));
 
-        l.x = calloc(batch*outputs, sizeof(float));
-        l.x_norm = calloc(batch*outputs, sizeof(float));
+        if(train){
+            l.x = calloc(batch*outputs, sizeof(float));
+            l.x_norm = calloc(batch*outputs, sizeof(float));
+        }
     }
 
 #ifdef GPU
@@ -157,7 +160,11 @@ void forward_connected_layer(layer l, network net)
     float *a = net.input;
     float *b = l.weights;
     float *c = l.output;
-    gemm(0,1,m,n,k,1,a,k,b,k,1,c,n);
+    if(l.packed_weights){
+        gemm_cpu_packed(0,1,m,n,k,1,a,k,0,b,k,l.packed_weights,1,c,n);
+    } else {
+        gemm(0,1,m,n,k,1,a,k,b,k,1,c,n);
+    }
     if(l.batch_normalize){
         forward_batchnorm_layer(l, net);
     } else {
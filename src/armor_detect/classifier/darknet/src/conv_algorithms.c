@@ -0,0 +1,386 @@
+#include "conv_algorithms.h"
+#include "activations.h"
+#include "utils.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * CPU convolution algorithms other than im2col + GEMM.
+ *
+ * At the input sizes the armor classifier runs at, im2col expands every 3x3
+ * layer into a matrix nine times the size of its input before any arithmetic
+ * happens. Two alternatives avoid that:
+ *
+ * - direct: accumulates each filter tap straight from a zero-padded copy of
+ *   the input, six filters by sixteen columns at a time. Used when there are
+ *   so few input channels that the GEMM would have a tiny K.
+ * - Winograd F(2x2, 3x3): 3x3 stride-1 layers become 16 GEMMs over
+ *   transformed 4x4 input tiles, with 2.25x fewer multiplies and only a
+ *   16/4 = 4x expansion of the input instead of 9x.
+ *
+ * Both produce the raw convolution, or with activate set also add the bias
+ * and apply the activation to each output channel while it is in cache; batch
+ * norm stays in forward_convolutional_layer.
+ */
+
+/* up to this many input channels the direct loop beats both GEMM and Winograd */
+#define DIRECT_MAX_CHANNELS 64
+/* the direct loop computes DIRECT_FILTERS filters x DIRECT_BLOCK output columns at once */
+#define DIRECT_FILTERS 6
+#define DIRECT_BLOCK 16
+/* Winograd needs enough channels on both sides for the 16 GEMMs to pay off */
+#define WINOGRAD_MIN_CHANNELS 8
+
+static int direct_vectorized(int stride);
+
+CONV_ALGORITHM select_conv_algorithm(layer l)
+{
+    if(l.groups != 1 || l.binary || l.xnor) return CONV_GEMM;
+    if(l.size > 1 && l.c <= DIRECT_MAX_CHANNELS && direct_vectorized(l.stride)){
+        /* the last block of a row is computed in full, so narrow outputs waste most of it */
+        int blocks = (l.out_w + DIRECT_BLOCK - 1)/DIRECT_BLOCK;
+        if(4*l.out_w >= 3*blocks*DIRECT_BLOCK) return CONV_DIRECT;
+    }
+    if(l.size == 3 && l.stride == 1 && l.c >= WINOGRAD_MIN_CHANNELS && l.n >= WINOGRAD_MIN_CHANNELS) return CONV_WINOGRAD;
+    return CONV_GEMM;
+}
+
+static int winograd_tiles(layer l)
+{
+    return ((l.out_h + 1)/2)*((l.out_w + 1)/2);
+}
+
+static size_t direct_padded_size(layer l);
+
+size_t conv_algorithm_workspace_size(layer l)
+{
+    if(l.conv_algorithm == CONV_WINOGRAD){
+        return (size_t)16*winograd_tiles(l)*(l.c + l.n)*sizeof(float);
+    }
+    if(l.conv_algorithm == CONV_DIRECT){
+        return direct_padded_size(l)*sizeof(float);
+    }
+    return 0;
+}
+
+static float *pack_direct_weights(layer *l);
+
+/* U = G g G^T for every (filter, channel) pair, stored as 16 packed n x c matrices */
+static float *transform_winograd_weights(layer *l)
+{
+
+    int n = l->n;
+    int c = l->c;
+    float *u = calloc((size_t)16*n*c, sizeof(float));
+    int o, k, i, j;
+    for(o = 0; o < n; ++o){
+        for(k = 0; k < c; ++k){
+            float *g = l->weights + (o*c + k)*9;
+            float t[4][3];
+            for(j = 0; j < 3; ++j){
+                t[0][j] = g[j];
+                t[1][j] = .5f*(g[j] + g[3 + j] + g[6 + j]);
+                t[2][j] = .5f*(g[j] - g[3 + j] + g[6 + j]);
+                t[3][j] = g[6 + j];
+            }
+            for(i = 0; i < 4; ++i){
+                float r[4];
+                r[0] = t[i][0];
+                r[1] = .5f*(t[i][0] + t[i][1] + t[i][2]);
+                r[2] = .5f*(t[i][0] - t[i][1] + t[i][2]);
+                r[3] = t[i][2];
+                for(j = 0; j < 4; ++j){
+                    u[((size_t)(i*4 + j)*n + o)*c + k] = r[j];
+                }
+            }
+        }
+    }
+
+    size_t size = gemm_packed_size_a(n, c);
+    float *packed = calloc(16*size, sizeof(float));
+    for(i = 0; i < 16; ++i){
+        gemm_pack_a(0, n, c, u + (size_t)i*n*c, c, packed + i*size);
+    }
+    free(u);
+    return packed;
+}
+
+/* floats in algorithm_weights for the layer's algorithm */
+size_t conv_algorithm_weights_size(layer l)
+{
+    if(l.conv_algorithm == CONV_WINOGRAD) return (size_t)16*gemm_packed_size_a(l.n, l.c);
+    if(l.conv_algorithm == CONV_DIRECT) return (size_t)((l.n + DIRECT_FILTERS - 1)/DIRECT_FILTERS)*l.c*l.size*l.size*DIRECT_FILTERS;
+    return 0;
+}
+
+void pack_conv_algorithm_weights(layer *l)
+{
+    if(l->algorithm_weights) free(l->algorithm_weights);
+    l->algorithm_weights = 0;
+    if(l->conv_algorithm == CONV_WINOGRAD) l->algorithm_weights = transform_winograd_weights(l);
+    if(l->conv_algorithm == CONV_DIRECT) l->algorithm_weights = pack_direct_weights(l);
+}
+
+typedef struct{
+    layer l;
+    float *input;
+    float *output;
+    float *v;
+    float *m;
+    int tiles;
+    int tiles_w;
+    int activate;
+} winograd_args;
+
+/* V = B^T d B over 4x4 input tiles with a stride of 2, zero outside the image */
+static void winograd_input_channels(void *ptr, int begin, int end)
+{
+    winograd_args *a = ptr;
+    layer l = a->l;
+    int c = l.c;
+    int tiles = a->tiles;
+    int k, t, i, j;
+    for(k = begin; k < end; ++k){
+        float *channel = a->input + (size_t)k*l.h*l.w;
+        for(t = 0; t < tiles; ++t){
+            int y0 = (t/a->tiles_w)*2 - l.pad;
+            int x0 = (t%a->tiles_w)*2 - l.pad;
+            float d[4][4], s[4][4];
+            for(i = 0; i < 4; ++i){
+                int y = y0 + i;
+                for(j = 0; j < 4; ++j){
+                    int x = x0 + j;
+                    d[i][j] = (y >= 0 && y < l.h && x >= 0 && x < l.w) ? channel[y*l.w + x] : 0;
+                }
+            }
+            for(j = 0; j < 4; ++j){
+                s[0][j] = d[0][j] - d[2][j];
+                s[1][j] = d[1][j] + d[2][j];
+                s[2][j] = d[2][j] - d[1][j];
+                s[3][j] = d[1][j] - d[3][j];
+            }
+            for(i = 0; i < 4; ++i){
+                float *row = a->v + ((size_t)i*4*c + k)*tiles + t;
+                size_t stride = (size_t)c*tiles;
+                row[0*stride] = s[i][0] - s[i][2];
+                row[1*stride] = s[i][1] + s[i][2];
+                row[2*stride] = s[i][2] - s[i][1];
+                row[3*stride] = s[i][1] - s[i][3];
+            }
+        }
+    }
+}
+
+/* Y = A^T M A, keeping only the part of each 2x2 tile inside the output */
+static void winograd_output_channels(void *ptr, int begin, int end)
+{
+    winograd_args *w = ptr;
+    layer l = w->l;
+    int n = l.n;
+    int tiles = w->tiles;
+    int o, t, i;
+    for(o = begin; o < end; ++o){
+        float *out = w->output + (size_t)o*l.out_h*l.out_w;
+        for(t = 0; t < tiles; ++t){
+            float a[4][4], s[2][4];
+            for(i = 0; i < 16; ++i){
+                a[i/4][i%4] = w->m[((size_t)i*n + o)*tiles + t];
+            }
+            for(i = 0; i < 4; ++i){
+                s[0][i] = a[0][i] + a[1][i] + a[2][i];
+                s[1][i] = a[1][i] - a[2][i] - a[3][i];
+            }
+            int y = (t/w->tiles_w)*2;
+            int x = (t%w->tiles_w)*2;
+            for(i = 0; i < 2 && y + i < l.out_h; ++i){
+                out[(y + i)*l.out_w + x] = s[i][0] + s[i][1] + s[i][2];
+                if(x + 1 < l.out_w) out[(y + i)*l.out_w + x + 1] = s[i][1] - s[i][2] - s[i][3];
+            }
+        }
+        if(w->activate) bias_activate_array(out, l.out_h*l.out_w, l.biases[o], l.activation);
+    }
+}
+
+void forward_winograd_convolution(layer l, float *input, float *output, float *workspace, int activate)
+{
+    int c = l.c;
+    int n = l.n;
+    int tiles = winograd_tiles(l);
+    winograd_args args = {l, input, output, workspace, workspace + (size_t)16*c*tiles, tiles, (l.out_w + 1)/2, activate};
+    int i;
+
+    /* each tile costs about 32 adds per input channel and 24 per output channel */
+    parallel_for(c, 32.*c*tiles, winograd_input_channels, &args);
+
+    /* M_xi = U_xi V_xi for each of the 16 tile positions */
+    size_t packed_size = gemm_packed_size_a(n, c);
+    memset(args.m, 0, (size_t)16*n*tiles*sizeof(float));
+    for(i = 0; i < 16; ++i){
+        gemm_cpu_packed(0, 0, n, tiles, c, 1,
+                0, c, l.algorithm_weights + i*packed_size,
+                args.v + (size_t)i*c*tiles, tiles, 0,
+                1, args.m + (size_t)i*n*tiles, tiles);
+    }
+
+    parallel_for(n, 24.*n*tiles, winograd_output_channels, &args);
+}
+
+/* zero-padded copy of the input so the inner loops need no bounds checks; the
+ * slack at the end covers the last block of a row reading past the row end */
+static size_t direct_padded_size(layer l)
+{
+    return (size_t)l.c*(l.h + 2*l.pad)*(l.w + 2*l.pad) + DIRECT_BLOCK*l.stride + l.size;
+}
+
+/* filters interleaved in groups of DIRECT_FILTERS so every tap reads one contiguous run of weights */
+static float *pack_direct_weights(layer *l)
+{
+    int groups = (l->n + DIRECT_FILTERS - 1)/DIRECT_FILTERS;
+    int taps = l->c*l->size*l->size;
+    float *packed = calloc((size_t)groups*taps*DIRECT_FILTERS, sizeof(float));
+    int o, t;
+    for(o = 0; o < l->n; ++o){
+        for(t = 0; t < taps; ++t){
+            packed[((size_t)(o/DIRECT_FILTERS)*taps + t)*DIRECT_FILTERS + o%DIRECT_FILTERS] = l->weights[(size_t)o*taps + t];
+        }
+    }
+    return packed;
+}
+
+typedef void (*direct_kernel)(int c, int size, int stride, const float *weights, const float *rows, int pw, int plane, float *block);
+
+static void direct_kernel_scalar(int c, int size, int stride, const float *weights, const float *rows, int pw, int plane, float *block)
+{
+    int k, ky, kx, f, x;
+    memset(block, 0, DIRECT_FILTERS*DIRECT_BLOCK*sizeof(float));
+    for(k = 0; k < c; ++k){
+        for(ky = 0; ky < size; ++ky){
+            const float *row = rows + (size_t)k*plane + ky*pw;
+            for(kx = 0; kx < size; ++kx){
+                for(f = 0; f < DIRECT_FILTERS; ++f){
+                    float weight = weights[f];
+                    for(x = 0; x < DIRECT_BLOCK; ++x){
+                        block[f*DIRECT_BLOCK + x] += weight*row[kx + x*stride];
+                    }
+                }
+                weights += DIRECT_FILTERS;
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* stride 1 only: the 16 columns of a tap are two unaligned loads from the padded row */
+__attribute__((target("avx2,fma")))
+static void direct_kernel_avx2(int c, int size, int stride, const float *weights, const float *rows, int pw, int plane, float *block)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    int k, ky, kx;
+    for(k = 0; k < c; ++k){
+        for(ky = 0; ky < size; ++ky){
+            const float *row = rows + (size_t)k*plane + ky*pw;
+            for(kx = 0; kx < size; ++kx){
+                __m256 b0 = _mm256_loadu_ps(row + kx);
+                __m256 b1 = _mm256_loadu_ps(row + kx + 8);
+                __m256 av;
+                av = _mm256_broadcast_ss(weights + 0); c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+                av = _mm256_broadcast_ss(weights + 1); c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+                av = _mm256_broadcast_ss(weights + 2); c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+                av = _mm256_broadcast_ss(weights + 3); c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+                av = _mm256_broadcast_ss(weights + 4); c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+                av = _mm256_broadcast_ss(weights + 5); c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+                weights += DIRECT_FILTERS;
+            }
+        }
+    }
+    _mm256_storeu_ps(block + 0*DIRECT_BLOCK, c00); _mm256_storeu_ps(block + 0*DIRECT_BLOCK + 8, c01);
+    _mm256_storeu_ps(block + 1*DIRECT_BLOCK, c10); _mm256_storeu_ps(block + 1*DIRECT_BLOCK + 8, c11);
+    _mm256_storeu_ps(block + 2*DIRECT_BLOCK, c20); _mm256_storeu_ps(block + 2*DIRECT_BLOCK + 8, c21);
+    _mm256_storeu_ps(block + 3*DIRECT_BLOCK, c30); _mm256_storeu_ps(block + 3*DIRECT_BLOCK + 8, c31);
+    _mm256_storeu_ps(block + 4*DIRECT_BLOCK, c40); _mm256_storeu_ps(block + 4*DIRECT_BLOCK + 8, c41);
+    _mm256_storeu_ps(block + 5*DIRECT_BLOCK, c50); _mm256_storeu_ps(block + 5*DIRECT_BLOCK + 8, c51);
+}
+#endif
+
+/* the scalar fallback loses to the blocked GEMM, so direct is only selected when a SIMD kernel applies */
+static int direct_vectorized(int stride)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return stride == 1 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return 0;
+#endif
+}
+
+static direct_kernel get_direct_kernel(int stride)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(direct_vectorized(stride)) return direct_kernel_avx2;
+#endif
+    return direct_kernel_scalar;
+}
+
+typedef struct{
+    layer l;
+    direct_kernel kernel;
+    float *padded;
+    float *output;
+    int activate;
+} direct_args;
+
+static void direct_filter_groups(void *ptr, int begin, int end)
+{
+    direct_args *a = ptr;
+    layer l = a->l;
+    int pw = l.w + 2*l.pad;
+    int ph = l.h + 2*l.pad;
+    int taps = l.c*l.size*l.size;
+    int g, y;
+    for(g = begin; g < end; ++g){
+        float block[DIRECT_FILTERS*DIRECT_BLOCK];
+        float *weights = l.algorithm_weights + (size_t)g*taps*DIRECT_FILTERS;
+        int filters = l.n - g*DIRECT_FILTERS < DIRECT_FILTERS ? l.n - g*DIRECT_FILTERS : DIRECT_FILTERS;
+        int x0, f;
+        for(y = 0; y < l.out_h; ++y){
+            for(x0 = 0; x0 < l.out_w; x0 += DIRECT_BLOCK){
+                int width = l.out_w - x0 < DIRECT_BLOCK ? l.out_w - x0 : DIRECT_BLOCK;
+                a->kernel(l.c, l.size, l.stride, weights, a->padded + (size_t)y*l.stride*pw + x0*l.stride, pw, ph*pw, block);
+                for(f = 0; f < filters; ++f){
+                    memcpy(a->output + ((size_t)(g*DIRECT_FILTERS + f)*l.out_h + y)*l.out_w + x0, block + f*DIRECT_BLOCK, width*sizeof(float));
+                }
+            }
+        }
+        for(f = 0; a->activate && f < filters; ++f){
+            int o = g*DIRECT_FILTERS + f;
+            bias_activate_array(a->output + (size_t)o*l.out_h*l.out_w, l.out_h*l.out_w, l.biases[o], l.activation);
+        }
+    }
+}
+
+void forward_direct_convolution(layer l, float *input, float *output, float *workspace, int activate)
+{
+    int pw = l.w + 2*l.pad;
+    int ph = l.h + 2*l.pad;
+    int groups = (l.n + DIRECT_FILTERS - 1)/DIRECT_FILTERS;
+    float *padded = workspace;
+    direct_args args = {l, get_direct_kernel(l.stride), padded, output, activate};
+    int k, y;
+
+    memset(padded, 0, direct_padded_size(l)*sizeof(float));
+    for(k = 0; k < l.c; ++k){
+        for(y = 0; y < l.h; ++y){
+            memcpy(padded + ((size_t)k*ph + y + l.pad)*pw + l.pad, input + ((size_t)k*l.h + y)*l.w, l.w*sizeof(float));
+        }
+    }
+
+    parallel_for(groups, (double)l.n*l.out_h*l.out_w*l.c*l.size*l.size, direct_filter_groups, &args);
+}
@@ -0,0 +1,11 @@
+#ifndef CONV_ALGORITHMS_H
+#define CONV_ALGORITHMS_H
+
+#include "darknet.h"
+
+void pack_conv_algorithm_weights(layer *l);
+size_t conv_algorithm_weights_size(layer l);
+void forward_winograd_convolution(layer l, float *input, float *output, float *workspace, int activate);
+void forward_direct_convolution(layer l, float *input, float *output, float *workspace, int activate);
+
+#endif
@@ -5,6 +5,9 @@
 #include "col2im.h"
 #include "blas.h"
 #include "gemm.h"
+#include "conv_algorithms.h"
+#include "quantization.h"
+#include "xnor.h"
 #include <stdio.h>
 #include <time.h>
 
@@ -115,7 +118,10 @@ static size_t get_workspace_size(layer l){
         return most;
     }
 #endif
-    return (size_t)l.out_h*l.out_w*l.size*l.size*l.c/l.groups*sizeof(float);
+    size_t im2col_size = (size_t)l.out_h*l.out_w*l.size*l.size*l.c/l.groups*sizeof(float);
+    size_t algorithm_size = conv_algorithm_workspace_size(l);
+    if(l.xnor && xnor_workspace_size(l) > algorithm_size) algorithm_size = xnor_workspace_size(l);
+    return im2col_size > algorithm_size ? im2col_size : algorithm_size;
 }
 
 #ifdef GPU
@@ -173,7 +179,7 @@ void cudnn_convolutional_setup(layer *l)
 #endif
 #endif
 
-convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int n, int groups, int size, int stride, int padding, ACTIVATION activation, int batch_normalize, int binary, int xnor, int adam)
+convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int n, int groups, int size, int stride, int padding, ACTIVATION activation, int batch_normalize, int binary, int xnor, int adam, int train)
 {
     int i;
     convolutional_layer l = {0};
@@ -216,7 +222,8 @@ convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int
     l.inputs = l.w * l.h * l.c;
 
     l.output = calloc(l.batch*l.outputs, sizeof(float));
-    l.delta  = calloc(l.batch*l.outputs, sizeof(float));
+    /* the per-image buffers only backward reads are left out for inference */
+    if(train) l.delta  = calloc(l.batch*l.outputs, sizeof(float));
 
     l.forward = forward_convolutional_layer;
     l.backward = backward_convolutional_layer;
@@ -246,8 +253,10 @@ convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int
 
         l.rolling_mean = calloc(n, sizeof(float));
         l.rolling_variance = calloc(n, sizeof(float));
-        l.x = calloc(l.batch*l.outputs, sizeof(float));
-        l.x_norm = calloc(l.batch*l.outputs, sizeof(float));
+        if(train){
+            l.x = calloc(l.batch*l.outputs, sizeof(float));
+            l.x_norm = calloc(l.batch*l.outputs, sizeof(float));
+        }
     }
     if(adam){
         l.m = calloc(l.nweights, sizeof(float));
@@ -319,6 +328,7 @@ convolutional_layer make_convolutional_layer(int batch, int h, int w, int c, int
 #endif
     }
 #endif
+    l.conv_algorithm = select_conv_algorithm(l);
     l.workspace_size = get_workspace_size(l);
     l.activation = activation;
 
@@ -345,7 +355,7 @@ void denormalize_convolutional_layer(convolutional_layer l)
 /*
 void test_convolutional_layer()
 {
-    convolutional_layer l = make_convolutional_layer(1, 5, 5, 3, 2, 5, 2, 1, LEAKY, 1, 0, 0, 0);
+    convolutional_layer l = make_convolutional_layer(1, 5, 5, 3, 2, 5, 2, 1, LEAKY, 1, 0, 0, 0, 1);
     l.batch_normalize = 1;
     float data[] = {1,1,1,1,1,
         1,1,1,1,1,
@@ -410,12 +420,15 @@ void resize_convolutional_layer(convolutional_layer *l, int w, int h)
 
 void add_bias(float *output, float *biases, int batch, int n, int size)
 {
-    int i,j,b;
+    int i,b;
+    /* a bias per element, as connected layers have it */
+    if(size == 1){
+        for(b = 0; b < batch; ++b) axpy_cpu(n, 1, biases, 1, output + b*n, 1);
+        return;
+    }
     for(b = 0; b < batch; ++b){
         for(i = 0; i < n; ++i){
-            for(j = 0; j < size; ++j){
-                output[(b*n + i)*size + j] += biases[i];
-            }
+            bias_activate_array(output + (b*n + i)*size, size, biases[i], LINEAR);
         }
     }
 }
@@ -448,7 +461,9 @@ void forward_convolutional_layer(convolutional_layer l, network net)
 
     fill_cpu(l.outputs*l.batch, 0, l.output, 1);
 
-    if(l.xnor){
+    /* bit-packed xnor layers skip the float emulation outside of training */
+    int bits = l.xnor_weights && !net.train;
+    if(l.xnor && !bits){
         binarize_weights(l.weights, l.n, l.c/l.groups*l.size*l.size, l.binary_weights);
         swap_binary(&l);
         binarize_cpu(net.input, l.c*l.h*l.w*l.batch, l.binary_input);
@@ -458,7 +473,25 @@ void forward_convolutional_layer(convolutional_layer l, network net)
     int m = l.n/l.groups;
     int k = l.size*l.size*l.c/l.groups;
     int n = l.out_w*l.out_h;
+    /* without batch norm the packed paths add the bias and activate as each output is produced */
+    int fused = !l.batch_normalize && (l.packed_weights || l.int8_weights || bits);
     for(i = 0; i < l.batch; ++i){
+        if(bits){
+            forward_xnor_convolution(l, net.input + i*l.inputs, l.output + i*l.outputs, net.workspace, fused);
+            continue;
+        }
+        if(l.int8_weights){
+            forward_int8_convolution(l, net.input + i*l.inputs, l.output + i*l.outputs, net.workspace, fused);
+            continue;
+        }
+        if(l.conv_algorithm == CONV_WINOGRAD && l.algorithm_weights){
+            forward_winograd_convolution(l, net.input + i*l.inputs, l.output + i*l.outputs, net.workspace, fused);
+            continue;
+        }
+        if(l.conv_algorithm == CONV_DIRECT && l.algorithm_weights){
+            forward_direct_convolution(l, net.input + i*l.inputs, l.output + i*l.outputs, net.workspace, fused);
+            continue;
+        }
         for(j = 0; j < l.groups; ++j){
             float *a = l.weights + j*l.nweights/l.groups;
             float *b = net.workspace;
@@ -470,18 +503,28 @@ void forward_convolutional_layer(convolutional_layer l, network net)
             } else {
                 im2col_cpu(im, l.c/l.groups, l.h, l.w, l.size, l.stride, l.pad, b);
             }
-            gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            if (l.packed_weights) {
+                float *packed = l.packed_weights + j*gemm_packed_size_a(m, k);
+                gemm_cpu_packed_activate(0,0,m,n,k,1,a,k,packed,b,n,0,1,c,n,
+                        fused ? l.biases + j*m : 0, fused ? l.activation : LINEAR);
+            } else {
+                gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            }
         }
     }
 
-    if(l.batch_normalize){
-        forward_batchnorm_layer(l, net);
-    } else {
-        add_bias(l.output, l.biases, l.batch, l.n, l.out_h*l.out_w);
+    if(!fused){
+        if(l.batch_normalize){
+            forward_batchnorm_layer(l, net);
+            activate_array(l.output, l.outputs*l.batch, l.activation);
+        } else {
+            /* one pass per output channel instead of add_bias then activate_array */
+            for(i = 0; i < l.batch*l.n; ++i){
+                bias_activate_array(l.output + i*n, n, l.biases[i%l.n], l.activation);
+            }
+        }
     }
-
-    activate_array(l.output, l.outputs*l.batch, l.activation);
-    if(l.binary || l.xnor) swap_binary(&l);
+    if(l.binary || (l.xnor && !bits)) swap_binary(&l);
 }
 
 void backward_convolutional_layer(convolutional_layer l, network net)
@@ -2,6 +2,7 @@
 #include "utils.h"
 #include "image.h"
 #include "cuda.h"
+#include "thread_pool.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -1290,50 +1291,75 @@ data select_data(data *orig, int *inds)
     return d;
 }
 
-data *tile_data(data orig, int divs, int size)
+typedef struct{
+    data orig;
+    data *ds;
+    int divs;
+    int size;
+} tile_args;
+
+static void tile_data_range(void *ptr, int begin, int end)
 {
-    data *ds = calloc(divs*divs, sizeof(data));
+    tile_args *a = ptr;
+    data orig = a->orig;
+    int divs = a->divs;
     int i, j;
-#pragma omp parallel for
-    for(i = 0; i < divs*divs; ++i){
+    for(i = begin; i < end; ++i){
         data d;
         d.shallow = 0;
-        d.w = orig.w/divs * size;
-        d.h = orig.h/divs * size;
+        d.w = orig.w/divs * a->size;
+        d.h = orig.h/divs * a->size;
         d.X.rows = orig.X.rows;
         d.X.cols = d.w*d.h*3;
         d.X.vals = calloc(d.X.rows, sizeof(float*));
 
         d.y = copy_matrix(orig.y);
-#pragma omp parallel for
         for(j = 0; j < orig.X.rows; ++j){
             int x = (i%divs) * orig.w / divs - (d.w - orig.w/divs)/2;
             int y = (i/divs) * orig.h / divs - (d.h - orig.h/divs)/2;
             image im = float_to_image(orig.w, orig.h, 3, orig.X.vals[j]);
             d.X.vals[j] = crop_image(im, x, y, d.w, d.h).data;
         }
-        ds[i] = d;
+        a->ds[i] = d;
     }
+}
+
+data *tile_data(data orig, int divs, int size)
+{
+    data *ds = calloc(divs*divs, sizeof(data));
+    tile_args args = {orig, ds, divs, size};
+    parallel_for(divs*divs, (double)orig.X.rows*orig.X.cols*size*size, tile_data_range, &args);
     return ds;
 }
 
+typedef struct{
+    data orig;
+    data d;
+} resize_args;
+
+static void resize_data_range(void *ptr, int begin, int end)
+{
+    resize_args *a = ptr;
+    int i;
+    for(i = begin; i < end; ++i){
+        image im = float_to_image(a->orig.w, a->orig.h, 3, a->orig.X.vals[i]);
+        a->d.X.vals[i] = resize_image(im, a->d.w, a->d.h).data;
+    }
+}
+
 data resize_data(data orig, int w, int h)
 {
     data d = {0};
     d.shallow = 0;
     d.w = w;
     d.h = h;
-    int i;
     d.X.rows = orig.X.rows;
     d.X.cols = w*h*3;
     d.X.vals = calloc(d.X.rows, sizeof(float*));
 
     d.y = copy_matrix(orig.y);
-#pragma omp parallel for
-    for(i = 0; i < orig.X.rows; ++i){
-        image im = float_to_image(orig.w, orig.h, 3, orig.X.vals[i]);
-        d.X.vals[i] = resize_image(im, w, h).data;
-    }
+    resize_args args = {orig, d};
+    parallel_for(orig.X.rows, (double)orig.X.rows*d.X.cols*8, resize_data_range, &args);
     return d;
 }
 
@@ -1,9 +1,12 @@
 #include "gemm.h"
 #include "utils.h"
+#include "activations.h"
 #include "cuda.h"
+#include "thread_pool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -71,78 +74,112 @@ void gemm(int TA, int TB, int M, int N, int K, float ALPHA,
     gemm_cpu( TA,  TB,  M, N, K, ALPHA,A,lda, B, ldb,BETA,C,ldc);
 }
 
-void gemm_nn(int M, int N, int K, float ALPHA, 
-        float *A, int lda, 
-        float *B, int ldb,
-        float *C, int ldc)
+typedef struct{
+    int M, N, K;
+    float ALPHA;
+    float *A;
+    int lda;
+    float *B;
+    int ldb;
+    float *C;
+    int ldc;
+} gemm_args;
+
+static void gemm_nn_rows(void *ptr, int begin, int end)
 {
+    gemm_args *g = ptr;
     int i,j,k;
-    #pragma omp parallel for
-    for(i = 0; i < M; ++i){
-        for(k = 0; k < K; ++k){
-            register float A_PART = ALPHA*A[i*lda+k];
-            for(j = 0; j < N; ++j){
-                C[i*ldc+j] += A_PART*B[k*ldb+j];
+    for(i = begin; i < end; ++i){
+        for(k = 0; k < g->K; ++k){
+            register float A_PART = g->ALPHA*g->A[i*g->lda+k];
+            for(j = 0; j < g->N; ++j){
+                g->C[i*g->ldc+j] += A_PART*g->B[k*g->ldb+j];
             }
         }
     }
 }
 
-void gemm_nt(int M, int N, int K, float ALPHA, 
+void gemm_nn(int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
         float *C, int ldc)
 {
+    gemm_args g = {M, N, K, ALPHA, A, lda, B, ldb, C, ldc};
+    parallel_for(M, (double)M*N*K, gemm_nn_rows, &g);
+}
+
+static void gemm_nt_rows(void *ptr, int begin, int end)
+{
+    gemm_args *g = ptr;
     int i,j,k;
-    #pragma omp parallel for
-    for(i = 0; i < M; ++i){
-        for(j = 0; j < N; ++j){
+    for(i = begin; i < end; ++i){
+        for(j = 0; j < g->N; ++j){
             register float sum = 0;
-            for(k = 0; k < K; ++k){
-                sum += ALPHA*A[i*lda+k]*B[j*ldb + k];
+            for(k = 0; k < g->K; ++k){
+                sum += g->ALPHA*g->A[i*g->lda+k]*g->B[j*g->ldb + k];
             }
-            C[i*ldc+j] += sum;
+            g->C[i*g->ldc+j] += sum;
         }
     }
 }
 
-void gemm_tn(int M, int N, int K, float ALPHA, 
+void gemm_nt(int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
         float *C, int ldc)
 {
+    gemm_args g = {M, N, K, ALPHA, A, lda, B, ldb, C, ldc};
+    parallel_for(M, (double)M*N*K, gemm_nt_rows, &g);
+}
+
+static void gemm_tn_rows(void *ptr, int begin, int end)
+{
+    gemm_args *g = ptr;
     int i,j,k;
-    #pragma omp parallel for
-    for(i = 0; i < M; ++i){
-        for(k = 0; k < K; ++k){
-            register float A_PART = ALPHA*A[k*lda+i];
-            for(j = 0; j < N; ++j){
-                C[i*ldc+j] += A_PART*B[k*ldb+j];
+    for(i = begin; i < end; ++i){
+        for(k = 0; k < g->K; ++k){
+            register float A_PART = g->ALPHA*g->A[k*g->lda+i];
+            for(j = 0; j < g->N; ++j){
+                g->C[i*g->ldc+j] += A_PART*g->B[k*g->ldb+j];
             }
         }
     }
 }
 
-void gemm_tt(int M, int N, int K, float ALPHA, 
+void gemm_tn(int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
         float *C, int ldc)
 {
+    gemm_args g = {M, N, K, ALPHA, A, lda, B, ldb, C, ldc};
+    parallel_for(M, (double)M*N*K, gemm_tn_rows, &g);
+}
+
+static void gemm_tt_rows(void *ptr, int begin, int end)
+{
+    gemm_args *g = ptr;
     int i,j,k;
-    #pragma omp parallel for
-    for(i = 0; i < M; ++i){
-        for(j = 0; j < N; ++j){
+    for(i = begin; i < end; ++i){
+        for(j = 0; j < g->N; ++j){
             register float sum = 0;
-            for(k = 0; k < K; ++k){
-                sum += ALPHA*A[i+k*lda]*B[k+j*ldb];
+            for(k = 0; k < g->K; ++k){
+                sum += g->ALPHA*g->A[i+k*g->lda]*g->B[k+j*g->ldb];
             }
-            C[i*ldc+j] += sum;
+            g->C[i*g->ldc+j] += sum;
         }
     }
 }
 
+void gemm_tt(int M, int N, int K, float ALPHA, 
+        float *A, int lda, 
+        float *B, int ldb,
+        float *C, int ldc)
+{
+    gemm_args g = {M, N, K, ALPHA, A, lda, B, ldb, C, ldc};
+    parallel_for(M, (double)M*N*K, gemm_tt_rows, &g);
+}
 
-void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, 
+void gemm_cpu_naive(int TA, int TB, int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
         float BETA,
@@ -165,6 +202,421 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         gemm_tt(M, N, K, ALPHA,A,lda, B, ldb,C,ldc);
 }
 
+/*
+ * Cache-blocked GEMM.
+ *
+ * C (MxN) += ALPHA * op(A) (MxK) * op(B) (KxN) is split into NC-wide column
+ * blocks and KC-deep slices; each slice of B is packed into NR-wide panels,
+ * each MC-high block of A into MR-high panels, and an MRxNR register-tiled
+ * micro-kernel walks the panels. Weight matrices that do not change between
+ * calls can be packed once with gemm_pack_a / gemm_pack_b and handed to
+ * gemm_cpu_packed, which then only packs the other operand.
+ *
+ * The micro-kernel is picked at run time from the instruction sets the CPU
+ * supports. Packed layouts depend on the kernel's MR/NR, so pack after the
+ * kernel has been chosen and do not switch kernels while packed data is live.
+ */
+
+#define GEMM_KC 256
+/* multiple of every kernel's NR */
+#define GEMM_NC 4080
+#define GEMM_MAX_TILE (8*16)
+
+typedef void (*gemm_micro_kernel)(int kc, const float *a, const float *b, float *c, int ldc, float alpha);
+
+typedef struct{
+    const char *name;
+    int mr;
+    int nr;
+    int mc;
+    gemm_micro_kernel kernel;
+    int (*supported)();
+} gemm_kernel;
+
+static void gemm_kernel_scalar(int kc, const float *a, const float *b, float *c, int ldc, float alpha)
+{
+    float acc[4][4] = {{0}};
+    int p, i, j;
+    for(p = 0; p < kc; ++p){
+        for(i = 0; i < 4; ++i){
+            float a_part = a[p*4 + i];
+            for(j = 0; j < 4; ++j){
+                acc[i][j] += a_part*b[p*4 + j];
+            }
+        }
+    }
+    for(i = 0; i < 4; ++i){
+        for(j = 0; j < 4; ++j){
+            c[i*ldc + j] += alpha*acc[i][j];
+        }
+    }
+}
+
+static int gemm_scalar_supported()
+{
+    return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static void gemm_kernel_sse4(int kc, const float *a, const float *b, float *c, int ldc, float alpha)
+{
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    int p;
+    for(p = 0; p < kc; ++p){
+        __m128 b0 = _mm_loadu_ps(b + p*8);
+        __m128 b1 = _mm_loadu_ps(b + p*8 + 4);
+        __m128 a0 = _mm_set1_ps(a[p*4 + 0]);
+        __m128 a1 = _mm_set1_ps(a[p*4 + 1]);
+        __m128 a2 = _mm_set1_ps(a[p*4 + 2]);
+        __m128 a3 = _mm_set1_ps(a[p*4 + 3]);
+        c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+        c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+        c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+        c30 = _mm_add_ps(c30, _mm_mul_ps(a3, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(a3, b1));
+    }
+    __m128 va = _mm_set1_ps(alpha);
+#define GEMM_STORE_SSE(row, v0, v1) \
+    _mm_storeu_ps(c + row*ldc,     _mm_add_ps(_mm_loadu_ps(c + row*ldc),     _mm_mul_ps(va, v0))); \
+    _mm_storeu_ps(c + row*ldc + 4, _mm_add_ps(_mm_loadu_ps(c + row*ldc + 4), _mm_mul_ps(va, v1)));
+    GEMM_STORE_SSE(0, c00, c01)
+    GEMM_STORE_SSE(1, c10, c11)
+    GEMM_STORE_SSE(2, c20, c21)
+    GEMM_STORE_SSE(3, c30, c31)
+#undef GEMM_STORE_SSE
+}
+
+static int gemm_sse4_supported()
+{
+    return __builtin_cpu_supports("sse4.1");
+}
+
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(int kc, const float *a, const float *b, float *c, int ldc, float alpha)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    int p;
+    for(p = 0; p < kc; ++p){
+        __m256 b0 = _mm256_loadu_ps(b + p*16);
+        __m256 b1 = _mm256_loadu_ps(b + p*16 + 8);
+        const float *ap = a + p*6;
+        __m256 av;
+        av = _mm256_broadcast_ss(ap + 0); c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+        av = _mm256_broadcast_ss(ap + 1); c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+        av = _mm256_broadcast_ss(ap + 2); c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+        av = _mm256_broadcast_ss(ap + 3); c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+        av = _mm256_broadcast_ss(ap + 4); c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+        av = _mm256_broadcast_ss(ap + 5); c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+    }
+    __m256 va = _mm256_set1_ps(alpha);
+#define GEMM_STORE_AVX(row, v0, v1) \
+    _mm256_storeu_ps(c + row*ldc,     _mm256_fmadd_ps(va, v0, _mm256_loadu_ps(c + row*ldc))); \
+    _mm256_storeu_ps(c + row*ldc + 8, _mm256_fmadd_ps(va, v1, _mm256_loadu_ps(c + row*ldc + 8)));
+    GEMM_STORE_AVX(0, c00, c01)
+    GEMM_STORE_AVX(1, c10, c11)
+    GEMM_STORE_AVX(2, c20, c21)
+    GEMM_STORE_AVX(3, c30, c31)
+    GEMM_STORE_AVX(4, c40, c41)
+    GEMM_STORE_AVX(5, c50, c51)
+#undef GEMM_STORE_AVX
+}
+
+static int gemm_avx2_supported()
+{
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif
+
+/* ordered from slowest to fastest */
+static const gemm_kernel gemm_kernels[] = {
+    {"scalar", 4, 4, 64, gemm_kernel_scalar, gemm_scalar_supported},
+#if defined(__x86_64__) || defined(__i386__)
+    {"sse4", 4, 8, 64, gemm_kernel_sse4, gemm_sse4_supported},
+    {"avx2", 6, 16, 72, gemm_kernel_avx2, gemm_avx2_supported},
+#endif
+};
+
+static int gemm_kernel_index = -1;
+
+static const gemm_kernel *get_gemm_kernel()
+{
+    if(gemm_kernel_index < 0){
+        int i;
+        int best = 0;
+        for(i = 0; i < gemm_kernel_count(); ++i){
+            if(gemm_kernels[i].supported()) best = i;
+        }
+        gemm_kernel_index = best;
+    }
+    return gemm_kernels + gemm_kernel_index;
+}
+
+int gemm_kernel_count()
+{
+    return sizeof(gemm_kernels)/sizeof(gemm_kernels[0]);
+}
+
+const char *gemm_kernel_name(int index)
+{
+    return gemm_kernels[index].name;
+}
+
+int gemm_kernel_supported(int index)
+{
+    return index >= 0 && index < gemm_kernel_count() && gemm_kernels[index].supported();
+}
+
+int gemm_get_kernel()
+{
+    get_gemm_kernel();
+    return gemm_kernel_index;
+}
+
+void gemm_set_kernel(int index)
+{
+    if(!gemm_kernel_supported(index)) error("GEMM kernel not supported on this CPU");
+    gemm_kernel_index = index;
+}
+
+static int round_up(int x, int m)
+{
+    return (x + m - 1)/m*m;
+}
+
+/* rows [i0, i0+mc) and columns [p0, p0+kc) of op(A) into MR-high panels, zero padded */
+static void pack_a_block(const gemm_kernel *g, int TA, int M, float *A, int lda, int i0, int mc, int p0, int kc, float *packed)
+{
+    int mr = g->mr;
+    int i, p, r;
+    for(i = 0; i < mc; i += mr){
+        float *panel = packed + i*kc;
+        int rows = mc - i < mr ? mc - i : mr;
+        for(p = 0; p < kc; ++p){
+            for(r = 0; r < rows; ++r){
+                int row = i0 + i + r;
+                panel[p*mr + r] = TA ? A[(p0 + p)*lda + row] : A[row*lda + p0 + p];
+            }
+            for(; r < mr; ++r) panel[p*mr + r] = 0;
+        }
+    }
+}
+
+/* rows [p0, p0+kc) and columns [j0, j0+nc) of op(B) into NR-wide panels, zero padded */
+static void pack_b_block(const gemm_kernel *g, int TB, float *B, int ldb, int p0, int kc, int j0, int nc, float *packed)
+{
+    int nr = g->nr;
+    int j, p, c;
+    for(j = 0; j < nc; j += nr){
+        float *panel = packed + j*kc;
+        int cols = nc - j < nr ? nc - j : nr;
+        for(p = 0; p < kc; ++p){
+            if(TB){
+                for(c = 0; c < cols; ++c) panel[p*nr + c] = B[(j0 + j + c)*ldb + p0 + p];
+            } else {
+                memcpy(panel + p*nr, B + (p0 + p)*ldb + j0 + j, cols*sizeof(float));
+                c = cols;
+            }
+            for(; c < nr; ++c) panel[p*nr + c] = 0;
+        }
+    }
+}
+
+size_t gemm_packed_size_a(int M, int K)
+{
+    return (size_t)round_up(M, get_gemm_kernel()->mr)*K;
+}
+
+size_t gemm_packed_size_b(int K, int N)
+{
+    return (size_t)round_up(N, get_gemm_kernel()->nr)*K;
+}
+
+/*
+ * Whole-matrix layout: the KC-deep slices one after another, each holding
+ * every panel of that slice, so slice p0 starts at p0*round_up(M, MR).
+ */
+void gemm_pack_a(int TA, int M, int K, float *A, int lda, float *packed)
+{
+    const gemm_kernel *g = get_gemm_kernel();
+    int mpad = round_up(M, g->mr);
+    int p0;
+    for(p0 = 0; p0 < K; p0 += GEMM_KC){
+        int kc = K - p0 < GEMM_KC ? K - p0 : GEMM_KC;
+        pack_a_block(g, TA, M, A, lda, 0, M, p0, kc, packed + (size_t)p0*mpad);
+    }
+}
+
+void gemm_pack_b(int TB, int K, int N, float *B, int ldb, float *packed)
+{
+    const gemm_kernel *g = get_gemm_kernel();
+    int npad = round_up(N, g->nr);
+    int p0;
+    for(p0 = 0; p0 < K; p0 += GEMM_KC){
+        int kc = K - p0 < GEMM_KC ? K - p0 : GEMM_KC;
+        pack_b_block(g, TB, B, ldb, p0, kc, 0, N, packed + (size_t)p0*npad);
+    }
+}
+
+typedef struct{
+    const gemm_kernel *g;
+    int mc, nc, kc;
+    const float *pa;
+    const float *pb;
+    float ALPHA;
+    float *C;
+    int ldc;
+    int epilogue;
+    const float *bias;
+    ACTIVATION activation;
+} gemm_block;
+
+static void gemm_macro_panels(void *ptr, int begin, int end)
+{
+    gemm_block *k = ptr;
+    const gemm_kernel *g = k->g;
+    int mr = g->mr;
+    int nr = g->nr;
+    int mc = k->mc;
+    int kc = k->kc;
+    int ldc = k->ldc;
+    int jr;
+    for(jr = begin; jr < end; ++jr){
+        float tile[GEMM_MAX_TILE];
+        int n = k->nc - jr*nr < nr ? k->nc - jr*nr : nr;
+        const float *b = k->pb + jr*nr*kc;
+        int ir;
+        for(ir = 0; ir < mc; ir += mr){
+            int m = mc - ir < mr ? mc - ir : mr;
+            const float *a = k->pa + ir*kc;
+            float *c = k->C + ir*ldc + jr*nr;
+            if(m == mr && n == nr){
+                g->kernel(kc, a, b, c, ldc, k->ALPHA);
+            } else {
+                int i, j;
+                memset(tile, 0, mr*nr*sizeof(float));
+                g->kernel(kc, a, b, tile, nr, k->ALPHA);
+                for(i = 0; i < m; ++i){
+                    for(j = 0; j < n; ++j){
+                        c[i*ldc + j] += tile[i*nr + j];
+                    }
+                }
+            }
+            if(k->epilogue){
+                int i;
+                for(i = 0; i < m; ++i){
+                    bias_activate_array(c + i*ldc, n, k->bias ? k->bias[ir + i] : 0, k->activation);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * With epilogue set, this is the last KC slice: each tile gets its row's bias
+ * and the activation while it is still in cache.
+ */
+static void gemm_macro_kernel(const gemm_kernel *g, int mc, int nc, int kc, const float *pa, const float *pb, float ALPHA, float *C, int ldc,
+        int epilogue, const float *bias, ACTIVATION activation)
+{
+    gemm_block k = {g, mc, nc, kc, pa, pb, ALPHA, C, ldc, epilogue, bias, activation};
+    parallel_for((nc + g->nr - 1)/g->nr, (double)mc*nc*kc, gemm_macro_panels, &k);
+}
+
+/* per-thread packing buffers, grown on demand and kept for the next call */
+static __thread float *gemm_buffer_a = 0;
+static __thread size_t gemm_buffer_a_size = 0;
+static __thread float *gemm_buffer_b = 0;
+static __thread size_t gemm_buffer_b_size = 0;
+
+static float *gemm_buffer(float **buffer, size_t *size, size_t needed)
+{
+    if(*size < needed){
+        free(*buffer);
+        *buffer = calloc(needed, sizeof(float));
+        if(!*buffer) error("GEMM buffer allocation failed");
+        *size = needed;
+    }
+    return *buffer;
+}
+
+/* C = activation(ALPHA*op(A)*op(B) + BETA*C + bias), with bias indexed by row and optional */
+void gemm_cpu_packed_activate(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda, float *packed_a,
+        float *B, int ldb, float *packed_b,
+        float BETA,
+        float *C, int ldc,
+        float *bias, ACTIVATION activation)
+{
+    int i, j;
+    if(BETA != 1){
+        for(i = 0; i < M; ++i){
+            for(j = 0; j < N; ++j){
+                C[i*ldc + j] *= BETA;
+            }
+        }
+    }
+    if(M <= 0 || N <= 0 || K <= 0) return;
+
+    int epilogue = bias || activation != LINEAR;
+    const gemm_kernel *g = get_gemm_kernel();
+    int mpad = round_up(M, g->mr);
+    int npad = round_up(N, g->nr);
+    int jc, pc, ic;
+    for(jc = 0; jc < N; jc += GEMM_NC){
+        int nc = N - jc < GEMM_NC ? N - jc : GEMM_NC;
+        for(pc = 0; pc < K; pc += GEMM_KC){
+            int kc = K - pc < GEMM_KC ? K - pc : GEMM_KC;
+            float *pb;
+            if(packed_b){
+                pb = packed_b + (size_t)pc*npad + (size_t)jc*kc;
+            } else {
+                pb = gemm_buffer(&gemm_buffer_b, &gemm_buffer_b_size, (size_t)round_up(nc, g->nr)*kc);
+                pack_b_block(g, TB, B, ldb, pc, kc, jc, nc, pb);
+            }
+            for(ic = 0; ic < M; ic += g->mc){
+                int mc = M - ic < g->mc ? M - ic : g->mc;
+                float *pa;
+                if(packed_a){
+                    pa = packed_a + (size_t)pc*mpad + (size_t)ic*kc;
+                } else {
+                    pa = gemm_buffer(&gemm_buffer_a, &gemm_buffer_a_size, (size_t)round_up(mc, g->mr)*kc);
+                    pack_a_block(g, TA, M, A, lda, ic, mc, pc, kc, pa);
+                }
+                gemm_macro_kernel(g, mc, nc, kc, pa, pb, ALPHA, C + ic*ldc + jc, ldc,
+                        epilogue && pc + kc >= K, bias ? bias + ic : 0, activation);
+            }
+        }
+    }
+}
+
+void gemm_cpu_packed(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda, float *packed_a,
+        float *B, int ldb, float *packed_b,
+        float BETA,
+        float *C, int ldc)
+{
+    gemm_cpu_packed_activate(TA, TB, M, N, K, ALPHA, A, lda, packed_a, B, ldb, packed_b, BETA, C, ldc, 0, LINEAR);
+}
+
+void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, 
+        float *A, int lda, 
+        float *B, int ldb,
+        float BETA,
+        float *C, int ldc)
+{
+    gemm_cpu_packed(TA, TB, M, N, K, ALPHA, A, lda, 0, B, ldb, 0, BETA, C, ldc);
+}
+
 #ifdef GPU
 
 #include <math.h>
@@ -1,5 +1,6 @@
 #ifndef GEMM_H
 #define GEMM_H
+#include "darknet.h"
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -18,6 +19,13 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         float BETA,
         float *C, int ldc);
 
+void gemm_cpu_packed_activate(int TA, int TB, int M, int N, int K, float ALPHA,
+        float *A, int lda, float *packed_a,
+        float *B, int ldb, float *packed_b,
+        float BETA,
+        float *C, int ldc,
+        float *bias, ACTIVATION activation);
+
 #ifdef GPU
 void gemm_gpu(int TA, int TB, int M, int N, int K, float ALPHA, 
         float *A_gpu, int lda, 
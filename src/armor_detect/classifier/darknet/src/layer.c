@@ -3,6 +3,48 @@
 
 #include <stdlib.h>
 
+/*
+ * Releases what only backward and update touch, for a network that will only
+ * ever run forward with net.train == 0. Batch norm statistics and x stay while
+ * the layer still normalizes; after folding they go as well.
+ */
+void free_layer_training(layer *l)
+{
+    if(l->type == DROPOUT){
+        if(l->rand) free(l->rand);
+        l->rand = 0;
+        l->delta = 0;
+        return;
+    }
+    if(l->type != CONVOLUTIONAL && l->type != CONNECTED && l->type != MAXPOOL && l->type != AVGPOOL &&
+       l->type != SOFTMAX && l->type != COST && l->type != ROUTE && l->type != SHORTCUT) return;
+#define FREE_TRAINING(p) do{ if(l->p) free(l->p); l->p = 0; }while(0)
+    FREE_TRAINING(delta);
+    FREE_TRAINING(weight_updates);
+    FREE_TRAINING(bias_updates);
+    FREE_TRAINING(scale_updates);
+    FREE_TRAINING(m);
+    FREE_TRAINING(v);
+    FREE_TRAINING(bias_m);
+    FREE_TRAINING(bias_v);
+    FREE_TRAINING(scale_m);
+    FREE_TRAINING(scale_v);
+    FREE_TRAINING(mean_delta);
+    FREE_TRAINING(variance_delta);
+    FREE_TRAINING(loss);
+    if(l->type == MAXPOOL) FREE_TRAINING(indexes);
+    if(!l->batch_normalize){
+        FREE_TRAINING(mean);
+        FREE_TRAINING(variance);
+        FREE_TRAINING(rolling_mean);
+        FREE_TRAINING(rolling_variance);
+        FREE_TRAINING(x);
+        FREE_TRAINING(x_norm);
+        if(!l->binary) FREE_TRAINING(scales);
+    }
+#undef FREE_TRAINING
+}
+
 void free_layer(layer l)
 {
     if(l.type == DROPOUT){
@@ -33,6 +75,13 @@ void free_layer(layer l)
     if(l.scale_updates)      free(l.scale_updates);
     if(l.weights)            free(l.weights);
     if(l.weight_updates)     free(l.weight_updates);
+    if(l.packed_weights)     free(l.packed_weights);
+    if(l.algorithm_weights)  free(l.algorithm_weights);
+    if(l.int8_weights)       free(l.int8_weights);
+    if(l.int8_scales)        free(l.int8_scales);
+    if(l.int8_offsets)       free(l.int8_offsets);
+    if(l.xnor_weights)       free(l.xnor_weights);
+    if(l.xnor_scales)        free(l.xnor_scales);
     if(l.delta)              free(l.delta);
     if(l.output)             free(l.output);
     if(l.squared)            free(l.squared);
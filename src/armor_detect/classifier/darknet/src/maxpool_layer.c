@@ -18,7 +18,7 @@ image get_maxpool_delta(maxpool_layer l)
     return float_to_image(w,h,c,l.delta);
 }
 
-maxpool_layer make_maxpool_layer(int batch, int h, int w, int c, int size, int stride, int padding)
+maxpool_layer make_maxpool_layer(int batch, int h, int w, int c, int size, int stride, int padding, int train)
 {
     maxpool_layer l = {0};
     l.type = MAXPOOL;
@@ -35,9 +35,11 @@ maxpool_layer make_maxpool_layer(int batch, int h, int w, int c, int size, int s
     l.size = size;
     l.stride = stride;
     int output_size = l.out_h * l.out_w * l.out_c * batch;
-    l.indexes = calloc(output_size, sizeof(int));
     l.output =  calloc(output_size, sizeof(float));
-    l.delta =   calloc(output_size, sizeof(float));
+    if(train){
+        l.indexes = calloc(output_size, sizeof(int));
+        l.delta =   calloc(output_size, sizeof(float));
+    }
     l.forward = forward_maxpool_layer;
     l.backward = backward_maxpool_layer;
     #ifdef GPU
@@ -76,9 +78,117 @@ void resize_maxpool_layer(maxpool_layer *l, int w, int h)
     #endif
 }
 
+/* max of one window clipped to the input, what the training loop below gives without the per element bounds checks */
+static inline float maxpool_window(const maxpool_layer l, const float *in, int ys, int ye, int x)
+{
+    int xs = x < 0 ? 0 : x;
+    int xe = x + l.size < l.w ? x + l.size : l.w;
+    float max = -FLT_MAX;
+    int y;
+    for(y = ys; y < ye; ++y){
+        for(x = xs; x < xe; ++x){
+            float val = in[y*l.w + x];
+            max = (val > max) ? val : max;
+        }
+    }
+    return max;
+}
+
+static void maxpool_plane_scalar(const maxpool_layer l, const float *in, float *out)
+{
+    int offset = -l.pad/2;
+    int i, j;
+    for(i = 0; i < l.out_h; ++i){
+        int y = offset + i*l.stride;
+        int ys = y < 0 ? 0 : y;
+        int ye = y + l.size < l.h ? y + l.size : l.h;
+        for(j = 0; j < l.out_w; ++j){
+            out[i*l.out_w + j] = maxpool_window(l, in, ys, ye, offset + j*l.stride);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* max down the window's rows of the 8 columns starting at x */
+__attribute__((target("avx2")))
+static inline __m256 maxpool_rows_avx2(const float *in, int w, int ys, int ye, int x)
+{
+    __m256 max = _mm256_set1_ps(-FLT_MAX);
+    int y;
+    for(y = ys; y < ye; ++y) max = _mm256_max_ps(_mm256_loadu_ps(in + y*w + x), max);
+    return max;
+}
+
+/*
+ * 8 outputs at a time where their windows lie inside the input, the rest
+ * through maxpool_window. Stride 1 takes the max of size shifted loads, stride
+ * 2 splits pairs of loads into even and odd columns, which are windows at
+ * columns 2j and 2j+1; both cover the 2x2/s2 and 3x3 pools of our cfgs.
+ */
+__attribute__((target("avx2")))
+static void maxpool_plane_avx2(const maxpool_layer l, const float *in, float *out)
+{
+    int offset = -l.pad/2;
+    int pairs = (l.size + 1)/2;
+    /* columns the vector loads read past the first window's start */
+    int reach = l.stride == 1 ? l.size + 7 : 2*pairs + 14;
+    int i, j, m;
+    for(i = 0; i < l.out_h; ++i){
+        int y = offset + i*l.stride;
+        int ys = y < 0 ? 0 : y;
+        int ye = y + l.size < l.h ? y + l.size : l.h;
+        float *row = out + i*l.out_w;
+        for(j = 0; j < l.out_w;){
+            int x = offset + j*l.stride;
+            if(x < 0 || x + reach > l.w || j + 8 > l.out_w){
+                row[j++] = maxpool_window(l, in, ys, ye, x);
+                continue;
+            }
+            __m256 max = _mm256_set1_ps(-FLT_MAX);
+            if(l.stride == 1){
+                for(m = 0; m < l.size; ++m) max = _mm256_max_ps(maxpool_rows_avx2(in, l.w, ys, ye, x + m), max);
+            } else {
+                /* lanes stay in shuffle order until the end */
+                for(m = 0; m < pairs; ++m){
+                    __m256 a = maxpool_rows_avx2(in, l.w, ys, ye, x + 2*m);
+                    __m256 b = maxpool_rows_avx2(in, l.w, ys, ye, x + 2*m + 8);
+                    max = _mm256_max_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), max);
+                    if(2*m + 1 < l.size) max = _mm256_max_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), max);
+                }
+                max = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(max), _MM_SHUFFLE(3, 1, 2, 0)));
+            }
+            _mm256_storeu_ps(row + j, max);
+            j += 8;
+        }
+    }
+}
+
+static int maxpool_avx2_supported(const maxpool_layer l)
+{
+    return (l.stride == 1 || l.stride == 2) && __builtin_cpu_supports("avx2");
+}
+#endif
+
 void forward_maxpool_layer(const maxpool_layer l, network net)
 {
     int b,i,j,k,m,n;
+    /* inference keeps no indexes, so there is nothing for backward to route through */
+    if(!l.indexes){
+        for(k = 0; k < l.batch*l.c; ++k){
+            const float *in = net.input + k*l.h*l.w;
+            float *out = l.output + k*l.out_h*l.out_w;
+#if defined(__x86_64__) || defined(__i386__)
+            if(maxpool_avx2_supported(l)){
+                maxpool_plane_avx2(l, in, out);
+                continue;
+            }
+#endif
+            maxpool_plane_scalar(l, in, out);
+        }
+        return;
+    }
     int w_offset = -l.pad/2;
     int h_offset = -l.pad/2;
 
@@ -106,7 +216,7 @@ void forward_maxpool_layer(const maxpool_layer l, network net)
                         }
                     }
                     l.output[out_index] = max;
-                    l.indexes[out_index] = max_i;
+                    if(l.indexes) l.indexes[out_index] = max_i;
                 }
             }
         }
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <assert.h>
+#include <sys/mman.h>
 #include "network.h"
 #include "image.h"
 #include "data.h"
@@ -14,6 +15,8 @@
 #include "crnn_layer.h"
 #include "local_layer.h"
 #include "convolutional_layer.h"
+#include "conv_algorithms.h"
+#include "xnor.h"
 #include "activation_layer.h"
 #include "detection_layer.h"
 #include "region_layer.h"
@@ -30,6 +33,7 @@
 #include "upsample_layer.h"
 #include "shortcut_layer.h"
 #include "parser.h"
+#include "profile.h"
 #include "data.h"
 
 load_args get_base_args(network *net)
@@ -55,11 +59,320 @@ network *load_network(char *cfg, char *weights, int clear)
     network *net = parse_network_cfg(cfg);
     if(weights && weights[0] != 0){
         load_weights(net, weights);
+        pack_network_weights(net);
     }
     if(clear) (*net->seen) = 0;
     return net;
 }
 
+/*
+ * Inference only: batch norm uses the rolling statistics, so
+ * scales*(x - mean)/(sqrt(variance) + .000001) + biases is a per-filter affine
+ * map of the convolution and goes into the weights and biases once. The
+ * layers then run without batch norm and bias and activation fuse into the
+ * convolution. The folded network can no longer be trained or saved, and it
+ * is parsed without training buffers, so once folded the statistics go too.
+ */
+network *load_inference_network(char *cfg, char *weights)
+{
+    network *net = parse_inference_network_cfg(cfg);
+    if(weights && weights[0] != 0){
+        load_weights(net, weights);
+    }
+    fold_batchnorm_network(net);
+    int i;
+    for(i = 0; i < net->n; ++i){
+        free_layer_training(net->layers + i);
+    }
+    pack_network_weights(net);
+    net->train = 0;
+    net->inference = 1;
+    return net;
+}
+
+void fold_batchnorm_network(network *net)
+{
+    int i, j, f;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type != CONVOLUTIONAL || !l->batch_normalize) continue;
+        int size = l->nweights/l->n;
+        for(f = 0; f < l->n; ++f){
+            float scale = l->scales[f]/(sqrt(l->rolling_variance[f]) + .000001f);
+            for(j = 0; j < size; ++j){
+                l->weights[f*size + j] *= scale;
+            }
+            l->biases[f] -= l->rolling_mean[f]*scale;
+        }
+        l->batch_normalize = 0;
+    }
+    net->inference = 1;
+}
+
+/* layer i reads the output of the layer it names, a dropout passes its input on */
+static int output_owner(network *net, int i)
+{
+    while(i > 0 && net->layers[i].type == DROPOUT) --i;
+    return i;
+}
+
+static int can_share_output(layer l)
+{
+    return l.type == CONVOLUTIONAL || l.type == CONNECTED || l.type == MAXPOOL || l.type == AVGPOOL ||
+           l.type == SOFTMAX || l.type == ROUTE || l.type == SHORTCUT;
+}
+
+/*
+ * Forward only: an output is alive from its layer until the last layer that
+ * reads it, the next layer or a route or shortcut further on. Outputs whose
+ * lifetimes do not overlap go into the same buffer, so a plain chain runs in
+ * two buffers that stay in cache. The network output and anything after it
+ * keep their own.
+ */
+void share_network_outputs(network *net)
+{
+    int i, j, k;
+    int n = net->n;
+    if(net->gpu_index >= 0 || net->output_buffers) return;
+    int *last_use = calloc(n, sizeof(int));
+    int *buffer = calloc(n, sizeof(int));
+    int *holder = calloc(n, sizeof(int));
+    size_t *size = calloc(n, sizeof(size_t));
+    int output = n - 1;
+    while(output > 0 && net->layers[output].type == COST) --output;
+    output = output_owner(net, output);
+
+    for(i = 0; i < n; ++i){
+        layer l = net->layers[i];
+        last_use[i] = i >= output ? n : i;
+        if(i > 0){
+            k = output_owner(net, i-1);
+            if(i > last_use[k]) last_use[k] = i;
+        }
+        if(l.type == ROUTE){
+            for(j = 0; j < l.n; ++j){
+                k = output_owner(net, l.input_layers[j]);
+                if(i > last_use[k]) last_use[k] = i;
+            }
+        } else if(l.type == SHORTCUT){
+            k = output_owner(net, l.index);
+            if(i > last_use[k]) last_use[k] = i;
+        }
+    }
+
+    int buffers = 0;
+    int count = 0;
+    size_t unshared = 0;
+    for(i = 0; i < n; ++i){
+        layer l = net->layers[i];
+        buffer[i] = -1;
+        if(!can_share_output(l) || last_use[i] >= n) continue;
+        unshared += (size_t)l.outputs*l.batch;
+        ++count;
+        int free_buffer = -1;
+        for(j = 0; j < buffers; ++j){
+            if(last_use[holder[j]] < i){
+                free_buffer = j;
+                break;
+            }
+        }
+        if(free_buffer < 0) free_buffer = buffers++;
+        buffer[i] = free_buffer;
+        holder[free_buffer] = i;
+        if((size_t)l.outputs*l.batch > size[free_buffer]) size[free_buffer] = (size_t)l.outputs*l.batch;
+    }
+
+    size_t shared = 0;
+    net->n_output_buffers = buffers;
+    net->output_buffers = calloc(buffers ? buffers : 1, sizeof(float *));
+    for(j = 0; j < buffers; ++j){
+        net->output_buffers[j] = calloc(size[j], sizeof(float));
+        shared += size[j];
+    }
+    for(i = 0; i < n; ++i){
+        layer *l = net->layers + i;
+        if(buffer[i] >= 0){
+            free(l->output);
+            l->output = net->output_buffers[buffer[i]];
+        } else if(l->type == DROPOUT && i > 0){
+            l->output = net->layers[i-1].output;
+        }
+    }
+    fprintf(stderr, "activations: %d layer outputs in %d shared buffers, %.1f KB instead of %.1f KB\n",
+            count, buffers, shared*sizeof(float)/1024., unshared*sizeof(float)/1024.);
+
+    free(last_use);
+    free(buffer);
+    free(holder);
+    free(size);
+}
+
+static int context_supported(layer l)
+{
+    return can_share_output(l) || l.type == COST || l.type == DROPOUT;
+}
+
+static float *context_copy(float *p, size_t n)
+{
+    return p ? calloc(n, sizeof(float)) : 0;
+}
+
+/*
+ * Forward only: a context runs the network it is made from on its own
+ * activations. Weights, biases and packed panels stay with net and are only
+ * read, so any number of contexts can predict at the same time from different
+ * threads; everything a forward pass writes (layer outputs, batch norm and
+ * xnor scratch, the workspace, cost) is private and sized for batch images,
+ * or net's current batch if batch is 0. Outputs net shares keep the same
+ * sharing. net must outlive its contexts, free them with free_network.
+ */
+network *make_network_context(network *net, int batch)
+{
+    int i, j;
+    if(net->shared) net = net->shared;
+    int n = net->n;
+    if(batch <= 0) batch = net->batch;
+#ifdef GPU
+    if(net->gpu_index >= 0) error("Network contexts are CPU only");
+#endif
+    for(i = 0; i < n; ++i){
+        if(!context_supported(net->layers[i])) error("Network context: unsupported layer type");
+    }
+
+    network *ctx = calloc(1, sizeof(network));
+    *ctx = *net;
+    ctx->shared = net;
+    ctx->profile = 0;
+    ctx->mapping = 0;
+    ctx->mapping_size = 0;
+    ctx->input = 0;
+    ctx->truth = 0;
+    ctx->delta = 0;
+    ctx->train = 0;
+    ctx->batch = batch;
+    ctx->seen = calloc(1, sizeof(size_t));
+    ctx->t    = calloc(1, sizeof(int));
+    ctx->cost = calloc(1, sizeof(float));
+    ctx->layers = calloc(n, sizeof(layer));
+
+    /* one private buffer per distinct output, as large as the largest layer writing it */
+    float **outputs = calloc(n, sizeof(float *));
+    size_t *sizes = calloc(n, sizeof(size_t));
+    int buffers = 0;
+    size_t workspace_size = 0;
+    for(i = 0; i < n; ++i){
+        layer l = net->layers[i];
+        size_t size = (size_t)l.outputs*batch;
+        for(j = 0; j < buffers && outputs[j] != l.output; ++j);
+        if(j == buffers) outputs[buffers++] = l.output;
+        if(size > sizes[j]) sizes[j] = size;
+        if(l.workspace_size > workspace_size) workspace_size = l.workspace_size;
+    }
+    ctx->n_output_buffers = buffers;
+    ctx->output_buffers = calloc(buffers ? buffers : 1, sizeof(float *));
+    for(j = 0; j < buffers; ++j){
+        ctx->output_buffers[j] = calloc(sizes[j], sizeof(float));
+    }
+    for(i = 0; i < n; ++i){
+        layer *l = ctx->layers + i;
+        *l = net->layers[i];
+        l->batch = batch;
+        size_t size = (size_t)l->outputs*batch;
+        for(j = 0; outputs[j] != l->output; ++j);
+        l->output = ctx->output_buffers[j];
+        l->delta = 0;
+        l->x = context_copy(l->x, size);
+        l->x_norm = context_copy(l->x_norm, size);
+        l->indexes = l->indexes ? calloc(size, sizeof(int)) : 0;
+        if(l->xnor){
+            l->binary_weights = context_copy(l->binary_weights, l->nweights);
+            l->binary_input = context_copy(l->binary_input, (size_t)l->inputs*batch);
+        }
+    }
+    ctx->workspace = workspace_size ? calloc(1, workspace_size) : 0;
+    ctx->output = get_network_output_layer(ctx).output;
+
+    free(outputs);
+    free(sizes);
+    return ctx;
+}
+
+static void free_network_context(network *ctx)
+{
+    int i, j;
+    for(i = 0; i < ctx->n; ++i){
+        layer *l = ctx->layers + i;
+        free(l->x);
+        free(l->x_norm);
+        free(l->indexes);
+        if(l->xnor){
+            free(l->binary_weights);
+            free(l->binary_input);
+        }
+    }
+    for(j = 0; j < ctx->n_output_buffers; ++j){
+        free(ctx->output_buffers[j]);
+    }
+    free(ctx->output_buffers);
+    free(ctx->workspace);
+    free(ctx->layers);
+    free(ctx->seen);
+    free(ctx->t);
+    free(ctx->cost);
+    stop_network_profile(ctx);
+    free(ctx);
+}
+
+/* arrays of a packed network point into its mapping and are not ours to free */
+static void release_weights(network *net, float **p)
+{
+    char *map = net->mapping;
+    if(*p && !(map && (char *)*p >= map && (char *)*p < map + net->mapping_size)) free(*p);
+    *p = 0;
+}
+
+void pack_layer_weights(layer *l)
+{
+    int j;
+    if(l->type == CONVOLUTIONAL && l->xnor){
+        pack_xnor_weights(l);
+    } else if(l->type == CONVOLUTIONAL && !l->binary){
+        int m = l->n/l->groups;
+        int k = l->size*l->size*l->c/l->groups;
+        size_t size = gemm_packed_size_a(m, k);
+        l->packed_weights = calloc(size*l->groups, sizeof(float));
+        for(j = 0; j < l->groups; ++j){
+            gemm_pack_a(0, m, k, l->weights + j*l->nweights/l->groups, k, l->packed_weights + j*size);
+        }
+        pack_conv_algorithm_weights(l);
+    } else if(l->type == CONNECTED){
+        l->packed_weights = calloc(gemm_packed_size_b(l->inputs, l->outputs), sizeof(float));
+        gemm_pack_b(1, l->inputs, l->outputs, l->weights, l->inputs, l->packed_weights);
+    }
+}
+
+void pack_network_weights(network *net)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        release_weights(net, &l->packed_weights);
+        release_weights(net, &l->algorithm_weights);
+        pack_layer_weights(l);
+    }
+}
+
+void unpack_network_weights(network *net)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        release_weights(net, &l->packed_weights);
+        release_weights(net, &l->algorithm_weights);
+    }
+    unbinarize_xnor_network(net);
+}
+
 size_t get_current_batch(network *net)
 {
     size_t batch_num = (*net->seen)/(net->batch*net->subdivisions);
@@ -194,6 +507,7 @@ void forward_network(network *netp)
     }
 #endif
     network net = *netp;
+    network_profile *profile = net.profile;
     int i;
     for(i = 0; i < net.n; ++i){
         net.index = i;
@@ -201,17 +515,23 @@ void forward_network(network *netp)
         if(l.delta){
             fill_cpu(l.outputs * l.batch, 0, l.delta, 1);
         }
+        double start = profile ? profile_clock() : 0;
         l.forward(l, net);
+        if(profile) profile_record(profile, i, profile_clock() - start);
         net.input = l.output;
         if(l.truth) {
             net.truth = l.output;
         }
     }
+    if(profile) profile_end_run(profile, net.batch);
     calc_network_cost(netp);
 }
 
 void update_network(network *netp)
 {
+    if(netp->inference) error("Cannot train a network loaded for inference");
+    // packed copies would go stale once the weights change
+    unpack_network_weights(netp);
 #ifdef GPU
     if(netp->gpu_index >= 0){
         update_network_gpu(netp);   
@@ -357,6 +677,7 @@ void set_batch_network(network *net, int b)
 
 int resize_network(network *net, int w, int h)
 {
+    if(net->output_buffers) error("Cannot resize a network whose layers share output buffers");
 #ifdef GPU
     cuda_set_device(net->gpu_index);
     cuda_free(net->workspace);
@@ -715,10 +1036,28 @@ float network_accuracy_multi(network *net, data d, int n)
 
 void free_network(network *net)
 {
-    int i;
+    int i, j;
+    if(net->shared){
+        free_network_context(net);
+        return;
+    }
     for(i = 0; i < net->n; ++i){
-        free_layer(net->layers[i]);
+        layer *l = net->layers + i;
+        for(j = 0; j < net->n_output_buffers; ++j){
+            if(l->output == net->output_buffers[j]) l->output = 0;
+        }
+        release_weights(net, &l->weights);
+        release_weights(net, &l->biases);
+        release_weights(net, &l->packed_weights);
+        release_weights(net, &l->algorithm_weights);
+        free_layer(*l);
+    }
+    stop_network_profile(net);
+    if(net->mapping) munmap(net->mapping, net->mapping_size);
+    for(j = 0; j < net->n_output_buffers; ++j){
+        free(net->output_buffers[j]);
     }
+    if(net->output_buffers) free(net->output_buffers);
     free(net->layers);
     if(net->input) free(net->input);
     if(net->truth) free(net->truth);
@@ -2,6 +2,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "activation_layer.h"
 #include "logistic_layer.h"
@@ -11,6 +15,7 @@
 #include "batchnorm_layer.h"
 #include "blas.h"
 #include "connected_layer.h"
+#include "conv_algorithms.h"
 #include "deconvolutional_layer.h"
 #include "convolutional_layer.h"
 #include "cost_layer.h"
@@ -199,7 +204,7 @@ convolutional_layer parse_convolutional(list *options, size_params params)
     int binary = option_find_int_quiet(options, "binary", 0);
     int xnor = option_find_int_quiet(options, "xnor", 0);
 
-    convolutional_layer layer = make_convolutional_layer(batch,h,w,c,n,groups,size,stride,padding,activation, batch_normalize, binary, xnor, params.net->adam);
+    convolutional_layer layer = make_convolutional_layer(batch,h,w,c,n,groups,size,stride,padding,activation, batch_normalize, binary, xnor, params.net->adam, !params.net->inference);
     layer.flipped = option_find_int_quiet(options, "flipped", 0);
     layer.dot = option_find_float_quiet(options, "dot", 0);
 
@@ -263,7 +268,7 @@ layer parse_connected(list *options, size_params params)
     ACTIVATION activation = get_activation(activation_s);
     int batch_normalize = option_find_int_quiet(options, "batch_normalize", 0);
 
-    layer l = make_connected_layer(params.batch, params.inputs, output, activation, batch_normalize, params.net->adam);
+    layer l = make_connected_layer(params.batch, params.inputs, output, activation, batch_normalize, params.net->adam, !params.net->inference);
     return l;
 }
 
@@ -493,7 +498,7 @@ maxpool_layer parse_maxpool(list *options, size_params params)
     batch=params.batch;
     if(!(h && w && c)) error("Layer before maxpool layer must output image.");
 
-    maxpool_layer layer = make_maxpool_layer(batch,h,w,c,size,stride,padding);
+    maxpool_layer layer = make_maxpool_layer(batch,h,w,c,size,stride,padding,!params.net->inference);
     return layer;
 }
 
@@ -739,9 +744,8 @@ int is_network(section *s)
             || strcmp(s->type, "[network]")==0);
 }
 
-network *parse_network_cfg(char *filename)
+static network *parse_network(list *sections, int inference)
 {
-    list *sections = read_cfg(filename);
     node *n = sections->front;
     if(!n) error("Config file has no sections");
     network *net = make_network(sections->size - 1);
@@ -760,6 +764,7 @@ network *parse_network_cfg(char *filename)
     params.batch = net->batch;
     params.time_steps = net->time_steps;
     params.net = net;
+    net->inference = inference;
 
     size_t workspace_size = 0;
     n = n->next;
@@ -848,6 +853,7 @@ network *parse_network_cfg(char *filename)
         l.learning_rate_scale = option_find_float_quiet(options, "learning_rate", 1);
         l.smooth = option_find_float_quiet(options, "smooth", 0);
         option_unused(options);
+        if(inference) free_layer_training(&l);
         net->layers[count] = l;
         if (l.workspace_size > workspace_size) workspace_size = l.workspace_size;
         free_section(s);
@@ -861,13 +867,14 @@ network *parse_network_cfg(char *filename)
         }
     }
     free_list(sections);
+    if(inference) share_network_outputs(net);
     layer out = get_network_output_layer(net);
     net->outputs = out.outputs;
     net->truths = out.outputs;
     if(net->layers[net->n-1].truths) net->truths = net->layers[net->n-1].truths;
     net->output = out.output;
     net->input = calloc(net->inputs*net->batch, sizeof(float));
-    net->truth = calloc(net->truths*net->batch, sizeof(float));
+    if(!inference) net->truth = calloc(net->truths*net->batch, sizeof(float));
 #ifdef GPU
     net->output_gpu = out.output_gpu;
     net->input_gpu = cuda_make_array(net->input, net->inputs*net->batch);
@@ -888,10 +895,23 @@ network *parse_network_cfg(char *filename)
     return net;
 }
 
-list *read_cfg(char *filename)
+network *parse_network_cfg(char *filename)
+{
+    return parse_network(read_cfg(filename), 0);
+}
+
+/*
+ * Forward only: the layers keep their weights and outputs but none of the
+ * buffers backward and update need, and layers whose outputs are never alive
+ * at the same time write into the same buffer.
+ */
+network *parse_inference_network_cfg(char *filename)
+{
+    return parse_network(read_cfg(filename), 1);
+}
+
+static list *read_cfg_file(FILE *file)
 {
-    FILE *file = fopen(filename, "r");
-    if(file == 0) file_error(filename);
     char *line;
     int nu = 0;
     list *options = make_list();
@@ -919,6 +939,14 @@ list *read_cfg(char *filename)
                 break;
         }
     }
+    return options;
+}
+
+list *read_cfg(char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if(file == 0) file_error(filename);
+    list *options = read_cfg_file(file);
     fclose(file);
     return options;
 }
@@ -1011,6 +1039,7 @@ void save_weights_upto(network *net, char *filename, int cutoff)
         cuda_set_device(net->gpu_index);
     }
 #endif
+    if(net->inference) error("Cannot save a network loaded for inference, its batch norm is folded into the weights");
     fprintf(stderr, "Saving weights to %s\n", filename);
     FILE *fp = fopen(filename, "wb");
     if(!fp) file_error(filename);
@@ -1310,3 +1339,214 @@ void load_weights(network *net, char *filename)
     load_weights_upto(net, filename, 0, net->n);
 }
 
+
+/*
+ * Packed networks: one file holding the cfg text and, for every layer with
+ * weights, the folded weights and biases plus the GEMM panels and algorithm
+ * weights pack_network_weights would compute, each 64 byte aligned. The
+ * loader maps the file read-only and points the layers into it, so startup
+ * reads no weights and packs nothing. GEMM panels depend on the kernel they
+ * were packed for; on a machine that picks another kernel, or another conv
+ * algorithm, those layers are repacked from the mapped weights instead.
+ * The file is written under a temporary name and renamed when complete, and
+ * the loader checks every offset against the file size, so a truncated or
+ * corrupt file is rejected with an error instead of faulting in forward.
+ */
+
+#define PACKED_MAGIC 0x4b504e44
+#define PACKED_VERSION 1
+#define PACKED_ALIGN 64
+
+typedef struct{
+    int magic;
+    int version;
+    char kernel[16];
+    int layers;
+    int cfg_size;
+    size_t cfg_offset;
+    size_t table_offset;
+} packed_header;
+
+/* byte offsets into the file, 0 when the array is not stored */
+typedef struct{
+    int algorithm;
+    int unused;
+    size_t weights;
+    size_t biases;
+    size_t packed;
+    size_t packed_size;
+    size_t algorithm_weights;
+    size_t algorithm_size;
+} packed_entry;
+
+static size_t packed_weights_size(layer l)
+{
+    if(l.type == CONVOLUTIONAL){
+        return gemm_packed_size_a(l.n/l.groups, l.size*l.size*l.c/l.groups)*l.groups;
+    }
+    if(l.type == CONNECTED) return gemm_packed_size_b(l.inputs, l.outputs);
+    return 0;
+}
+
+/* errors out unless n items of the given size at offset lie inside the mapping and are aligned as written */
+static void packed_check(char *filename, size_t length, size_t offset, size_t n, size_t size)
+{
+    if(offset % PACKED_ALIGN || offset > length || n > (length - offset)/size){
+        fprintf(stderr, "%s: %zu bytes at offset %zu outside the %zu byte file\n", filename, n*size, offset, length);
+        error("Truncated or corrupt packed network");
+    }
+}
+
+static size_t packed_write(FILE *fp, const void *data, size_t size)
+{
+    static const char zeros[PACKED_ALIGN] = {0};
+    long pos = ftell(fp);
+    if(pos % PACKED_ALIGN) fwrite(zeros, 1, PACKED_ALIGN - pos % PACKED_ALIGN, fp);
+    size_t offset = ftell(fp);
+    fwrite(data, 1, size, fp);
+    return offset;
+}
+
+int is_packed_network(char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if(!fp) return 0;
+    int magic = 0;
+    int ok = fread(&magic, sizeof(int), 1, fp) == 1 && magic == PACKED_MAGIC;
+    fclose(fp);
+    return ok;
+}
+
+void save_packed_network(network *net, char *cfgfile, char *filename)
+{
+    if(!net->inference) error("Only networks loaded for inference can be packed");
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        int supported = l.type == MAXPOOL || l.type == AVGPOOL || l.type == SOFTMAX || l.type == DROPOUT ||
+                        l.type == COST || l.type == ROUTE || l.type == SHORTCUT;
+        if(l.type == CONVOLUTIONAL) supported = !l.binary && !l.xnor && !l.batch_normalize;
+        if(l.type == CONNECTED) supported = !l.batch_normalize;
+        if(!supported){
+            fprintf(stderr, "layer %d: %s\n", i, get_layer_string(l.type));
+            error("Layer cannot be packed");
+        }
+    }
+
+    FILE *cfg = fopen(cfgfile, "rb");
+    if(!cfg) file_error(cfgfile);
+    fseek(cfg, 0, SEEK_END);
+    long cfg_size = ftell(cfg);
+    fseek(cfg, 0, SEEK_SET);
+    char *text = calloc(cfg_size, 1);
+    if(fread(text, 1, cfg_size, cfg) != (size_t)cfg_size) file_error(cfgfile);
+    fclose(cfg);
+
+    /* written under a temporary name and renamed into place, so an interrupted
+     * run never leaves a file that looks packed but is incomplete */
+    char *temp = calloc(strlen(filename) + 5, sizeof(char));
+    sprintf(temp, "%s.tmp", filename);
+    FILE *fp = fopen(temp, "wb");
+    if(!fp) file_error(temp);
+    packed_header header = {0};
+    packed_entry *table = calloc(net->n, sizeof(packed_entry));
+    header.magic = PACKED_MAGIC;
+    header.version = PACKED_VERSION;
+    strncpy(header.kernel, gemm_kernel_name(gemm_get_kernel()), sizeof(header.kernel) - 1);
+    header.layers = net->n;
+    header.cfg_size = cfg_size;
+    fwrite(&header, sizeof(header), 1, fp);
+    header.cfg_offset = packed_write(fp, text, cfg_size);
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        packed_entry *e = table + i;
+        if(l.type != CONVOLUTIONAL && l.type != CONNECTED) continue;
+        int biases = l.type == CONVOLUTIONAL ? l.n : l.outputs;
+        int weights = l.type == CONVOLUTIONAL ? l.nweights : l.inputs*l.outputs;
+        e->weights = packed_write(fp, l.weights, weights*sizeof(float));
+        e->biases = packed_write(fp, l.biases, biases*sizeof(float));
+        if(l.packed_weights){
+            e->packed_size = packed_weights_size(l);
+            e->packed = packed_write(fp, l.packed_weights, e->packed_size*sizeof(float));
+        }
+        if(l.type == CONVOLUTIONAL && l.algorithm_weights){
+            e->algorithm = l.conv_algorithm;
+            e->algorithm_size = conv_algorithm_weights_size(l);
+            e->algorithm_weights = packed_write(fp, l.algorithm_weights, e->algorithm_size*sizeof(float));
+        }
+    }
+    header.table_offset = packed_write(fp, table, net->n*sizeof(packed_entry));
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fp);
+    int failed = ferror(fp);
+    if(fclose(fp) || failed || rename(temp, filename)){
+        unlink(temp);
+        file_error(filename);
+    }
+    free(temp);
+    free(table);
+    free(text);
+}
+
+network *load_packed_network(char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) file_error(filename);
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(packed_header)) file_error(filename);
+    char *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) file_error(filename);
+    packed_header header;
+    memcpy(&header, map, sizeof(header));
+    header.kernel[sizeof(header.kernel) - 1] = 0;
+    if(header.magic != PACKED_MAGIC || header.version != PACKED_VERSION) error("Not a packed network");
+    size_t length = st.st_size;
+    if(header.cfg_size <= 0 || header.layers <= 0) error("Truncated or corrupt packed network");
+    packed_check(filename, length, header.cfg_offset, header.cfg_size, 1);
+    packed_check(filename, length, header.table_offset, header.layers, sizeof(packed_entry));
+
+    FILE *cfg = fmemopen(map + header.cfg_offset, header.cfg_size, "r");
+    if(!cfg) file_error(filename);
+    network *net = parse_network(read_cfg_file(cfg), 1);
+    fclose(cfg);
+    if(net->n != header.layers) error("Packed network does not match its cfg");
+    net->mapping = map;
+    net->mapping_size = st.st_size;
+    net->train = 0;
+
+    int same_kernel = !strcmp(header.kernel, gemm_kernel_name(gemm_get_kernel()));
+    packed_entry *table = (packed_entry *)(map + header.table_offset);
+    int i;
+    int repacked = 0;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        packed_entry e = table[i];
+        if(l->type != CONVOLUTIONAL && l->type != CONNECTED) continue;
+        size_t weights = l->type == CONVOLUTIONAL ? l->nweights : (size_t)l->inputs*l->outputs;
+        size_t biases = l->type == CONVOLUTIONAL ? l->n : l->outputs;
+        if(!e.weights) error("Packed network is missing layer weights");
+        packed_check(filename, length, e.weights, weights, sizeof(float));
+        packed_check(filename, length, e.biases, biases, sizeof(float));
+        if(e.packed) packed_check(filename, length, e.packed, e.packed_size, sizeof(float));
+        if(e.algorithm_weights) packed_check(filename, length, e.algorithm_weights, e.algorithm_size, sizeof(float));
+        free(l->weights);
+        free(l->biases);
+        l->weights = (float *)(map + e.weights);
+        l->biases = (float *)(map + e.biases);
+        l->batch_normalize = 0;
+        free_layer_training(l);
+        int panels = e.packed && same_kernel && e.packed_size == packed_weights_size(*l);
+        int algorithm = l->type != CONVOLUTIONAL || l->conv_algorithm == CONV_GEMM ||
+                        (e.algorithm_weights && e.algorithm == l->conv_algorithm && e.algorithm_size == conv_algorithm_weights_size(*l));
+        if(panels && algorithm){
+            l->packed_weights = (float *)(map + e.packed);
+            if(e.algorithm_weights && e.algorithm == l->conv_algorithm) l->algorithm_weights = (float *)(map + e.algorithm_weights);
+        } else {
+            pack_layer_weights(l);
+            ++repacked;
+        }
+    }
+    fprintf(stderr, "Mapped %s, %d layers repacked for the %s GEMM kernel\n", filename, repacked, gemm_kernel_name(gemm_get_kernel()));
+    return net;
+}
@@ -0,0 +1,167 @@
+#include "profile.h"
+#include "network.h"
+#include "utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Per-layer timing of forward_network.
+ *
+ * Once start_network_profile is called every forward pass records the time
+ * of each layer on the monotonic clock, keeping the last runs passes so the
+ * percentiles follow the current state of the machine. The FLOPs and bytes of
+ * a layer are counted per image from its shape: a multiply-add is two FLOPs,
+ * a pooling compare one, and the bytes are the input and output once each
+ * plus the weights once per pass, the traffic the layer cannot avoid.
+ */
+
+struct network_profile{
+    int n;
+    /* passes kept, the oldest overwritten first */
+    int capacity;
+    /* passes recorded since the last reset */
+    int runs;
+    /* capacity rows of n layer times and the whole pass, in seconds */
+    double *times;
+    /* batch of each kept pass */
+    int *batches;
+};
+
+double profile_clock()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+void profile_record(network_profile *p, int layer, double seconds)
+{
+    p->times[(size_t)(p->runs % p->capacity)*(p->n + 1) + layer] = seconds;
+}
+
+void profile_end_run(network_profile *p, int batch)
+{
+    double *row = p->times + (size_t)(p->runs % p->capacity)*(p->n + 1);
+    double total = 0;
+    int i;
+    for(i = 0; i < p->n; ++i) total += row[i];
+    row[p->n] = total;
+    p->batches[p->runs % p->capacity] = batch;
+    ++p->runs;
+}
+
+void start_network_profile(network *net, int runs)
+{
+    stop_network_profile(net);
+    network_profile *p = calloc(1, sizeof(network_profile));
+    p->n = net->n;
+    p->capacity = runs > 0 ? runs : 1000;
+    p->times = calloc((size_t)p->capacity*(p->n + 1), sizeof(double));
+    p->batches = calloc(p->capacity, sizeof(int));
+    net->profile = p;
+}
+
+void stop_network_profile(network *net)
+{
+    network_profile *p = net->profile;
+    if(!p) return;
+    free(p->times);
+    free(p->batches);
+    free(p);
+    net->profile = 0;
+}
+
+void reset_network_profile(network *net)
+{
+    if(net->profile) net->profile->runs = 0;
+}
+
+double layer_flops(layer l)
+{
+    switch(l.type){
+        case CONVOLUTIONAL:
+            return 2.*l.nweights*l.out_h*l.out_w;
+        case CONNECTED:
+            return 2.*l.inputs*l.outputs;
+        case MAXPOOL:
+            return (double)l.size*l.size*l.outputs;
+        case AVGPOOL:
+            return l.inputs;
+        case SOFTMAX:
+            return 3.*l.inputs;
+        default:
+            return l.outputs;
+    }
+}
+
+double layer_bytes(layer l, int batch)
+{
+    double weights = 0;
+    if(l.type == CONVOLUTIONAL) weights = (double)l.nweights*(l.int8_weights ? 1 : sizeof(float)) + l.n*sizeof(float);
+    if(l.type == CONNECTED) weights = ((double)l.inputs*l.outputs + l.outputs)*sizeof(float);
+    return (double)(l.inputs + l.outputs)*sizeof(float) + weights/(batch > 0 ? batch : 1);
+}
+
+static int profile_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* nearest rank */
+static double profile_percentile(const double *sorted, int n, double p)
+{
+    int rank = (int)ceil(p*n);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void print_network_profile(network *net, FILE *fp)
+{
+    network_profile *p = net->profile;
+    if(!p || !p->runs){
+        fprintf(fp, "no forward passes profiled\n");
+        return;
+    }
+    int kept = p->runs < p->capacity ? p->runs : p->capacity;
+    double *sorted = calloc(kept, sizeof(double));
+    double images = 0;
+    double whole = 0;
+    int i, r;
+    for(r = 0; r < kept; ++r){
+        images += p->batches[r];
+        whole += p->times[(size_t)r*(p->n + 1) + p->n];
+    }
+    fprintf(fp, "%d passes, %.0f images, batch %.1f on average\n", kept, images, images/kept);
+    fprintf(fp, "%5s %-13s %9s %9s %9s %9s %6s %10s %8s %9s %7s\n", "layer", "type", "p50 ms", "p90 ms", "p99 ms", "mean ms", "share",
+            "MFLOP/img", "GFLOP/s", "KB/img", "GB/s");
+    for(i = 0; i <= p->n; ++i){
+        double sum = 0, flops = 0, bytes = 0;
+        for(r = 0; r < kept; ++r){
+            double t = p->times[(size_t)r*(p->n + 1) + i];
+            sorted[r] = t;
+            sum += t;
+            if(i < p->n){
+                flops += layer_flops(net->layers[i])*p->batches[r];
+                bytes += layer_bytes(net->layers[i], p->batches[r])*p->batches[r];
+            } else {
+                int j;
+                for(j = 0; j < p->n; ++j){
+                    flops += layer_flops(net->layers[j])*p->batches[r];
+                    bytes += layer_bytes(net->layers[j], p->batches[r])*p->batches[r];
+                }
+            }
+        }
+        qsort(sorted, kept, sizeof(double), profile_compare);
+        if(i < p->n) fprintf(fp, "%5d %-13s", i, get_layer_string(net->layers[i].type));
+        else fprintf(fp, "%5s %-13s", "", "total");
+        fprintf(fp, " %9.4f %9.4f %9.4f %9.4f %5.1f%% %10.3f %8.2f %9.1f %7.2f\n",
+                profile_percentile(sorted, kept, .5)*1000, profile_percentile(sorted, kept, .9)*1000,
+                profile_percentile(sorted, kept, .99)*1000, sum/kept*1000, whole > 0 ? sum/whole*100 : 0,
+                flops/images/1e6, sum > 0 ? flops/sum/1e9 : 0, bytes/images/1024, sum > 0 ? bytes/sum/1e9 : 0);
+    }
+    free(sorted);
+}
@@ -0,0 +1,10 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "darknet.h"
+
+double profile_clock();
+void profile_record(network_profile *p, int layer, double seconds);
+void profile_end_run(network_profile *p, int batch);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include "darknet.h"
+
+void forward_int8_convolution(layer l, float *in, float *out, float *workspace, int activate);
+
+#endif
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Persistent worker threads for the CPU loops.
+ *
+ * An OpenMP parallel region wakes its team on every entry and lets the
+ * runtime decide where the threads run. The classifier issues dozens of small
+ * loops per frame next to the camera and vision threads, so here the workers
+ * are started once, optionally pinned to given cores, and sleep on a condition
+ * variable between loops. The calling thread takes chunks like any worker, and
+ * loops below PARALLEL_MIN_WORK, nested loops and loops submitted while another
+ * thread holds the pool run serially on the caller instead of waiting.
+ */
+
+/* below this much work (about one multiply-add per unit) waking the workers costs more than it saves */
+#define PARALLEL_MIN_WORK (1 << 20)
+/* chunks per thread, so faster threads pick up the slack of slower ones */
+#define PARALLEL_CHUNKS 4
+
+typedef struct{
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_t *workers;
+    int *cores;
+    int ncores;
+    int nworkers;
+    int stop;
+    unsigned long generation;
+
+    parallel_range fn;
+    void *args;
+    int n;
+    int chunk;
+    int next;
+    int active;
+} thread_pool;
+
+static thread_pool pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+/* held for the whole of a parallel loop, and while the pool is started or stopped */
+static pthread_mutex_t pool_submit = PTHREAD_MUTEX_INITIALIZER;
+static int pool_started = 0;
+/* set while this thread is running part of a loop, so loops inside it run serially */
+static __thread int pool_member = 0;
+
+static void run_chunks()
+{
+    while(1){
+        int begin = __atomic_fetch_add(&pool.next, pool.chunk, __ATOMIC_RELAXED);
+        if(begin >= pool.n) break;
+        int end = pool.n - begin < pool.chunk ? pool.n : begin + pool.chunk;
+        pool.fn(pool.args, begin, end);
+    }
+}
+
+static void *pool_worker(void *ptr)
+{
+    int index = (int)(size_t)ptr;
+    if(pool.ncores){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(pool.cores[index % pool.ncores], &set);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set)){
+            fprintf(stderr, "thread pool: could not pin worker %d to core %d\n", index, pool.cores[index % pool.ncores]);
+        }
+    }
+    pool_member = 1;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.mutex);
+    while(1){
+        while(!pool.stop && pool.generation == seen) pthread_cond_wait(&pool.start, &pool.mutex);
+        if(pool.stop) break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.mutex);
+        run_chunks();
+        pthread_mutex_lock(&pool.mutex);
+        if(--pool.active == 0) pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    return 0;
+}
+
+static void stop_workers()
+{
+    int i;
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+    for(i = 0; i < pool.nworkers; ++i) pthread_join(pool.workers[i], 0);
+    free(pool.workers);
+    free(pool.cores);
+    pool.workers = 0;
+    pool.cores = 0;
+    pool.ncores = 0;
+    pool.nworkers = 0;
+    pool.stop = 0;
+}
+
+static void start_workers(int threads, int *cores, int ncores)
+{
+    int i;
+    if(threads <= 0) threads = ncores > 0 ? ncores : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads < 1) threads = 1;
+    if(ncores > 0){
+        pool.cores = calloc(ncores, sizeof(int));
+        for(i = 0; i < ncores; ++i) pool.cores[i] = cores[i];
+        pool.ncores = ncores;
+    }
+    /* workers start out having seen generation 0 */
+    pool.generation = 0;
+    pool.workers = calloc(threads, sizeof(pthread_t));
+    for(i = 0; i < threads - 1; ++i){
+        if(pthread_create(pool.workers + i, 0, pool_worker, (void *)(size_t)i)) error("thread pool: pthread_create failed");
+        ++pool.nworkers;
+    }
+    __atomic_store_n(&pool_started, 1, __ATOMIC_RELEASE);
+}
+
+void thread_pool_init(int threads, int *cores, int ncores)
+{
+    if(pool_member) error("thread pool: cannot be restarted from inside a parallel loop");
+    pthread_mutex_lock(&pool_submit);
+    if(pool_started) stop_workers();
+    start_workers(threads, cores, ncores);
+    pthread_mutex_unlock(&pool_submit);
+}
+
+void thread_pool_free()
+{
+    pthread_mutex_lock(&pool_submit);
+    if(pool_started) stop_workers();
+    __atomic_store_n(&pool_started, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pool_submit);
+}
+
+int thread_pool_threads()
+{
+    return pool_started ? pool.nworkers + 1 : 0;
+}
+
+void parallel_for(int n, double work, parallel_range fn, void *args)
+{
+    if(n <= 0) return;
+    if(n == 1 || work < PARALLEL_MIN_WORK || pool_member){
+        fn(args, 0, n);
+        return;
+    }
+    if(!__atomic_load_n(&pool_started, __ATOMIC_ACQUIRE)){
+        pthread_mutex_lock(&pool_submit);
+        if(!pool_started) start_workers(0, 0, 0);
+        pthread_mutex_unlock(&pool_submit);
+    }
+    /* another thread owns the workers, doing the loop here beats queueing behind it */
+    if(pthread_mutex_trylock(&pool_submit)){
+        fn(args, 0, n);
+        return;
+    }
+    if(pool.nworkers == 0){
+        pthread_mutex_unlock(&pool_submit);
+        fn(args, 0, n);
+        return;
+    }
+
+    int chunk = n/((pool.nworkers + 1)*PARALLEL_CHUNKS);
+    pthread_mutex_lock(&pool.mutex);
+    pool.fn = fn;
+    pool.args = args;
+    pool.n = n;
+    pool.chunk = chunk < 1 ? 1 : chunk;
+    pool.next = 0;
+    pool.active = pool.nworkers;
+    ++pool.generation;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+
+    pool_member = 1;
+    run_chunks();
+    pool_member = 0;
+
+    pthread_mutex_lock(&pool.mutex);
+    while(pool.active) pthread_cond_wait(&pool.done, &pool.mutex);
+    pthread_mutex_unlock(&pool.mutex);
+    pthread_mutex_unlock(&pool_submit);
+}
@@ -0,0 +1,6 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "darknet.h"
+
+#endif
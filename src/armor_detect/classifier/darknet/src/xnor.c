@@ -0,0 +1,395 @@
+#include "xnor.h"
+#include "activations.h"
+#include "utils.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Bit-packed inference for xnor convolutional layers.
+ *
+ * An xnor layer convolves sign(x) with mean|w| * sign(w) per filter, which
+ * forward_convolutional_layer emulates in float by binarizing the weights on
+ * every call and running the ordinary GEMM. Here the signs of the weights are
+ * packed once into 64-bit words along the filter (channel, ky, kx order) and
+ * every forward pass packs the signs of its im2col columns the same way, so
+ * 64 multiply-adds of +1/-1 become one xor and one popcount:
+ *
+ *     sum w*x = valid - 2*popcount((w ^ x) & mask)
+ *
+ * The mask marks the taps that land inside the image. darknet pads with 0,
+ * so taps outside the image contribute nothing, while an input of exactly 0
+ * inside the image binarizes to -1 as binarize_cpu has it. The result is
+ * scaled by mean|w| and gets bias, batch norm and activation like any other
+ * convolution, so the output matches the float emulation up to rounding.
+ *
+ * The input is first copied with zero padding, next to a plane marking which
+ * of its pixels are inside the image. Output pixels are then packed XNOR_PACK
+ * at a time on a grid whose rows are rounded up to XNOR_NR, each tap being
+ * one load at a fixed offset from the pixel, and the bits of a word collect in
+ * a register. The columns past the end of a row are computed and dropped.
+ */
+
+/* the kernel computes XNOR_MR filters x XNOR_NR output pixels */
+#define XNOR_MR 4
+#define XNOR_NR 8
+/* output pixels the input is packed for at once, one 64-bit lane each */
+#define XNOR_PACK 4
+
+static int round_up(int x, int m)
+{
+    return (x + m - 1)/m*m;
+}
+
+static int xnor_binarizable(layer l)
+{
+    return l.type == CONVOLUTIONAL && l.xnor && l.groups == 1;
+}
+
+static int xnor_words(layer l)
+{
+    return (l.c*l.size*l.size + 63)/64;
+}
+
+/* slack for the grid columns past the end of the last row, which read past the plane */
+static size_t xnor_padded_size(layer l)
+{
+    return (size_t)(l.h + 2*l.pad)*(l.w + 2*l.pad) + XNOR_NR*l.stride + l.size;
+}
+
+/* a kernel tile never spans two rows of the grid */
+static int xnor_grid_size(layer l)
+{
+    return l.out_h*round_up(l.out_w, XNOR_NR);
+}
+
+size_t xnor_workspace_size(layer l)
+{
+    size_t padded = xnor_padded_size(l);
+    size_t grid = xnor_grid_size(l);
+    int k = l.c*l.size*l.size;
+    /* padded input and inside plane, tap offsets, input and mask bits, valid counts */
+    return (l.c + 1)*padded*sizeof(float) + 2*(size_t)k*sizeof(int) + 2*(size_t)xnor_words(l)*grid*sizeof(uint64_t) + grid*sizeof(int);
+}
+
+typedef void (*xnor_kernel)(int words, const uint64_t *a, const uint64_t *b, const uint64_t *m, int ldn, int *c);
+/* bits and mask of up to 64 taps for XNOR_PACK output pixels, whose inputs are stride apart */
+typedef void (*xnor_pack)(const float *x, const int *inside, const int *offsets, const int *inside_offsets, int taps, int stride, uint64_t *b, uint64_t *m);
+
+static void xnor_kernel_scalar(int words, const uint64_t *a, const uint64_t *b, const uint64_t *m, int ldn, int *c)
+{
+    int w, r, j;
+    memset(c, 0, XNOR_MR*XNOR_NR*sizeof(int));
+    for(w = 0; w < words; ++w){
+        for(r = 0; r < XNOR_MR; ++r){
+            uint64_t bits = a[w*XNOR_MR + r];
+            for(j = 0; j < XNOR_NR; ++j){
+                c[r*XNOR_NR + j] += __builtin_popcountll((bits ^ b[(size_t)w*ldn + j]) & m[(size_t)w*ldn + j]);
+            }
+        }
+    }
+}
+
+static void xnor_pack_scalar(const float *x, const int *inside, const int *offsets, const int *inside_offsets, int taps, int stride, uint64_t *b, uint64_t *m)
+{
+    int i, t;
+    for(i = 0; i < XNOR_PACK; ++i){
+        const float *xi = x + i*stride;
+        const int *ii = inside + i*stride;
+        uint64_t bits = 0, mask = 0;
+        /* branch free, the signs of activations are as good as random */
+        for(t = 0; t < taps; ++t){
+            bits |= (uint64_t)(xi[offsets[t]] > 0) << t;
+            mask |= (uint64_t)(ii[inside_offsets[t]] & 1) << t;
+        }
+        b[i] = bits;
+        m[i] = mask;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void xnor_pack_avx2(const float *x, const int *inside, const int *offsets, const int *inside_offsets, int taps, int stride, uint64_t *b, uint64_t *m)
+{
+    if(stride != 1){
+        xnor_pack_scalar(x, inside, offsets, inside_offsets, taps, stride, b, m);
+        return;
+    }
+    __m256i bit = _mm256_set1_epi64x(1);
+    __m256i bits = _mm256_setzero_si256(), mask = _mm256_setzero_si256();
+    __m128 zero = _mm_setzero_ps();
+    int t;
+    for(t = 0; t < taps; ++t){
+        __m256i positive = _mm256_cvtepi32_epi64(_mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(x + offsets[t]), zero)));
+        __m256i in = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(inside + inside_offsets[t])));
+        bits = _mm256_or_si256(bits, _mm256_and_si256(positive, bit));
+        mask = _mm256_or_si256(mask, _mm256_and_si256(in, bit));
+        bit = _mm256_slli_epi64(bit, 1);
+    }
+    _mm256_storeu_si256((__m256i *)b, bits);
+    _mm256_storeu_si256((__m256i *)m, mask);
+}
+
+/* per 64-bit lane popcount: nibble lookup with pshufb, bytes summed by sad */
+__attribute__((target("avx2")))
+static inline __m256i xnor_popcount_avx2(__m256i v)
+{
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static void xnor_kernel_avx2(int words, const uint64_t *a, const uint64_t *b, const uint64_t *m, int ldn, int *c)
+{
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    int w;
+    for(w = 0; w < words; ++w){
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + (size_t)w*ldn));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + (size_t)w*ldn + 4));
+        __m256i m0 = _mm256_loadu_si256((const __m256i *)(m + (size_t)w*ldn));
+        __m256i m1 = _mm256_loadu_si256((const __m256i *)(m + (size_t)w*ldn + 4));
+        __m256i av;
+#define XNOR_ROW_AVX(row, v0, v1) \
+        av = _mm256_set1_epi64x((long long)a[w*XNOR_MR + row]); \
+        v0 = _mm256_add_epi64(v0, xnor_popcount_avx2(_mm256_and_si256(_mm256_xor_si256(av, b0), m0))); \
+        v1 = _mm256_add_epi64(v1, xnor_popcount_avx2(_mm256_and_si256(_mm256_xor_si256(av, b1), m1)));
+        XNOR_ROW_AVX(0, c00, c01)
+        XNOR_ROW_AVX(1, c10, c11)
+        XNOR_ROW_AVX(2, c20, c21)
+        XNOR_ROW_AVX(3, c30, c31)
+#undef XNOR_ROW_AVX
+    }
+    /* the counts fit the low 32 bits of each lane, gather them into 8 ints per row */
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+#define XNOR_STORE_AVX(row, v0, v1) \
+    _mm256_storeu_si256((__m256i *)(c + row*XNOR_NR), _mm256_permute2x128_si256( \
+            _mm256_permutevar8x32_epi32(v0, even), _mm256_permutevar8x32_epi32(v1, even), 0x20));
+    XNOR_STORE_AVX(0, c00, c01)
+    XNOR_STORE_AVX(1, c10, c11)
+    XNOR_STORE_AVX(2, c20, c21)
+    XNOR_STORE_AVX(3, c30, c31)
+#undef XNOR_STORE_AVX
+}
+#endif
+
+static int xnor_avx2_supported()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+static xnor_kernel get_xnor_kernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(xnor_avx2_supported()) return xnor_kernel_avx2;
+#endif
+    return xnor_kernel_scalar;
+}
+
+static xnor_pack get_xnor_pack()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(xnor_avx2_supported()) return xnor_pack_avx2;
+#endif
+    return xnor_pack_scalar;
+}
+
+const char *xnor_kernel_name()
+{
+    return xnor_avx2_supported() ? "avx2" : "scalar";
+}
+
+/* sign and mask bits of the taps of every grid pixel, word w of pixel q at w*ldq + q */
+static void xnor_pack_input(layer l, const float *in, float *padded, int *inside, int *offsets, int ldq, uint64_t *bits, uint64_t *mask)
+{
+    int pw = l.w + 2*l.pad;
+    int gw = round_up(l.out_w, XNOR_NR);
+    int k = l.c*l.size*l.size;
+    size_t plane = xnor_padded_size(l);
+    int *inside_offsets = offsets + k;
+    xnor_pack pack = get_xnor_pack();
+    int j, y, x, w;
+
+    memset(padded, 0, l.c*plane*sizeof(float));
+    memset(inside, 0, plane*sizeof(int));
+    for(j = 0; j < l.c; ++j){
+        for(y = 0; y < l.h; ++y){
+            memcpy(padded + j*plane + (size_t)(y + l.pad)*pw + l.pad, in + ((size_t)j*l.h + y)*l.w, l.w*sizeof(float));
+        }
+    }
+    for(y = 0; y < l.h; ++y){
+        memset(inside + (size_t)(y + l.pad)*pw + l.pad, 0xff, l.w*sizeof(int));
+    }
+    for(j = 0; j < k; ++j){
+        int ky = j/l.size%l.size;
+        int kx = j%l.size;
+        inside_offsets[j] = ky*pw + kx;
+        offsets[j] = j/(l.size*l.size)*plane + inside_offsets[j];
+    }
+
+    for(w = 0; w*64 < k; ++w){
+        int taps = k - w*64 < 64 ? k - w*64 : 64;
+        for(y = 0; y < l.out_h; ++y){
+            for(x = 0; x < gw; x += XNOR_PACK){
+                size_t base = (size_t)y*l.stride*pw + x*l.stride;
+                size_t q = (size_t)w*ldq + y*gw + x;
+                pack(padded + base, inside + base, offsets + w*64, inside_offsets + w*64, taps, l.stride, bits + q, mask + q);
+            }
+        }
+    }
+}
+
+/* taps of the window of each output row or column that land inside the image */
+static int xnor_inside_taps(int o, int stride, int pad, int size, int length)
+{
+    int first = o*stride - pad;
+    int begin = first < 0 ? 0 : first;
+    int end = first + size > length ? length : first + size;
+    return end > begin ? end - begin : 0;
+}
+
+typedef struct{
+    layer l;
+    xnor_kernel kernel;
+    const uint64_t *bits;
+    const uint64_t *mask;
+    const int *valid;
+    float *output;
+    int ldq;
+    int words;
+    int activate;
+} xnor_args;
+
+static void xnor_filter_blocks(void *ptr, int begin, int end)
+{
+    xnor_args *a = ptr;
+    layer l = a->l;
+    int n = l.out_h*l.out_w;
+    int gw = round_up(l.out_w, XNOR_NR);
+    int b;
+    for(b = begin; b < end; ++b){
+        int filters = l.n - b*XNOR_MR < XNOR_MR ? l.n - b*XNOR_MR : XNOR_MR;
+        const uint64_t *weights = l.xnor_weights + (size_t)b*a->words*XNOR_MR;
+        int p, r, c;
+        for(p = 0; p < a->ldq; p += XNOR_NR){
+            int tile[XNOR_MR*XNOR_NR];
+            int y = p/gw;
+            int x = p%gw;
+            int width = l.out_w - x < XNOR_NR ? l.out_w - x : XNOR_NR;
+            const int *valid = a->valid + p;
+            a->kernel(a->words, weights, a->bits + p, a->mask + p, a->ldq, tile);
+            for(r = 0; r < filters; ++r){
+                int f = b*XNOR_MR + r;
+                float *dst = a->output + (size_t)f*n + y*l.out_w + x;
+                for(c = 0; c < width; ++c){
+                    dst[c] = (valid[c] - 2*tile[r*XNOR_NR + c])*l.xnor_scales[f];
+                }
+            }
+        }
+        for(r = 0; a->activate && r < filters; ++r){
+            int f = b*XNOR_MR + r;
+            bias_activate_array(a->output + (size_t)f*n, n, l.biases[f], l.activation);
+        }
+    }
+}
+
+void forward_xnor_convolution(layer l, float *in, float *output, float *workspace, int activate)
+{
+    int k = l.c*l.size*l.size;
+    int words = xnor_words(l);
+    int gw = round_up(l.out_w, XNOR_NR);
+    int ldq = xnor_grid_size(l);
+    size_t plane = xnor_padded_size(l);
+    float *padded = workspace;
+    int *inside = (int *)(padded + l.c*plane);
+    int *offsets = inside + plane;
+    uint64_t *bits = (uint64_t *)(offsets + 2*k);
+    uint64_t *mask = bits + (size_t)words*ldq;
+    int *valid = (int *)(mask + (size_t)words*ldq);
+    int y, x;
+
+    xnor_pack_input(l, in, padded, inside, offsets, ldq, bits, mask);
+    for(y = 0; y < l.out_h; ++y){
+        int rows = xnor_inside_taps(y, l.stride, l.pad, l.size, l.h);
+        for(x = 0; x < gw; ++x){
+            valid[y*gw + x] = l.c*rows*xnor_inside_taps(x, l.stride, l.pad, l.size, l.w);
+        }
+    }
+
+    int blocks = round_up(l.n, XNOR_MR)/XNOR_MR;
+    xnor_args args = {l, get_xnor_kernel(), bits, mask, valid, output, ldq, words, activate};
+    /* a word of xor and popcount costs about as much as a few float multiply-adds */
+    parallel_for(blocks, (double)l.n*ldq*words*4, xnor_filter_blocks, &args);
+}
+
+void pack_xnor_weights(layer *l)
+{
+    int k = l->c*l->size*l->size;
+    int words = xnor_words(*l);
+    int f, j;
+    free(l->xnor_weights);
+    free(l->xnor_scales);
+    l->xnor_weights = 0;
+    l->xnor_scales = 0;
+    if(!xnor_binarizable(*l)) return;
+
+    /* XNOR_MR filters interleaved per word, as the kernel reads them */
+    l->xnor_weights = calloc((size_t)round_up(l->n, XNOR_MR)*words, sizeof(uint64_t));
+    l->xnor_scales = calloc(l->n, sizeof(float));
+    for(f = 0; f < l->n; ++f){
+        float *w = l->weights + (size_t)f*k;
+        uint64_t *dst = l->xnor_weights + (size_t)(f/XNOR_MR)*words*XNOR_MR + f%XNOR_MR;
+        float mean = 0;
+        for(j = 0; j < k; ++j){
+            mean += fabsf(w[j]);
+            if(w[j] > 0) dst[(j/64)*XNOR_MR] |= (uint64_t)1 << (j%64);
+        }
+        l->xnor_scales[f] = mean/k;
+    }
+}
+
+void binarize_xnor_network(network *net)
+{
+    size_t workspace_size = 0;
+    size_t needed = 0;
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->workspace_size > workspace_size) workspace_size = l->workspace_size;
+        pack_xnor_weights(l);
+        if(!l->xnor_weights) continue;
+        if(xnor_workspace_size(*l) > l->workspace_size) l->workspace_size = xnor_workspace_size(*l);
+        if(l->workspace_size > needed) needed = l->workspace_size;
+    }
+    if(needed > workspace_size){
+        free(net->workspace);
+        net->workspace = calloc(1, needed);
+    }
+}
+
+void unbinarize_xnor_network(network *net)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        free(l->xnor_weights);
+        free(l->xnor_scales);
+        l->xnor_weights = 0;
+        l->xnor_scales = 0;
+    }
+}
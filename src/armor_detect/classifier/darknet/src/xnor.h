@@ -0,0 +1,10 @@
+#ifndef XNOR_H
+#define XNOR_H
+
+#include "darknet.h"
+
+size_t xnor_workspace_size(layer l);
+void pack_xnor_weights(layer *l);
+void forward_xnor_convolution(layer l, float *in, float *out, float *workspace, int activate);
+
+#endif
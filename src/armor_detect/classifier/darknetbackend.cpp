@@ -0,0 +1,137 @@
+#include "darknetbackend.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef CLASSIFIER_GENERATED
+#include "generatednetwork.h"
+#endif // CLASSIFIER_GENERATED
+
+using namespace std;
+
+DarknetBackend::DarknetBackend(const string &cfg_file, const string &weight_file) : capacity(0),
+                                                                                    current_batch(0),
+                                                                                    use_generated(false) {
+    // darknet 的接口不带 const, 文件名复制一份再传入
+    vector<char> cfg(cfg_file.begin(), cfg_file.end());
+    vector<char> path(weight_file.begin(), weight_file.end());
+    cfg.push_back('\0');
+    path.push_back('\0');
+    // 只做推理: 加载时把批归一化折叠进卷积权重, 偏置和激活函数在卷积输出时一并完成.
+    // 权重文件是 darknet pack convert 生成的打包文件时直接映射, 其中已含配置和打包好的权重, 不再读取配置文件
+    network *loaded = is_packed_network(path.data()) ? load_packed_network(path.data())
+                                                     : load_inference_network(cfg.data(), path.data());
+    weights.reset(loaded, free_network);
+    // 首个后端直接在加载的网络上推理, 共用权重的后端各自创建上下文
+    net = loaded;
+    // 网络各层按配置文件中的批大小分配内存, 推理时的批大小不能超过它
+    max_batch = net->batch;
+    srand(2222222);
+}
+
+DarknetBackend::DarknetBackend(const DarknetBackend *shared) : weights(shared->weights),
+                                                               net(make_network_context(shared->weights.get(), 1)),
+                                                               max_batch(shared->max_batch),
+                                                               capacity(0),
+                                                               current_batch(0),
+                                                               use_generated(false) {
+    useGenerated(shared->use_generated);
+}
+
+DarknetBackend::~DarknetBackend() {
+    // 加载的网络由 weights 在最后一个共用它的后端析构时释放
+    if (net != weights.get()) {
+        free_network(net);
+    }
+}
+
+const char *DarknetBackend::name() const {
+    return "darknet";
+}
+
+int DarknetBackend::inputs() const {
+    return net->inputs;
+}
+
+int DarknetBackend::outputs() const {
+    return net->outputs;
+}
+
+unique_ptr<ClassifierBackend> DarknetBackend::share() const {
+    return unique_ptr<ClassifierBackend>(new DarknetBackend(this));
+}
+
+int DarknetBackend::reserve(int batch) {
+    batch = max(1, min(batch, max_batch));
+    if (batch != capacity) {
+        capacity = batch;
+        // 上下文的激活缓冲区按容量分配, 不必按加载时的最大批大小
+        if (net != weights.get() && batch != net->batch) {
+            free_network(net);
+            net = make_network_context(weights.get(), batch);
+            current_batch = batch;
+        }
+        resizeGenerated();
+    }
+    return capacity;
+}
+
+const float *DarknetBackend::forward(const float *input, int batch) {
+#ifdef CLASSIFIER_GENERATED
+    if (use_generated) {
+        // 生成的网络逐张推理, 各层没有需要分摊的固定开销
+        for (int i = 0; i < batch; ++i) {
+            GENERATED_NETWORK.forward(input + i * net->inputs, generated_output.data() + i * net->outputs,
+                                      generated_workspace.data());
+        }
+        return generated_output.data();
+    }
+#endif // CLASSIFIER_GENERATED
+    // 一次前向推理处理所有图像, 各层的固定开销由这些图像分摊
+    if (batch != current_batch) {
+        set_batch_network(net, batch);
+        current_batch = batch;
+    }
+    float *predictions = network_predict(net, const_cast<float *>(input));
+    if (net->hierarchy) {
+        for (int i = 0; i < batch; ++i) {
+            hierarchy_predictions(predictions + i * net->outputs, net->outputs, net->hierarchy, 1, 1);
+        }
+    }
+    return predictions;
+}
+
+bool DarknetBackend::quantize(const string &ranges_file) {
+    // 量化会替换各层的权重数组, 其它后端的上下文还指向旧数组
+    CV_Assert(weights.use_count() == 1 && net == weights.get());
+    // darknet 打不开文件时会直接退出, 先在这里检查
+    if (ranges_file.empty() || !ifstream(ranges_file).good()) {
+        dequantize_int8_network(net);
+        return false;
+    }
+    load_int8_ranges(net, const_cast<char *>(ranges_file.c_str()));
+    quantize_int8_network(net);
+    return true;
+}
+
+bool DarknetBackend::useGenerated(bool enable) {
+    use_generated = false;
+#ifdef CLASSIFIER_GENERATED
+    // 生成的网络须与加载的网络输入输出一致, 否则说明生成后配置文件或权重已经换过
+    if (enable && GENERATED_NETWORK.w * GENERATED_NETWORK.h * GENERATED_NETWORK.c == net->inputs &&
+        GENERATED_NETWORK.outputs == net->outputs && !net->hierarchy) {
+        generated_workspace.resize(GENERATED_NETWORK.workspace);
+        use_generated = true;
+        resizeGenerated();
+    }
+#endif // CLASSIFIER_GENERATED
+    return use_generated;
+}
+
+void DarknetBackend::resizeGenerated() {
+    if (use_generated) {
+        generated_output.resize(capacity * net->outputs);
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * @file darknetbackend.h
+ * @brief darknet 网络推理后端
+ * @details 用 darknet 加载并推理任意分类网络, 支持打包的权重文件、INT8 量化和 darknet codegen 预先生成的网络.
+ * 共用权重的后端各自持有一个网络上下文
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef DARKNETBACKEND_H
+#define DARKNETBACKEND_H
+
+#include <darknet.h>
+
+#include "classifierbackend.h"
+
+class DarknetBackend : public ClassifierBackend {
+private:
+    /// 权重, 由共用它的后端一起持有, 推理时只读
+    std::shared_ptr<network> weights;
+
+    /// 本后端推理用的网络, 首个后端就是加载的网络, 共用权重的后端是各自的上下文
+    network *net;
+
+    /// 网络加载时分配的最大批大小
+    int max_batch;
+
+    /// 一次推理最多处理的图像数
+    int capacity;
+
+    /// 网络当前的批大小, 与本次推理的图像数不同时才重新设置
+    int current_batch;
+
+    /// 是否使用预先生成的网络推理
+    bool use_generated;
+
+    /// 生成的网络的工作区和各图像的输出
+    std::vector<float> generated_workspace;
+    std::vector<float> generated_output;
+
+public:
+    /**
+     * @brief 加载网络. 权重文件是 darknet pack convert 生成的打包文件时直接映射,
+     * 不再逐层读取和打包权重
+     *
+     * @param cfg_file 配置文件, 权重文件是打包文件时不使用, 以打包文件中保存的配置为准
+     * @param weight_file 权重文件或打包文件
+     */
+    DarknetBackend(const std::string &cfg_file, const std::string &weight_file);
+
+    ~DarknetBackend() override;
+
+    DarknetBackend(const DarknetBackend &) = delete;
+
+    DarknetBackend &operator=(const DarknetBackend &) = delete;
+
+    const char *name() const override;
+
+    int inputs() const override;
+
+    int outputs() const override;
+
+    std::unique_ptr<ClassifierBackend> share() const override;
+
+    int reserve(int batch) override;
+
+    const float *forward(const float *input, int batch) override;
+
+    /**
+     * @brief 按标定好的各层输入范围把卷积层量化为 INT8 推理.
+     * 会改写权重, 只能在创建共用权重的后端之前, 由加载权重的后端调用
+     */
+    bool quantize(const std::string &ranges_file) override;
+
+    /**
+     * @brief 切换到由 darknet codegen 预先生成的网络推理, 与 darknet 解释执行的结果一致.
+     * 需以 CLASSIFIER_CODEGEN 编译进生成的源文件, 且它与加载的网络输入输出一致;
+     * 生成的网络按 FP32 推理, 不受 quantize() 影响
+     */
+    bool useGenerated(bool enable) override;
+
+private:
+    /// 与 shared 共用权重, 创建自己的网络上下文
+    explicit DarknetBackend(const DarknetBackend *shared);
+
+    /// 按当前容量分配生成的网络的输出
+    void resizeGenerated();
+};
+
+#endif //DARKNETBACKEND_H
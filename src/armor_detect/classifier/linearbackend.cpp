@@ -0,0 +1,103 @@
+#include "linearbackend.h"
+
+#include <algorithm>
+
+using namespace std;
+using netkernels::Vec;
+using netkernels::VEC_WIDTH;
+using netkernels::loadVec;
+using netkernels::storeVec;
+
+/// 同时计算的类别数, 每次读入的一段输入由这些类别共用
+static const int ROWS = 4;
+
+/// 向量各分量之和
+static inline float sumVec(Vec v) {
+    float lanes[VEC_WIDTH];
+    storeVec(lanes, v);
+    float sum = 0;
+    for (int i = 0; i < VEC_WIDTH; ++i) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief R 个类别的得分
+ *
+ * @param w 首个类别的权重, 各类别相隔 n 个
+ * @param x 输入
+ * @param n 输入长度
+ * @param out 各类别的得分
+ */
+template <int R>
+static void dot(const float *w, const float *x, int n, float *out) {
+    int body = n / VEC_WIDTH * VEC_WIDTH;
+    Vec acc[R];
+    for (int r = 0; r < R; ++r) {
+        acc[r] = Vec{};
+    }
+    for (int i = 0; i < body; i += VEC_WIDTH) {
+        Vec v = loadVec(x + i);
+        for (int r = 0; r < R; ++r) {
+            acc[r] += loadVec(w + r * n + i) * v;
+        }
+    }
+    for (int r = 0; r < R; ++r) {
+        float sum = sumVec(acc[r]);
+        for (int i = body; i < n; ++i) {
+            sum += w[r * n + i] * x[i];
+        }
+        out[r] = sum;
+    }
+}
+
+LinearBackend::LinearBackend(const DenseLayer &layer, float temperature) : model(new Model{layer, temperature}),
+                                                                           capacity(0) {}
+
+LinearBackend::LinearBackend(shared_ptr<const Model> model) : model(move(model)),
+                                                              capacity(0) {}
+
+const char *LinearBackend::name() const {
+    return "linear";
+}
+
+int LinearBackend::inputs() const {
+    return model->layer.inputs;
+}
+
+int LinearBackend::outputs() const {
+    return model->layer.outputs;
+}
+
+unique_ptr<ClassifierBackend> LinearBackend::share() const {
+    return unique_ptr<ClassifierBackend>(new LinearBackend(model));
+}
+
+int LinearBackend::reserve(int batch) {
+    capacity = max(1, batch);
+    output.resize(capacity * model->layer.outputs);
+    return capacity;
+}
+
+const float *LinearBackend::forward(const float *input, int batch) {
+    const DenseLayer &layer = model->layer;
+    for (int b = 0; b < batch; ++b) {
+        const float *x = input + b * layer.inputs;
+        float *y = output.data() + b * layer.outputs;
+        // 每 ROWS 个类别一组, 组内共用读入的输入, 余下的类别逐个计算
+        int o = 0;
+        for (; o + ROWS <= layer.outputs; o += ROWS) {
+            dot<ROWS>(layer.weights.data() + o * layer.inputs, x, layer.inputs, y + o);
+        }
+        for (; o < layer.outputs; ++o) {
+            dot<1>(layer.weights.data() + o * layer.inputs, x, layer.inputs, y + o);
+        }
+        for (o = 0; o < layer.outputs; ++o) {
+            y[o] += layer.biases[o];
+        }
+        activate(layer.activation, y, layer.outputs);
+        softmax(y, layer.outputs, model->temperature);
+    }
+    return output.data();
+}
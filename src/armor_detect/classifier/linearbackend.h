@@ -0,0 +1,58 @@
+/**
+ * @file linearbackend.h
+ * @brief 像素特征线性模型推理后端
+ * @details 以归一化后的全部像素为特征, 每个类别一组权重, 得分经 softmax 得到概率.
+ * 模型是只有一个全连接层的 darknet 网络, 计算量约为输入长度乘类别数, 是最便宜的后端
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef LINEARBACKEND_H
+#define LINEARBACKEND_H
+
+#include "classifierbackend.h"
+
+class LinearBackend : public ClassifierBackend {
+private:
+    /// 共用的模型, 推理时只读
+    struct Model {
+        DenseLayer layer;
+        float temperature;
+    };
+
+    std::shared_ptr<const Model> model;
+
+    /// 一次推理最多处理的图像数
+    int capacity;
+
+    /// 各图像的概率
+    std::vector<float> output;
+
+public:
+    /**
+     * @param layer 全连接层
+     * @param temperature softmax 的温度, 为 0 时直接输出得分
+     */
+    LinearBackend(const DenseLayer &layer, float temperature);
+
+    const char *name() const override;
+
+    int inputs() const override;
+
+    int outputs() const override;
+
+    std::unique_ptr<ClassifierBackend> share() const override;
+
+    int reserve(int batch) override;
+
+    const float *forward(const float *input, int batch) override;
+
+private:
+    explicit LinearBackend(std::shared_ptr<const Model> model);
+};
+
+#endif //LINEARBACKEND_H
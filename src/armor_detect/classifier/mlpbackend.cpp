@@ -0,0 +1,104 @@
+#include "mlpbackend.h"
+
+#include <algorithm>
+
+using namespace std;
+using netkernels::Vec;
+using netkernels::VEC_WIDTH;
+using netkernels::loadVec;
+using netkernels::storeVec;
+
+/// 隐层占用的向量个数
+static const int LANES = MlpBackend::HIDDEN / VEC_WIDTH;
+
+static_assert(MlpBackend::HIDDEN % VEC_WIDTH == 0, "hidden width must be a multiple of the vector width");
+
+MlpBackend::MlpBackend(const DenseLayer &hidden, const DenseLayer &out, float temperature) : capacity(0) {
+    Model *loaded = new Model;
+    loaded->inputs = hidden.inputs;
+    loaded->outputs = out.outputs;
+    // 隐层权重转置为 [输入][HIDDEN], 同一输入对全部隐层单元的权重连续存放
+    loaded->hidden_weights.resize(hidden.inputs * HIDDEN);
+    for (int h = 0; h < HIDDEN; ++h) {
+        for (int i = 0; i < hidden.inputs; ++i) {
+            loaded->hidden_weights[i * HIDDEN + h] = hidden.weights[h * hidden.inputs + i];
+        }
+    }
+    loaded->hidden_biases = hidden.biases;
+    loaded->hidden_activation = hidden.activation;
+    loaded->output_weights = out.weights;
+    loaded->output_biases = out.biases;
+    loaded->output_activation = out.activation;
+    loaded->temperature = temperature;
+    model.reset(loaded);
+}
+
+MlpBackend::MlpBackend(shared_ptr<const Model> model) : model(move(model)),
+                                                        capacity(0) {}
+
+const char *MlpBackend::name() const {
+    return "mlp";
+}
+
+int MlpBackend::inputs() const {
+    return model->inputs;
+}
+
+int MlpBackend::outputs() const {
+    return model->outputs;
+}
+
+unique_ptr<ClassifierBackend> MlpBackend::share() const {
+    return unique_ptr<ClassifierBackend>(new MlpBackend(model));
+}
+
+int MlpBackend::reserve(int batch) {
+    capacity = max(1, batch);
+    output.resize(capacity * model->outputs);
+    return capacity;
+}
+
+const float *MlpBackend::forward(const float *input, int batch) {
+    const Model &m = *model;
+    for (int b = 0; b < batch; ++b) {
+        const float *x = input + b * m.inputs;
+        float *y = output.data() + b * m.outputs;
+
+        // 隐层: 累加器从偏置开始, 每个输入广播后乘以它对全部隐层单元的权重
+        Vec acc[LANES];
+        for (int l = 0; l < LANES; ++l) {
+            acc[l] = loadVec(m.hidden_biases.data() + l * VEC_WIDTH);
+        }
+        const float *w = m.hidden_weights.data();
+        for (int i = 0; i < m.inputs; ++i, w += HIDDEN) {
+            float v = x[i];
+            for (int l = 0; l < LANES; ++l) {
+                acc[l] += v * loadVec(w + l * VEC_WIDTH);
+            }
+        }
+        float hidden[HIDDEN];
+        for (int l = 0; l < LANES; ++l) {
+            storeVec(hidden + l * VEC_WIDTH, acc[l]);
+        }
+        activate(m.hidden_activation, hidden, HIDDEN);
+
+        // 输出层: 每个类别与隐层做一次 HIDDEN 长的点积
+        for (int o = 0; o < m.outputs; ++o) {
+            const float *wo = m.output_weights.data() + o * HIDDEN;
+            Vec sum = Vec{};
+            for (int l = 0; l < LANES; ++l) {
+                sum += loadVec(wo + l * VEC_WIDTH) * loadVec(hidden + l * VEC_WIDTH);
+            }
+            float lanes[VEC_WIDTH];
+            storeVec(lanes, sum);
+            float score = m.output_biases[o];
+            for (int l = 0; l < VEC_WIDTH; ++l) {
+                score += lanes[l];
+            }
+            y[o] = score;
+        }
+        activate(m.output_activation, y, m.outputs);
+        softmax(y, m.outputs, m.temperature);
+    }
+    return output.data();
+}
@@ -0,0 +1,76 @@
+/**
+ * @file mlpbackend.h
+ * @brief 小型 MLP 推理后端
+ * @details 一个宽度固定为 HIDDEN 的隐层加一个输出层. 隐层宽度在编译期确定, 隐层权重按 [输入][HIDDEN] 重排,
+ * 每读一个输入就更新全部隐层单元, 累加器始终留在向量寄存器中, 不需要逐个单元做水平求和.
+ * 模型是两个全连接层组成的 darknet 网络, 首层输出个数须为 HIDDEN
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef MLPBACKEND_H
+#define MLPBACKEND_H
+
+#include "classifierbackend.h"
+
+class MlpBackend : public ClassifierBackend {
+public:
+    /// 隐层宽度
+    constexpr static int HIDDEN = 32;
+
+private:
+    /// 共用的模型, 推理时只读
+    struct Model {
+        int inputs;
+        int outputs;
+
+        /// 隐层权重, 按 [输入][HIDDEN] 排列
+        std::vector<float> hidden_weights;
+        std::vector<float> hidden_biases;
+        netkernels::Activation hidden_activation;
+
+        /// 输出层权重, 按 [输出][HIDDEN] 排列
+        std::vector<float> output_weights;
+        std::vector<float> output_biases;
+        netkernels::Activation output_activation;
+
+        float temperature;
+    };
+
+    std::shared_ptr<const Model> model;
+
+    /// 一次推理最多处理的图像数
+    int capacity;
+
+    /// 各图像的概率
+    std::vector<float> output;
+
+public:
+    /**
+     * @param hidden 隐层, 输出个数为 HIDDEN
+     * @param out 输出层
+     * @param temperature softmax 的温度, 为 0 时直接输出得分
+     */
+    MlpBackend(const DenseLayer &hidden, const DenseLayer &out, float temperature);
+
+    const char *name() const override;
+
+    int inputs() const override;
+
+    int outputs() const override;
+
+    std::unique_ptr<ClassifierBackend> share() const override;
+
+    int reserve(int batch) override;
+
+    const float *forward(const float *input, int batch) override;
+
+private:
+    explicit MlpBackend(std::shared_ptr<const Model> model);
+};
+
+#endif //MLPBACKEND_H
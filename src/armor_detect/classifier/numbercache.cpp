@@ -0,0 +1,207 @@
+#include "numbercache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+constexpr float NumberCache::MAX_CENTER_SHIFT;
+constexpr float NumberCache::MAX_WIDTH_RATIO;
+constexpr size_t NumberCache::MAX_TRACKS;
+constexpr int NumberCache::UNKNOWN;
+
+void NumberCache::init(int max_reuse, int max_hash_distance, bool keep_tracks) {
+    this->max_reuse = max(0, max_reuse);
+    this->max_hash_distance = max(0, min(max_hash_distance, 64));
+    this->keep_tracks = keep_tracks;
+    tracks.clear();
+    tracks.reserve(MAX_TRACKS);
+}
+
+void NumberCache::beginFrame() {
+    ++frame;
+    // 只有上一帧出现过的轨迹才能延续, 中间丢过一帧的目标重新分类
+    size_t kept = 0;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        if (tracks[i].last_frame + 1 == frame) {
+            tracks[kept++] = tracks[i];
+        }
+    }
+    tracks.resize(kept);
+}
+
+int NumberCache::match(const RotatedRect &rect) const {
+    float width = max(rect.size.width, rect.size.height);
+    int best = -1;
+    float best_distance = 0;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        const Track &track = tracks[i];
+        // 本帧已被其它装甲板占用的轨迹不再匹配
+        if (track.last_frame == frame) {
+            continue;
+        }
+        float ratio = width / track.width;
+        if (ratio > MAX_WIDTH_RATIO || ratio * MAX_WIDTH_RATIO < 1) {
+            continue;
+        }
+        float dx = rect.center.x - track.center.x;
+        float dy = rect.center.y - track.center.y;
+        float distance = sqrt(dx * dx + dy * dy);
+        if (distance > MAX_CENTER_SHIFT * track.width) {
+            continue;
+        }
+        if (best < 0 || distance < best_distance) {
+            best = static_cast<int>(i);
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+bool NumberCache::lookup(const RotatedRect &rect, uint64_t hash, Classifier::Prediction &prediction) {
+    int index = enabled() ? match(rect) : -1;
+    if (index < 0 || (!tracks[index].pending && (tracks[index].reused >= max_reuse ||
+        __builtin_popcountll(hash ^ tracks[index].hash) > max_hash_distance))) {
+        misses.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    // 沿用时跟随装甲板移动, 哈希仍与分类时的图像比较, 避免逐帧漂移
+    Track &track = tracks[index];
+    track.center = rect.center;
+    track.width = max(rect.size.width, rect.size.height);
+    track.last_frame = frame;
+    if (!track.pending) {
+        ++track.reused;
+    }
+    prediction = track.prediction;
+    hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+bool NumberCache::recall(const RotatedRect &rect, Classifier::Prediction &prediction) const {
+    int index = enabled() ? match(rect) : -1;
+    if (index < 0) {
+        return false;
+    }
+    prediction = tracks[index].prediction;
+    return true;
+}
+
+void NumberCache::follow(const RotatedRect &rect) {
+    int index = enabled() ? match(rect) : -1;
+    if (index < 0) {
+        return;
+    }
+    Track &track = tracks[index];
+    track.center = rect.center;
+    track.width = max(rect.size.width, rect.size.height);
+    track.last_frame = frame;
+}
+
+uint64_t NumberCache::store(const RotatedRect &rect, uint64_t hash, const Classifier::Prediction &prediction,
+                            bool pending) {
+    if (!enabled()) {
+        return 0;
+    }
+    int index = match(rect);
+    if (index < 0) {
+        if (tracks.size() >= MAX_TRACKS) {
+            return 0;
+        }
+        index = static_cast<int>(tracks.size());
+        tracks.emplace_back();
+        tracks[index].id = next_id++;
+    }
+    Track &track = tracks[index];
+    track.center = rect.center;
+    track.width = max(rect.size.width, rect.size.height);
+    track.hash = hash;
+    track.prediction = prediction;
+    track.pending = pending;
+    track.reused = 0;
+    track.last_frame = frame;
+    return track.id;
+}
+
+void NumberCache::confirm(uint64_t id, const Classifier::Prediction &prediction) {
+    for (Track &track : tracks) {
+        if (track.id == id) {
+            track.prediction = prediction;
+            track.pending = false;
+            return;
+        }
+    }
+}
+
+bool NumberCache::enabled() const {
+    return max_reuse > 0 || keep_tracks;
+}
+
+uint64_t NumberCache::getHits() const {
+    return hits.load(memory_order_relaxed);
+}
+
+uint64_t NumberCache::getMisses() const {
+    return misses.load(memory_order_relaxed);
+}
+
+/**
+ * @brief 源图像第 i 个像素按面积落在缩小后的哪些格子里. 缩小时一个像素最多跨两个格子
+ *
+ * @param i 像素下标
+ * @param scale 缩小后与缩小前的尺寸之比, 不大于 1
+ * @param cells 缩小后的格子数
+ * @param cell 第一个格子
+ * @param first 落在第一个格子中的面积, 其余落在下一个格子中
+ */
+static void areaSpan(int i, float scale, int cells, int &cell, float &first) {
+    float begin = i * scale;
+    float end = begin + scale;
+    cell = min(static_cast<int>(begin), cells - 1);
+    first = min(end, cell + 1.f) - begin;
+}
+
+uint64_t NumberCache::hash(const Mat &number_image) {
+    // 灰度化和按面积缩小到 9x8 一并在栈上的累加器中完成, 每帧每个候选者都不分配内存
+    constexpr int W = 9;
+    constexpr int H = 8;
+    CV_Assert(number_image.depth() == CV_8U && number_image.cols >= W && number_image.rows >= H);
+    int channels = number_image.channels();
+    float scale_x = static_cast<float>(W) / number_image.cols;
+    float scale_y = static_cast<float>(H) / number_image.rows;
+    float cells[H + 1][W + 1] = {};
+    for (int y = 0; y < number_image.rows; ++y) {
+        const uchar *row = number_image.ptr<uchar>(y);
+        int cy;
+        float wy;
+        areaSpan(y, scale_y, H, cy, wy);
+        for (int x = 0; x < number_image.cols; ++x) {
+            const uchar *p = row + x * channels;
+            // 与 cvtColor(COLOR_BGR2GRAY) 相同的权重
+            float gray = channels >= 3 ? static_cast<int>(.114f * p[0] + .587f * p[1] + .299f * p[2] + .5f) : p[0];
+            int cx;
+            float wx;
+            areaSpan(x, scale_x, W, cx, wx);
+            // 跨到第 W 列或第 H 行的部分落在累加器的多余行列里, 不参与比较
+            cells[cy][cx] += gray * wy * wx;
+            cells[cy][cx + 1] += gray * wy * (scale_x - wx);
+            cells[cy + 1][cx] += gray * (scale_y - wy) * wx;
+            cells[cy + 1][cx + 1] += gray * (scale_y - wy) * (scale_x - wx);
+        }
+    }
+    // 每格的面积之和为 1, 累加结果即平均灰度, 与 resize 一样取整后再比较, 避免相同灰度因舍入误差而比较出大小
+    uchar small[H][W];
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            small[y][x] = saturate_cast<uchar>(cells[y][x]);
+        }
+    }
+    uint64_t bits = 0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W - 1; ++x) {
+            bits = bits << 1 | (small[y][x] < small[y][x + 1]);
+        }
+    }
+    return bits;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file numbercache.h
+ * @brief 数字识别结果缓存
+ * @details ROI 跟踪锁定同一块装甲板时, 它的数字在相邻帧之间不会变化. 按轨迹缓存上次的分类结果:
+ * 候选装甲板与上一帧某条轨迹的中心和尺寸相近, 且数字图像的感知哈希与分类时相差不大时,
+ * 直接沿用上次的类别和置信度, 连续沿用若干帧后重新分类一次. 异步分类时轨迹还记录已送出、
+ * 尚未返回结果的分类请求, 结果返回前沿用轨迹上次确认的类别
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef NUMBERCACHE_H
+#define NUMBERCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "classifier.h"
+
+/**
+ * @brief 数字识别结果缓存类
+ * 每帧先调用 beginFrame(), 再对每个候选装甲板调用 lookup(), 未命中的分类后调用 store()
+ * @note 只应由检测线程使用, 命中计数可以在其它线程读取
+ */
+class NumberCache {
+private:
+    /// 一条轨迹
+    struct Track {
+        /// 轨迹编号, 用于合并异步返回的分类结果
+        uint64_t id;
+
+        /// 装甲板在整幅图像中的中心
+        cv::Point2f center;
+
+        /// 装甲板宽度, 即长边
+        float width;
+
+        /// 分类时数字图像的感知哈希
+        uint64_t hash;
+
+        /// 分类结果, 等待异步结果时为上次确认的结果, 新目标的类别为 UNKNOWN
+        Classifier::Prediction prediction;
+
+        /// 是否在等待异步分类结果
+        bool pending;
+
+        /// 分类后已沿用的帧数
+        int reused;
+
+        /// 最近一次出现的帧号
+        uint64_t last_frame;
+    };
+
+    /// 中心偏移不超过装甲板宽度的这一比例才视为同一轨迹
+    constexpr static float MAX_CENTER_SHIFT = 0.5f;
+
+    /// 两帧装甲板宽度之比的上限
+    constexpr static float MAX_WIDTH_RATIO = 1.3f;
+
+    /// 最多同时保留的轨迹数
+    constexpr static size_t MAX_TRACKS = 16;
+
+    /// 同一轨迹最多连续沿用的帧数, 0 表示不使用缓存
+    int max_reuse = 0;
+
+    /// 感知哈希的汉明距离上限, 超过时认为数字图像已变化
+    int max_hash_distance = 0;
+
+    /// 不沿用结果时是否仍维护轨迹
+    bool keep_tracks = false;
+
+    /// 下一条轨迹的编号
+    uint64_t next_id = 1;
+
+    /// 当前帧号
+    uint64_t frame = 0;
+
+    std::vector<Track> tracks;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+    /**
+     * @brief 找出与装甲板属于同一轨迹的、上一帧出现过的轨迹
+     *
+     * @return 轨迹下标, 没有时为 -1
+     */
+    int match(const cv::RotatedRect &rect) const;
+
+public:
+    /// 尚未确认的类别
+    constexpr static int UNKNOWN = -1;
+
+    /**
+     * @brief 设置缓存参数并清空缓存
+     *
+     * @param max_reuse 同一轨迹最多连续沿用的帧数, 0 表示不沿用
+     * @param max_hash_distance 感知哈希的汉明距离上限, 取值 0~64
+     * @param keep_tracks 不沿用结果时是否仍维护轨迹, 异步分类需要轨迹合并结果
+     */
+    void init(int max_reuse, int max_hash_distance, bool keep_tracks = false);
+
+    /**
+     * @brief 开始新的一帧, 上一帧没有出现的轨迹视为已经中断, 予以丢弃
+     */
+    void beginFrame();
+
+    /**
+     * @brief 查找装甲板所在轨迹的分类结果. 轨迹在等待异步结果时总是命中, 不再重复送出
+     *
+     * @param rect 装甲板在整幅图像中的旋转矩形
+     * @param hash 数字图像的感知哈希
+     * @param prediction 命中时存放沿用的分类结果, 类别可能为 UNKNOWN
+     * @return 是否命中
+     */
+    bool lookup(const cv::RotatedRect &rect, uint64_t hash, Classifier::Prediction &prediction);
+
+    /**
+     * @brief 取未命中的装甲板所在轨迹上次确认的分类结果, 不计入命中次数
+     *
+     * @param rect 装甲板在整幅图像中的旋转矩形
+     * @param prediction 存放上次的分类结果
+     * @return 是否有这样的轨迹
+     */
+    bool recall(const cv::RotatedRect &rect, Classifier::Prediction &prediction) const;
+
+    /**
+     * @brief 未命中的装甲板暂时不分类时, 让它所在的轨迹跟随装甲板移动, 分类结果不变
+     *
+     * @param rect 装甲板在整幅图像中的旋转矩形
+     */
+    void follow(const cv::RotatedRect &rect);
+
+    /**
+     * @brief 记录未命中的装甲板的分类结果, 开始或延续它的轨迹
+     *
+     * @param rect 装甲板在整幅图像中的旋转矩形
+     * @param hash 数字图像的感知哈希
+     * @param prediction 分类结果, 等待异步结果时为暂用的结果
+     * @param pending 是否已送出异步分类请求, 结果由 confirm() 合并
+     * @return 轨迹编号, 未记录时为 0
+     */
+    uint64_t store(const cv::RotatedRect &rect, uint64_t hash, const Classifier::Prediction &prediction,
+                   bool pending = false);
+
+    /**
+     * @brief 合并异步返回的分类结果, 轨迹已经中断时丢弃
+     *
+     * @param id store() 返回的轨迹编号
+     * @param prediction 分类结果
+     */
+    void confirm(uint64_t id, const Classifier::Prediction &prediction);
+
+    /**
+     * @brief 是否维护轨迹
+     */
+    bool enabled() const;
+
+    /**
+     * @brief 累计命中次数
+     */
+    uint64_t getHits() const;
+
+    /**
+     * @brief 累计未命中次数, 即实际分类的次数
+     */
+    uint64_t getMisses() const;
+
+    /**
+     * @brief 计算数字图像的差值哈希: 灰度图按面积缩小到 9x8, 每个像素与右侧像素比较得到一位. 不分配内存
+     *
+     * @param number_image 数字图像
+     * @return 64 位哈希
+     */
+    static uint64_t hash(const cv::Mat &number_image);
+};
+
+#endif // NUMBERCACHE_H
@@ -0,0 +1,151 @@
+#include "lightbarextractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief 计算 0^2 + 1^2 + ... + k^2
+ */
+static inline int64_t sumOfSquares(int64_t k) {
+    return k * (k + 1) * (2 * k + 1) / 6;
+}
+
+void LightbarExtractor::extract(const cv::Mat &mask, double min_area, std::vector<cv::RotatedRect> &lightbars) {
+    lightbars.clear();
+    if (mask.empty()) {
+        return;
+    }
+    CV_Assert(mask.type() == CV_8UC1);
+    label(mask);
+
+    for (size_t i = 0; i < components.size(); ++i) {
+        const Component &component = components[i];
+        // 被合并的节点和像素数过少的连通域不必再算旋转矩形
+        if (component.parent != static_cast<int>(i) || component.m00 <= min_area) {
+            continue;
+        }
+        cv::RotatedRect rect = toRotatedRect(component);
+        if (rect.size.width * rect.size.height > min_area) {
+            lightbars.emplace_back(rect);
+        }
+    }
+}
+
+void LightbarExtractor::label(const cv::Mat &mask) {
+    previous_runs.clear();
+    components.clear();
+
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar *row = mask.ptr<uchar>(y);
+        current_runs.clear();
+
+        // 找出这一行的所有行程, 全零的 8 字节整块跳过
+        int x = 0;
+        while (x < mask.cols) {
+            if (x + 8 <= mask.cols) {
+                uint64_t block;
+                memcpy(&block, row + x, sizeof(block));
+                if (block == 0) {
+                    x += 8;
+                    continue;
+                }
+            }
+            if (row[x] == 0) {
+                ++x;
+                continue;
+            }
+            int start = x;
+            while (x < mask.cols && row[x] != 0) {
+                ++x;
+            }
+            current_runs.push_back({start, x - 1, -1});
+        }
+
+        // 与上一行中 8 连通的行程合并; 两行的行程都按起点有序, 用双指针扫描
+        size_t first = 0;
+        for (Run &run : current_runs) {
+            while (first < previous_runs.size() && previous_runs[first].end < run.start - 1) {
+                ++first;
+            }
+            int root = -1;
+            for (size_t k = first; k < previous_runs.size() && previous_runs[k].start <= run.end + 1; ++k) {
+                int other = findRoot(previous_runs[k].label);
+                root = root < 0 ? other : merge(root, other);
+            }
+            if (root < 0) {
+                root = static_cast<int>(components.size());
+                components.push_back({root, 0, 0, 0, 0, 0, 0});
+            }
+            run.label = root;
+
+            // 行程的矩由求和公式直接得到
+            int64_t n = run.end - run.start + 1;
+            int64_t sum_x = (static_cast<int64_t>(run.start) + run.end) * n / 2;
+            Component &component = components[root];
+            component.m00 += n;
+            component.m10 += sum_x;
+            component.m01 += n * y;
+            component.m20 += sumOfSquares(run.end) - sumOfSquares(run.start - 1);
+            component.m02 += n * y * y;
+            component.m11 += sum_x * y;
+        }
+        previous_runs.swap(current_runs);
+    }
+}
+
+int LightbarExtractor::findRoot(int label) {
+    int root = label;
+    while (components[root].parent != root) {
+        root = components[root].parent;
+    }
+    while (components[label].parent != root) {
+        int next = components[label].parent;
+        components[label].parent = root;
+        label = next;
+    }
+    return root;
+}
+
+int LightbarExtractor::merge(int a, int b) {
+    if (a == b) {
+        return a;
+    }
+    // 保留编号较小的根节点, 连通域的输出顺序与其在图像中首次出现的顺序一致
+    if (b < a) {
+        std::swap(a, b);
+    }
+    Component &root = components[a];
+    const Component &child = components[b];
+    root.m00 += child.m00;
+    root.m10 += child.m10;
+    root.m01 += child.m01;
+    root.m20 += child.m20;
+    root.m02 += child.m02;
+    root.m11 += child.m11;
+    components[b].parent = a;
+    return a;
+}
+
+cv::RotatedRect LightbarExtractor::toRotatedRect(const Component &component) {
+    double n = static_cast<double>(component.m00);
+    double mean_x = component.m10 / n;
+    double mean_y = component.m01 / n;
+    double cov_xx = component.m20 / n - mean_x * mean_x;
+    double cov_yy = component.m02 / n - mean_y * mean_y;
+    double cov_xy = component.m11 / n - mean_x * mean_y;
+
+    double half_trace = (cov_xx + cov_yy) / 2;
+    double root = std::sqrt((cov_xx - cov_yy) * (cov_xx - cov_yy) / 4 + cov_xy * cov_xy);
+    double length = std::sqrt(12 * (half_trace + root));
+    double width = std::sqrt(12 * std::max(half_trace - root, 0.0));
+
+    // 长轴与 x 轴的夹角, 旋转矩形的角度是宽边与 x 轴的夹角, 与长轴相差 90 度
+    double angle = 0.5 * std::atan2(2 * cov_xy, cov_xx - cov_yy) * 180 / CV_PI - 90;
+    if (angle < -90) {
+        angle += 180;
+    }
+    return cv::RotatedRect(cv::Point2f(static_cast<float>(mean_x), static_cast<float>(mean_y)),
+                           cv::Size2f(static_cast<float>(width), static_cast<float>(length)),
+                           static_cast<float>(angle));
+}
@@ -0,0 +1,100 @@
+/**
+ * @file lightbarextractor.h
+ * @brief 灯条提取
+ * @details 对二值图像做一次逐行扫描的连通域标记, 扫描过程中累加每个连通域的面积和一阶、二阶矩,
+ * 由矩直接得到灯条的中心、长度、宽度和倾斜角, 取代 findContours + minAreaRect.
+ * 整个过程与像素数成线性关系, 不为任何连通域生成轮廓点集
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-11
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef LIGHTBAREXTRACTOR_H
+#define LIGHTBAREXTRACTOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief 灯条提取类
+ * 以行程(一行中连续的非零像素)为单位做 8 连通的并查集标记, 每个行程的矩用求和公式一次算出.
+ * 内部缓冲区在各帧之间复用, 稳态下不分配内存
+ * @note 非线程安全, 每个线程应使用各自的对象
+ */
+class LightbarExtractor {
+private:
+    /// 一行中的一个行程, 区间两端都包含在内
+    struct Run {
+        int start;
+        int end;
+        int label;
+    };
+
+    /// 连通域的矩累加器, 同时作为并查集的节点
+    struct Component {
+        /// 并查集中的父节点
+        int parent;
+
+        /// 面积, 即像素数
+        int64_t m00;
+
+        /// 一阶矩
+        int64_t m10;
+        int64_t m01;
+
+        /// 二阶矩
+        int64_t m20;
+        int64_t m02;
+        int64_t m11;
+    };
+
+    /// 上一行的行程
+    std::vector<Run> previous_runs;
+
+    /// 当前行的行程
+    std::vector<Run> current_runs;
+
+    /// 所有连通域
+    std::vector<Component> components;
+
+public:
+    /**
+     * @brief 从二值图像中提取灯条
+     *
+     * @param mask 二值图像, 类型为 CV_8UC1, 非零像素为前景
+     * @param min_area 灯条旋转矩形面积的下限, 像素数不超过该值的连通域直接丢弃
+     * @param lightbars 存放提取到的灯条, 旋转矩形的 height 不小于 width, 竖直灯条的角度为 0
+     */
+    void extract(const cv::Mat &mask, double min_area, std::vector<cv::RotatedRect> &lightbars);
+
+private:
+    /**
+     * @brief 扫描图像, 完成连通域标记和矩的累加
+     */
+    void label(const cv::Mat &mask);
+
+    /**
+     * @brief 找出并查集的根节点, 同时压缩路径
+     */
+    int findRoot(int label);
+
+    /**
+     * @brief 合并两个连通域, 矩累加到新的根节点上
+     *
+     * @return 合并后的根节点
+     */
+    int merge(int a, int b);
+
+    /**
+     * @brief 由连通域的矩计算旋转矩形
+     * 长、宽取等效矩形的边长 sqrt(12 * 协方差矩阵特征值)
+     */
+    static cv::RotatedRect toRotatedRect(const Component &component);
+};
+
+#endif // LIGHTBAREXTRACTOR_H
@@ -0,0 +1,180 @@
+#include "lightbarmatcher.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// 粗筛阈值的相对放宽量, 吸收单精度计算与原始判断之间的舍入误差, 粗筛只能多放不能错杀
+static const float SLACK = 1e-4f;
+
+void LightbarMatcher::match(const std::vector<cv::RotatedRect> &lightbars, const MatchParam &param,
+                            std::vector<LightbarPair> &pairs) {
+    pairs.clear();
+    int n = static_cast<int>(lightbars.size());
+    if (n < 2 || param.max_aspect_ratio <= 0) {
+        return;
+    }
+
+    // 按中心横坐标排序, 之后只需向右搜索
+    indices.resize(n);
+    for (int i = 0; i < n; ++i) {
+        indices[i] = i;
+    }
+    std::sort(indices.begin(), indices.end(), [&lightbars](int a, int b) {
+        return lightbars[a].center.x < lightbars[b].center.x;
+    });
+    xs.resize(n);
+    ys.resize(n);
+    heights.resize(n);
+    angles.resize(n);
+    for (int k = 0; k < n; ++k) {
+        const cv::RotatedRect &lightbar = lightbars[indices[k]];
+        xs[k] = lightbar.center.x;
+        ys[k] = lightbar.center.y;
+        heights[k] = lightbar.size.height;
+        angles[k] = lightbar.angle;
+    }
+    flags.resize(n);
+
+    // 长度比 h_i / h_j 在 (min, max) 内, 所以另一个灯条的长度不超过 growth 倍,
+    // 两灯条距离又小于 max_aspect_ratio 倍的平均长度, 由此得到向右搜索的最远距离
+    float growth = std::numeric_limits<float>::infinity();
+    if (param.min_length_ratio > 0) {
+        growth = static_cast<float>(std::max(param.max_length_ratio, 1.0 / param.min_length_ratio));
+    }
+    float reach_factor = static_cast<float>(param.max_aspect_ratio) * (1 + growth) / 2 * (1 + SLACK);
+
+    float loose = 1 + SLACK;
+    float tight = 1 - SLACK;
+    float min_aspect = static_cast<float>(std::max(param.min_aspect_ratio, 0.0));
+    float max_aspect = static_cast<float>(param.max_aspect_ratio);
+    float min_length = static_cast<float>(param.min_length_ratio);
+    float max_length = static_cast<float>(param.max_length_ratio);
+    float max_delta = static_cast<float>(param.max_lightbar_delta) * loose + SLACK;
+
+    // |atan(dy / dx)| < max_armor_angle 等价于 |dy| < tan(max_armor_angle) * dx, 上限不小于 90 度时不做粗筛.
+    // 写成 !(a > b) 的形式, 不做粗筛时 inf * 0 得到 NaN 也能通过
+    float max_slope = std::numeric_limits<float>::infinity();
+    if (param.max_armor_angle < 90) {
+        max_slope = static_cast<float>(std::tan(param.max_armor_angle * Util::PI / 180)) * loose;
+    }
+
+    for (int a = 0; a < n - 1; ++a) {
+        float xa = xs[a];
+        float ya = ys[a];
+        float ha = heights[a];
+        float angle_a = angles[a];
+        int index_a = indices[a];
+
+        // 超出最远距离的灯条不可能与当前灯条配对, 之后的灯条横坐标只会更大
+        float reach = reach_factor * ha;
+        if (std::isnan(reach)) {
+            reach = std::numeric_limits<float>::infinity();
+        }
+        int end = a + 1;
+        while (end < n && xs[end] - xa < reach) {
+            ++end;
+        }
+
+        // 粗筛: 各项判断用按位与连接, 循环体没有分支, 可以被编译器向量化
+        for (int b = a + 1; b < end; ++b) {
+            float dx = xs[b] - xa;
+            float dy = ys[b] - ya;
+            float hb = heights[b];
+
+            // 长度比的分子是下标较小的灯条
+            bool a_first = index_a < indices[b];
+            float h_first = a_first ? ha : hb;
+            float h_second = a_first ? hb : ha;
+            bool length_ok = (h_first > min_length * h_second * tight) & (h_first < max_length * h_second * loose);
+
+            bool delta_ok = std::fabs(angle_a - angles[b]) < max_delta;
+
+            // 比较距离的平方, 不开方
+            float distance2 = dx * dx + dy * dy;
+            float mean_height = (ha + hb) / 2;
+            float min_width = min_aspect * mean_height;
+            float max_width = max_aspect * mean_height;
+            bool aspect_ok = (distance2 > min_width * min_width * tight) & (distance2 < max_width * max_width * loose);
+
+            bool angle_ok = !(std::fabs(dy) > max_slope * dx);
+
+            flags[b] = length_ok & delta_ok & aspect_ok & angle_ok;
+        }
+
+        // 精筛: 按原来的标准判断并打分
+        for (int b = a + 1; b < end; ++b) {
+            if (!flags[b]) {
+                continue;
+            }
+            int left = std::min(index_a, indices[b]);
+            int right = std::max(index_a, indices[b]);
+            double score;
+            if (evaluate(lightbars[left], lightbars[right], param, score)) {
+                pairs.push_back({left, right, score});
+            }
+        }
+    }
+
+    // 恢复两两遍历时的顺序, 保证后续按得分排序时得分相同的装甲板次序不变
+    std::sort(pairs.begin(), pairs.end(), [](const LightbarPair &a, const LightbarPair &b) {
+        return a.left < b.left || (a.left == b.left && a.right < b.right);
+    });
+}
+
+bool LightbarMatcher::evaluate(const cv::RotatedRect &left, const cv::RotatedRect &right, const MatchParam &param,
+                               double &score) {
+    const cv::Point2f &left_center = left.center;
+    const cv::Point2f &right_center = right.center;
+
+    // 计算装甲板宽高比
+    double armor_width = sqrt((right_center.x - left_center.x) *
+                              (right_center.x - left_center.x) +
+                              (right_center.y - left_center.y) *
+                              (right_center.y - left_center.y));
+    double armor_height = (left.size.height + right.size.height) / 2;
+    double aspect_ratio = armor_width / armor_height;
+
+    // 计算两灯条长度比
+    double length_ratio = left.size.height / right.size.height;
+
+    // 计算灯条倾斜度之差
+    double lightbar_delta = fabs(left.angle - right.angle);
+
+    // 计算装甲板倾斜度
+    double armor_angle = atan((right_center.y - left_center.y) / (right_center.x - left_center.x)) * 180 / Util::PI;
+
+    // 计算灯甲倾斜度之差
+    double armor_lightbar_delta = fabs((left.angle + right.angle) / 2.0 - armor_angle);
+
+    // 判断
+    bool result = true;
+    score = 0;
+
+    // 长宽比在范围内
+    result = result && aspect_ratio > param.min_aspect_ratio && aspect_ratio < param.max_aspect_ratio;
+    score += fabs(aspect_ratio - 3.31) * 10.0 / 3.31;
+
+    // 两灯条长度相差不过大
+    result = result && length_ratio > param.min_length_ratio && length_ratio < param.max_length_ratio;
+    if (length_ratio > 1.0) {
+        score += (length_ratio - 1.0) * 10.0 / (param.max_length_ratio - 1.0);
+    } else {
+        score += (1.0 - length_ratio) * 10.0 / (1.0 - param.min_length_ratio);
+    }
+
+    // 两灯条倾斜度之差不过大
+    result = result && lightbar_delta < param.max_lightbar_delta;
+    score += lightbar_delta * 10.0 / param.max_lightbar_delta;
+
+    // 装甲板倾斜度不过大
+    result = result && fabs(armor_angle) < param.max_armor_angle;
+    score += fabs(armor_angle) * 10.0 / param.max_armor_angle;
+
+    // 灯甲倾斜度相差不过大
+    result = result && armor_lightbar_delta < param.max_armor_lightbar_delta;
+    score += armor_lightbar_delta * 10.0 / param.max_armor_lightbar_delta;
+
+    return result;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file lightbarmatcher.h
+ * @brief 灯条配对
+ * @details 将灯条按中心横坐标排序, 由每个灯条的长度和最大宽高比算出配对灯条可能的最远距离,
+ * 只在这一范围内寻找配对. 范围内的候选先以结构体数组的形式做一遍不含开方和反三角函数的粗筛,
+ * 通过粗筛的灯条对再按原来的标准精确判断和打分, 结果与两两遍历完全一致
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-12
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef LIGHTBARMATCHER_H
+#define LIGHTBARMATCHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief 灯条配对的判断标准, 含义与 ArmorDetector 中的同名参数相同
+ */
+struct MatchParam {
+    /// 装甲板宽高比的范围
+    double min_aspect_ratio;
+    double max_aspect_ratio;
+
+    /// 两灯条长度比的范围
+    double min_length_ratio;
+    double max_length_ratio;
+
+    /// 两灯条倾斜度之差的上限
+    double max_lightbar_delta;
+
+    /// 装甲板倾斜度的上限
+    double max_armor_angle;
+
+    /// 灯条与装甲板倾斜度之差的上限
+    double max_armor_lightbar_delta;
+};
+
+/**
+ * @brief 一对匹配成功的灯条
+ */
+struct LightbarPair {
+    /// 两个灯条在输入数组中的下标, left 小于 right
+    int left;
+    int right;
+
+    /// 误差得分, 越小越好
+    double score;
+};
+
+/**
+ * @brief 灯条配对类
+ * 内部缓冲区在各帧之间复用, 稳态下不分配内存
+ * @note 非线程安全, 每个线程应使用各自的对象
+ */
+class LightbarMatcher {
+private:
+    /// 按中心横坐标排序后的灯条, 以结构体数组的形式存放
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> heights;
+    std::vector<float> angles;
+
+    /// 排序后的灯条在输入数组中的下标
+    std::vector<int> indices;
+
+    /// 粗筛结果, 与当前灯条之后的搜索范围一一对应
+    std::vector<uint8_t> flags;
+
+public:
+    /**
+     * @brief 对灯条进行配对
+     *
+     * @param lightbars 灯条数组
+     * @param param 判断标准
+     * @param pairs 存放匹配成功的灯条对, 按 (left, right) 升序排列, 与两两遍历的顺序相同
+     */
+    void match(const std::vector<cv::RotatedRect> &lightbars, const MatchParam &param,
+               std::vector<LightbarPair> &pairs);
+
+    /**
+     * @brief 按原来的标准判断两个灯条能否组成装甲板, 并计算误差得分
+     *
+     * @param left 下标较小的灯条
+     * @param right 下标较大的灯条
+     * @param param 判断标准
+     * @param score 误差得分
+     * @return 能否组成装甲板
+     */
+    static bool evaluate(const cv::RotatedRect &left, const cv::RotatedRect &right, const MatchParam &param,
+                         double &score);
+};
+
+#endif // LIGHTBARMATCHER_H
@@ -0,0 +1,275 @@
+#include "colorsegmenter.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEGMENTER_X86
+#endif
+
+#include "types.h"
+
+/// 灰度定点系数, 与 OpenCV 的 BGR2GRAY 相同
+static const int B2Y = 1868;
+static const int G2Y = 9617;
+static const int R2Y = 4899;
+static const int GRAY_SHIFT = 14;
+
+/// 分割核函数, 对整幅图像逐行处理; 像素值不小于对应下限时视为通过阈值
+typedef void (*SegmentKernel)(const uchar *src, size_t src_step, uchar *dst, size_t dst_step,
+                              int width, int height, uchar grey_min, uchar subtract_min);
+
+/// 是否强制使用标量实现
+static std::atomic<bool> force_scalar(false);
+
+/**
+ * @brief 处理一行中的一段像素, 标量实现, 也用于 SIMD 实现处理行尾
+ */
+template <bool BLUE>
+static inline void segmentRowScalar(const uchar *src, uchar *dst, int begin, int end,
+                                    uchar grey_min, uchar subtract_min) {
+    for (int x = begin; x < end; ++x) {
+        int b = src[3 * x];
+        int g = src[3 * x + 1];
+        int r = src[3 * x + 2];
+        int gray = (b * B2Y + g * G2Y + r * R2Y + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+        int difference = BLUE ? b - r : r - b;
+        dst[x] = (gray >= grey_min && difference >= subtract_min) ? 255 : 0;
+    }
+}
+
+template <bool BLUE>
+static void segmentScalar(const uchar *src, size_t src_step, uchar *dst, size_t dst_step,
+                          int width, int height, uchar grey_min, uchar subtract_min) {
+    for (int y = 0; y < height; ++y) {
+        segmentRowScalar<BLUE>(src + y * src_step, dst + y * dst_step, 0, width, grey_min, subtract_min);
+    }
+}
+
+#ifdef SEGMENTER_X86
+
+/**
+ * @brief 生成从 48 字节交错 BGR 数据中取出某一通道的 pshufb 掩码
+ *
+ * @param channel 通道, 0 B, 1 G, 2 R
+ * @param part 48 字节中的第几个 16 字节
+ * @param mask 掩码, 不属于这一部分的位置为 -1, pshufb 会将其置零
+ */
+static void makeShuffleMask(int channel, int part, signed char mask[16]) {
+    for (int i = 0; i < 16; ++i) {
+        int index = i * 3 + channel;
+        mask[i] = static_cast<signed char>(index / 16 == part ? index % 16 : -1);
+    }
+}
+
+/// 三个通道各自的三组掩码
+struct ShuffleMasks {
+    alignas(16) signed char masks[3][3][16];
+
+    ShuffleMasks() {
+        for (int channel = 0; channel < 3; ++channel) {
+            for (int part = 0; part < 3; ++part) {
+                makeShuffleMask(channel, part, masks[channel][part]);
+            }
+        }
+    }
+};
+
+static const ShuffleMasks shuffle_masks;
+
+__attribute__((target("ssse3")))
+static inline __m128i loadMask128(int channel, int part) {
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle_masks.masks[channel][part]));
+}
+
+/**
+ * @brief 8 个像素的 16 位 B、G、R 计算灰度, 结果为 32 位整数再打包回 16 位
+ */
+__attribute__((target("ssse3")))
+static inline __m128i gray8x16(__m128i b, __m128i g, __m128i r, __m128i bg_coeff, __m128i r_coeff, __m128i one) {
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b, g), bg_coeff),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(r, one), r_coeff));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b, g), bg_coeff),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(r, one), r_coeff));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, GRAY_SHIFT), _mm_srli_epi32(hi, GRAY_SHIFT));
+}
+
+template <bool BLUE>
+__attribute__((target("ssse3")))
+static void segmentSSSE3(const uchar *src, size_t src_step, uchar *dst, size_t dst_step,
+                         int width, int height, uchar grey_min, uchar subtract_min) {
+    __m128i mask[3][3];
+    for (int channel = 0; channel < 3; ++channel) {
+        for (int part = 0; part < 3; ++part) {
+            mask[channel][part] = loadMask128(channel, part);
+        }
+    }
+    // (B, G) 与 (R, 1) 两两相乘相加, 常数 1 对应的系数即舍入项
+    const __m128i bg_coeff = _mm_set1_epi32((G2Y << 16) | B2Y);
+    const __m128i r_coeff = _mm_set1_epi32(((1 << (GRAY_SHIFT - 1)) << 16) | R2Y);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i grey_limit = _mm_set1_epi8(static_cast<char>(grey_min));
+    const __m128i subtract_limit = _mm_set1_epi8(static_cast<char>(subtract_min));
+
+    for (int y = 0; y < height; ++y) {
+        const uchar *src_row = src + y * src_step;
+        uchar *dst_row = dst + y * dst_step;
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const __m128i *p = reinterpret_cast<const __m128i *>(src_row + 3 * x);
+            __m128i v0 = _mm_loadu_si128(p);
+            __m128i v1 = _mm_loadu_si128(p + 1);
+            __m128i v2 = _mm_loadu_si128(p + 2);
+            __m128i b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, mask[0][0]), _mm_shuffle_epi8(v1, mask[0][1])),
+                                     _mm_shuffle_epi8(v2, mask[0][2]));
+            __m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, mask[1][0]), _mm_shuffle_epi8(v1, mask[1][1])),
+                                     _mm_shuffle_epi8(v2, mask[1][2]));
+            __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, mask[2][0]), _mm_shuffle_epi8(v1, mask[2][1])),
+                                     _mm_shuffle_epi8(v2, mask[2][2]));
+
+            __m128i gray_lo = gray8x16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero),
+                                       _mm_unpacklo_epi8(r, zero), bg_coeff, r_coeff, one);
+            __m128i gray_hi = gray8x16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero),
+                                       _mm_unpackhi_epi8(r, zero), bg_coeff, r_coeff, one);
+            __m128i gray = _mm_packus_epi16(gray_lo, gray_hi);
+            __m128i difference = BLUE ? _mm_subs_epu8(b, r) : _mm_subs_epu8(r, b);
+
+            // 无符号比较 x >= limit 等价于 max(x, limit) == x
+            __m128i grey_pass = _mm_cmpeq_epi8(_mm_max_epu8(gray, grey_limit), gray);
+            __m128i subtract_pass = _mm_cmpeq_epi8(_mm_max_epu8(difference, subtract_limit), difference);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst_row + x), _mm_and_si128(grey_pass, subtract_pass));
+        }
+        segmentRowScalar<BLUE>(src_row, dst_row, x, width, grey_min, subtract_min);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gray16x32(__m256i b, __m256i g, __m256i r, __m256i bg_coeff, __m256i r_coeff, __m256i one) {
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(b, g), bg_coeff),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(r, one), r_coeff));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(b, g), bg_coeff),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(r, one), r_coeff));
+    return _mm256_packs_epi32(_mm256_srli_epi32(lo, GRAY_SHIFT), _mm256_srli_epi32(hi, GRAY_SHIFT));
+}
+
+/**
+ * @brief 将两个 16 字节数据分别放入 256 位寄存器的低、高两个 128 位通道
+ */
+__attribute__((target("avx2")))
+static inline __m256i load2x128(const uchar *lo, const uchar *hi) {
+    return _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi)), 1);
+}
+
+template <bool BLUE>
+__attribute__((target("avx2")))
+static void segmentAVX2(const uchar *src, size_t src_step, uchar *dst, size_t dst_step,
+                        int width, int height, uchar grey_min, uchar subtract_min) {
+    __m256i mask[3][3];
+    for (int channel = 0; channel < 3; ++channel) {
+        for (int part = 0; part < 3; ++part) {
+            mask[channel][part] = _mm256_broadcastsi128_si256(
+                    _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle_masks.masks[channel][part])));
+        }
+    }
+    const __m256i bg_coeff = _mm256_set1_epi32((G2Y << 16) | B2Y);
+    const __m256i r_coeff = _mm256_set1_epi32(((1 << (GRAY_SHIFT - 1)) << 16) | R2Y);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i grey_limit = _mm256_set1_epi8(static_cast<char>(grey_min));
+    const __m256i subtract_limit = _mm256_set1_epi8(static_cast<char>(subtract_min));
+
+    for (int y = 0; y < height; ++y) {
+        const uchar *src_row = src + y * src_step;
+        uchar *dst_row = dst + y * dst_step;
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            // 低通道处理第 0~15 个像素, 高通道处理第 16~31 个像素, 之后的运算和打包都在通道内进行,
+            // 结果的像素顺序与输入一致
+            const uchar *p = src_row + 3 * x;
+            __m256i v0 = load2x128(p, p + 48);
+            __m256i v1 = load2x128(p + 16, p + 64);
+            __m256i v2 = load2x128(p + 32, p + 80);
+            __m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, mask[0][0]), _mm256_shuffle_epi8(v1, mask[0][1])),
+                                        _mm256_shuffle_epi8(v2, mask[0][2]));
+            __m256i g = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, mask[1][0]), _mm256_shuffle_epi8(v1, mask[1][1])),
+                                        _mm256_shuffle_epi8(v2, mask[1][2]));
+            __m256i r = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, mask[2][0]), _mm256_shuffle_epi8(v1, mask[2][1])),
+                                        _mm256_shuffle_epi8(v2, mask[2][2]));
+
+            __m256i gray_lo = gray16x32(_mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(g, zero),
+                                        _mm256_unpacklo_epi8(r, zero), bg_coeff, r_coeff, one);
+            __m256i gray_hi = gray16x32(_mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(g, zero),
+                                        _mm256_unpackhi_epi8(r, zero), bg_coeff, r_coeff, one);
+            __m256i gray = _mm256_packus_epi16(gray_lo, gray_hi);
+            __m256i difference = BLUE ? _mm256_subs_epu8(b, r) : _mm256_subs_epu8(r, b);
+
+            __m256i grey_pass = _mm256_cmpeq_epi8(_mm256_max_epu8(gray, grey_limit), gray);
+            __m256i subtract_pass = _mm256_cmpeq_epi8(_mm256_max_epu8(difference, subtract_limit), difference);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst_row + x), _mm256_and_si256(grey_pass, subtract_pass));
+        }
+        segmentRowScalar<BLUE>(src_row, dst_row, x, width, grey_min, subtract_min);
+    }
+}
+
+#endif // SEGMENTER_X86
+
+/// 按 CPU 支持的指令集选出的实现, 只在第一次使用时检测一次
+struct KernelTable {
+    const char *name;
+    SegmentKernel red;
+    SegmentKernel blue;
+
+    KernelTable() : name("scalar"), red(segmentScalar<false>), blue(segmentScalar<true>) {
+#ifdef SEGMENTER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            name = "AVX2";
+            red = segmentAVX2<false>;
+            blue = segmentAVX2<true>;
+        } else if (__builtin_cpu_supports("ssse3")) {
+            name = "SSSE3";
+            red = segmentSSSE3<false>;
+            blue = segmentSSSE3<true>;
+        }
+#endif // SEGMENTER_X86
+    }
+};
+
+static const KernelTable &kernelTable() {
+    static const KernelTable table;
+    return table;
+}
+
+void ColorSegmenter::segment(const cv::Mat &src, cv::Mat &dst,
+                             int grey_thres, int subtract_thres, int enemy_color) {
+    CV_Assert(src.type() == CV_8UC3);
+    dst.create(src.size(), CV_8UC1);
+
+    // x > thres 等价于 x >= thres + 1, 阈值不小于 255 时没有像素能通过
+    if (grey_thres >= 255 || subtract_thres >= 255) {
+        dst.setTo(0);
+        return;
+    }
+    uchar grey_min = cv::saturate_cast<uchar>(grey_thres + 1);
+    uchar subtract_min = cv::saturate_cast<uchar>(subtract_thres + 1);
+
+    bool blue = enemy_color == COLOR_BLUE;
+    SegmentKernel kernel;
+    if (force_scalar.load(std::memory_order_relaxed)) {
+        kernel = blue ? segmentScalar<true> : segmentScalar<false>;
+    } else {
+        kernel = blue ? kernelTable().blue : kernelTable().red;
+    }
+    kernel(src.data, src.step, dst.data, dst.step, src.cols, src.rows, grey_min, subtract_min);
+}
+
+const char *ColorSegmenter::getInstructionSet() {
+    return force_scalar.load() ? "scalar" : kernelTable().name;
+}
+
+void ColorSegmenter::forceScalar(bool enable) {
+    force_scalar.store(enable);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file colorsegmenter.h
+ * @brief 颜色分割
+ * @details 将装甲板预处理中的转灰度、灰度阈值、通道相减、相减阈值和取交集融合为一次遍历,
+ * 读入一次 BGR 图像直接写出二值图像, 按 CPU 支持的指令集在 AVX2、SSSE3 和标量实现之间选择
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-10
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef COLORSEGMENTER_H
+#define COLORSEGMENTER_H
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief 颜色分割类
+ * 输出与下面的 OpenCV 调用链逐像素一致:
+ * cvtColor(BGR2GRAY) -> threshold(GREY_THRES) -> split -> subtract -> threshold(SUBTRACT_THRES) -> bitwise_and
+ * 灰度使用与 OpenCV 相同的定点系数 (1868 B + 9617 G + 4899 R + 2^13) >> 14
+ */
+class ColorSegmenter {
+public:
+    /**
+     * @brief 将 BGR 图像分割为二值图像
+     *
+     * @param src 源图像, 类型为 CV_8UC3, 可以是不连续的 ROI
+     * @param dst 二值图像, 满足条件的像素为 255, 其余为 0, 尺寸不变时复用内存
+     * @param grey_thres 灰度阈值, 灰度大于该值的像素才可能被保留
+     * @param subtract_thres 通道相减阈值, 敌方颜色通道减去另一通道大于该值的像素才可能被保留
+     * @param enemy_color 敌方颜色, 蓝色时用 B 通道减 R 通道, 否则用 R 通道减 B 通道
+     */
+    static void segment(const cv::Mat &src, cv::Mat &dst,
+                        int grey_thres, int subtract_thres, int enemy_color);
+
+    /**
+     * @brief 获取当前使用的实现
+     *
+     * @return "AVX2", "SSSE3" 或 "scalar"
+     */
+    static const char *getInstructionSet();
+
+    /**
+     * @brief 强制使用标量实现, 用于对比测试
+     *
+     * @param enable 是否强制使用标量实现
+     */
+    static void forceScalar(bool enable);
+};
+
+#endif // COLORSEGMENTER_H
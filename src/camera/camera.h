@@ -18,18 +18,46 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
+#include <chrono>
 #include <unistd.h>
 #include <vector>
 #include <string>
 #include <exception>
 #include <mutex>
 
+#include "framepool.h"
+
 /**
  * @brief 相机类
+ * 相机类持有帧缓冲池, 各厂家相机的 getImage() 都把图像直接写入池中缓冲区,
+ * 返回的 cv::Mat 之间互不共享内存, 最后一个持有者释放后缓冲区自动回到池中
 　*/
 class Camera
 {
-private:
+protected:
+    /// 帧缓冲池中缓冲区的数量, 需大于同时在流水线中存活的图像数量
+    /// 流水线模式下邮箱中的3帧和流水线中的4帧可能同时存活, 再留出一些余量
+    constexpr static int FRAME_POOL_SIZE = 12;
+
+    /// 帧缓冲池
+    FramePool frame_pool;
+
+    /// 最近一帧开始曝光的时刻, 使用单调时钟
+    std::chrono::steady_clock::time_point frame_timestamp;
+
+    /// 曝光时间, 单位为微秒, 用于由出图时刻倒推开始曝光的时刻
+    int exposure_time = 0;
+
+    /**
+     * @brief 在 SDK 返回图像后立即调用, 记录当前帧的采集时刻
+     * 相机 SDK 的时间戳来自相机自身的时钟, 无法与主机时钟直接比较,
+     * 因此用主机收到图像的时刻减去曝光时间来估计, 得到的采集时刻偏晚, 偏差为图像传输时间
+     */
+    void stampFrame()
+    {
+        frame_timestamp = std::chrono::steady_clock::now() - std::chrono::microseconds(exposure_time);
+    }
+
 public:
     /**
      * @brief　默认构造函数
@@ -39,7 +67,11 @@ public:
     /**
      * @brief　默认析构函数
      */
-    ~Camera() {}
+    virtual ~Camera() {}
+
+    Camera(const Camera &) = delete;
+
+    Camera &operator=(const Camera &) = delete;
 
     /**
      * @brief　摄像头打开函数
@@ -67,10 +99,31 @@ public:
 
     /**
      * @brief 通过相机获取单张Mat类型图片
+     * 图像内存来自帧缓冲池, `image` 原来引用的缓冲区会先被释放
      * @param image的引用，保存获取到的图像
      */
     virtual void getImage(cv::Mat &image) = 0;
 
+    /**
+     * @brief 获取帧缓冲池, 用于查看缓冲区的使用情况
+     *
+     * @return 帧缓冲池的常引用
+     */
+    const FramePool &getFramePool() const
+    {
+        return frame_pool;
+    }
+
+    /**
+     * @brief 获取最近一次 getImage() 得到的图像开始曝光的时刻
+     *
+     * @return 单调时钟上的时刻
+     */
+    std::chrono::steady_clock::time_point getFrameTimestamp() const
+    {
+        return frame_timestamp;
+    }
+
     /**
      * @brief　关闭相机函数
      */
@@ -2,15 +2,16 @@
 
 DHCamera::DHCamera()
 {
+    m_pBufferRaw = NULL;
     is_open = false;
 }
 
 DHCamera::~DHCamera()
 {
-    if (m_pBufferRGB)
+    if (m_pBufferRaw)
     {
-        free(m_pBufferRGB);
-        m_pBufferRGB = NULL;
+        free(m_pBufferRaw);
+        m_pBufferRaw = NULL;
     }
     if (m_hDevice)
     {
@@ -69,6 +70,7 @@ void DHCamera::open(int frame_width,
     /// 设置自动曝光（OFF）并添加手动曝光
     GXSetEnum(m_hDevice, GX_ENUM_EXPOSURE_AUTO, GX_EXPOSURE_AUTO_OFF);
     GXSetFloat(m_hDevice, GX_FLOAT_EXPOSURE_TIME, exposure_time);
+    this->exposure_time = exposure_time;
 
     /// 获取图像大小
     emStatus = GXGetInt(m_hDevice, GX_INT_PAYLOAD_SIZE, &m_nPayLoadSize);
@@ -90,11 +92,13 @@ void DHCamera::open(int frame_width,
         GXGetEnum(m_hDevice, GX_ENUM_PIXEL_COLOR_FILTER, &m_nPixelColorFilter);
     }
 
-    m_pBufferRGB = (uchar *)malloc((size_t)(frame_width * frame_height * 3));
-    if (!m_pBufferRGB)
+    /// 原始图像缓冲区只分配一次, RGB 图像由帧缓冲池提供
+    m_pBufferRaw = (uchar *)realloc(m_pBufferRaw, (size_t)m_nPayLoadSize);
+    if (!m_pBufferRaw)
     {
         return;
     }
+    frame_pool.reserve(FRAME_POOL_SIZE, (size_t)(frame_width * frame_height * 3));
 
     /// 发送获取开始命令
     emStatus = GXSendCommand(m_hDevice, GX_COMMAND_ACQUISITION_START);
@@ -120,13 +124,7 @@ void DHCamera::getImage(cv::Mat &image)
 
     // 输入获取的图像参数
     GX_FRAME_DATA frame_data;
-
-    /// 申请内存
-    frame_data.pImgBuf = (uchar *)malloc((size_t)m_nPayLoadSize);
-    if (!frame_data.pImgBuf)
-    {
-        return;
-    }
+    frame_data.pImgBuf = m_pBufferRaw;
 
     /// 获取一帧图像，异常睡眠
     while (GXGetImage(m_hDevice, &frame_data, 100) != GX_STATUS_SUCCESS)
@@ -134,31 +132,32 @@ void DHCamera::getImage(cv::Mat &image)
         sleep(1);
     }
 
-    /// 成功获取相机图像，转换图像类型并变为Mat形式
+    /// 成功获取相机图像，转换图像类型并直接写入池中缓冲区
     if (frame_data.nStatus == GX_FRAME_STATUS_SUCCESS)
     {
+        stampFrame();
+        frame_pool.acquire(image, frame_data.nWidth, frame_data.nHeight);
         DxRaw8toRGB24(frame_data.pImgBuf,
-                      m_pBufferRGB,
+                      image.data,
                       (VxUint32)(frame_data.nWidth),
                       (VxUint32)(frame_data.nHeight),
                       RAW2RGB_NEIGHBOUR,
                       DX_PIXEL_COLOR_FILTER(m_nPixelColorFilter),
                       false);
-        image = cv::Mat(cv::Size(frame_data.nWidth, frame_data.nHeight), CV_8UC3, m_pBufferRGB);
-        // image_buffer_mutex.lock();
-        // cv::cvtColor(image, image, CV_RGB2BGR);
-        // image_buffer_mutex.unlock();
-        /// 释放内存
-        free(frame_data.pImgBuf);
+    }
+    else
+    {
+        /// 残帧不返回, 由调用者丢弃
+        image.release();
     }
 }
 
 void DHCamera::close()
 {
-    if (m_pBufferRGB)
+    if (m_pBufferRaw)
     {
-        delete[] m_pBufferRGB;
-        m_pBufferRGB = NULL;
+        free(m_pBufferRaw);
+        m_pBufferRaw = NULL;
     }
     GX_STATUS emStatus = GX_STATUS_SUCCESS;
     emStatus = GXSendCommand(m_hDevice, GX_COMMAND_ACQUISITION_STOP);
@@ -36,8 +36,8 @@ private:
     /// 设备句柄
     GX_DEV_HANDLE m_hDevice = NULL;
 
-    /// RGB图像数据，转为opencv的Mat形式
-    uchar *m_pBufferRGB;
+    /// 原始 Bayer 图像缓冲区, 打开相机时分配一次, 每帧复用
+    uchar *m_pBufferRaw;
 
     ///　获取的加载图像大小
     int64_t m_nPayLoadSize;
@@ -75,7 +75,7 @@ public:
               double gamma = 1, int contrast = 100);
 
     /**
-     * @brief　图像获取函数
+     * @brief　图像获取函数, 转换后的 RGB 图像直接写入帧缓冲池
      * @param image 图像
      */
     void getImage(cv::Mat &image);
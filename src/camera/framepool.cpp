@@ -0,0 +1,155 @@
+#include "framepool.h"
+
+#include <new>
+
+FramePool::FramePool() : memory(nullptr),
+                         buffer_size(0),
+                         buffer_stride(0),
+                         used_mask(0),
+                         hit_count(0),
+                         miss_count(0) {}
+
+FramePool::~FramePool()
+{
+    clear();
+}
+
+void FramePool::reserve(int capacity, size_t size)
+{
+    CV_Assert(capacity > 0 && capacity <= MAX_CAPACITY);
+    // 重复打开相机时, 尺寸够用就沿用原来的缓冲区
+    if (memory != nullptr && capacity == static_cast<int>(headers.size()) && size <= buffer_size)
+    {
+        return;
+    }
+    // 仍有图像引用旧缓冲区时不能释放, 否则会产生悬空指针
+    CV_Assert(used_mask.load() == 0);
+    clear();
+
+    buffer_size = size;
+    buffer_stride = cv::alignSize(size, 64);
+    memory = static_cast<uchar *>(cv::fastMalloc(buffer_stride * capacity));
+    for (int i = 0; i < capacity; ++i)
+    {
+        cv::UMatData *header = new cv::UMatData(this);
+        header->data = header->origdata = memory + i * buffer_stride;
+        headers.emplace_back(header);
+    }
+}
+
+void FramePool::acquire(cv::Mat &image, int width, int height, int type)
+{
+    image.release();
+    image.allocator = this;
+    image.create(height, width, type);
+}
+
+int FramePool::capacity() const
+{
+    return static_cast<int>(headers.size());
+}
+
+int FramePool::inUse() const
+{
+    return __builtin_popcountll(used_mask.load());
+}
+
+uint64_t FramePool::getHitCount() const
+{
+    return hit_count.load();
+}
+
+uint64_t FramePool::getMissCount() const
+{
+    return miss_count.load();
+}
+
+cv::UMatData *FramePool::allocate(int dims, const int *sizes, int type,
+                                  void *data, size_t *step, int flags,
+                                  cv::UMatUsageFlags usage_flags) const
+{
+    // 与 OpenCV 默认分配器相同的步长计算方式
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; --i)
+    {
+        if (step)
+        {
+            if (data && step[i] != CV_AUTOSTEP)
+            {
+                total = step[i];
+            }
+            else
+            {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    if (data == nullptr && total <= buffer_size)
+    {
+        // 在位图中抢占一个空闲缓冲区
+        uint64_t mask = used_mask.load();
+        uint64_t free_mask = ~mask & fullMask();
+        while (free_mask != 0)
+        {
+            int index = __builtin_ctzll(free_mask);
+            if (used_mask.compare_exchange_weak(mask, mask | (1ULL << index)))
+            {
+                // 就地重新构造, 复用预先分配的 UMatData, 不产生堆内存分配
+                cv::UMatData *header = headers[index];
+                header->~UMatData();
+                new (header) cv::UMatData(this);
+                header->data = header->origdata = memory + index * buffer_stride;
+                header->size = total;
+                hit_count.fetch_add(1);
+                return header;
+            }
+            free_mask = ~mask & fullMask();
+        }
+    }
+
+    // 池已耗尽或请求超出缓冲区大小, 交给默认分配器, 由其负责释放
+    miss_count.fetch_add(1);
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+}
+
+bool FramePool::allocate(cv::UMatData *data, int access_flags,
+                         cv::UMatUsageFlags usage_flags) const
+{
+    return data != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData *data) const
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+    CV_Assert(data->refcount == 0 && data->urefcount == 0);
+    size_t offset = static_cast<size_t>(data->origdata - memory);
+    int index = static_cast<int>(offset / buffer_stride);
+    CV_Assert(memory != nullptr && data->origdata >= memory && index < capacity() && headers[index] == data);
+    used_mask.fetch_and(~(1ULL << index));
+}
+
+void FramePool::clear()
+{
+    for (auto header : headers)
+    {
+        delete header;
+    }
+    headers.clear();
+    if (memory != nullptr)
+    {
+        cv::fastFree(memory);
+        memory = nullptr;
+    }
+    buffer_size = 0;
+    buffer_stride = 0;
+}
+
+uint64_t FramePool::fullMask() const
+{
+    return headers.size() >= 64 ? ~0ULL : (1ULL << headers.size()) - 1;
+}
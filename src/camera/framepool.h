@@ -0,0 +1,137 @@
+/**
+ * @file framepool.h
+ * @brief 相机帧缓冲池
+ * @details 固定数量的图像缓冲区, 以 cv::MatAllocator 的形式提供给 cv::Mat 使用.
+ * 图像的引用计数由 cv::Mat 自身维护, 最后一个持有者释放图像时缓冲区自动回到池中,
+ * 稳态下每帧不再有任何堆内存分配, 处理线程落后于采集线程时也不会读到被覆盖的图像.
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-07
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief 帧缓冲池类
+ * 缓冲区和对应的 cv::UMatData 在 reserve() 时一次性分配, 之后的申请和归还只操作一个原子位图, 无锁.
+ * 池中缓冲区用完时退回 OpenCV 默认分配器, 并记录一次未命中, 保证采集线程永远不会被阻塞.
+ *
+ * @note 池必须比所有由它分配的 cv::Mat 活得更久, 因此由相机对象持有, 生命周期与程序相同
+ */
+class FramePool : public cv::MatAllocator
+{
+public:
+    /// 池中缓冲区数量上限, 受原子位图宽度限制
+    constexpr static int MAX_CAPACITY = 64;
+
+private:
+    /// 所有缓冲区所在的连续内存块
+    uchar *memory;
+
+    /// 每个缓冲区对应的、预先构造好的 UMatData
+    std::vector<cv::UMatData *> headers;
+
+    /// 每个缓冲区的字节数
+    size_t buffer_size;
+
+    /// 相邻缓冲区首地址之间的字节数, 按缓存行对齐
+    size_t buffer_stride;
+
+    /// 占用位图, 第 i 位为 1 表示第 i 个缓冲区正在被使用
+    mutable std::atomic<uint64_t> used_mask;
+
+    /// 从池中成功分配的次数
+    mutable std::atomic<uint64_t> hit_count;
+
+    /// 池已耗尽或请求过大而退回默认分配器的次数
+    mutable std::atomic<uint64_t> miss_count;
+
+public:
+    /**
+     * @brief 默认构造函数, 构造后池为空, 需要调用 reserve() 分配缓冲区
+     */
+    FramePool();
+
+    /**
+     * @brief 析构函数, 释放所有缓冲区
+     */
+    ~FramePool();
+
+    FramePool(const FramePool &) = delete;
+
+    FramePool &operator=(const FramePool &) = delete;
+
+    /**
+     * @brief 一次性分配缓冲区, 应在相机打开时、开始采集之前调用
+     *
+     * @param capacity 缓冲区数量, 不超过 MAX_CAPACITY
+     * @param size 每个缓冲区的字节数, 应不小于一帧图像的大小
+     */
+    void reserve(int capacity, size_t size);
+
+    /**
+     * @brief 为图像申请一块池中缓冲区
+     * 会先释放 `image` 原来引用的数据, 避免在仍被其他线程持有的缓冲区上原地覆盖
+     *
+     * @param image 需要分配内存的图像
+     * @param width 图像宽度
+     * @param height 图像高度
+     * @param type 图像类型, 默认为 CV_8UC3
+     */
+    void acquire(cv::Mat &image, int width, int height, int type = CV_8UC3);
+
+    /**
+     * @brief 获取池中缓冲区数量
+     */
+    int capacity() const;
+
+    /**
+     * @brief 获取当前正在被使用的缓冲区数量
+     */
+    int inUse() const;
+
+    /**
+     * @brief 获取从池中成功分配的次数
+     */
+    uint64_t getHitCount() const;
+
+    /**
+     * @brief 获取退回默认分配器的次数
+     */
+    uint64_t getMissCount() const;
+
+    /// cv::MatAllocator 接口
+    cv::UMatData *allocate(int dims, const int *sizes, int type,
+                           void *data, size_t *step, int flags,
+                           cv::UMatUsageFlags usage_flags) const override;
+
+    /// cv::MatAllocator 接口
+    bool allocate(cv::UMatData *data, int access_flags,
+                  cv::UMatUsageFlags usage_flags) const override;
+
+    /// cv::MatAllocator 接口, 最后一个引用释放时由 cv::Mat 调用, 将缓冲区归还到池中
+    void deallocate(cv::UMatData *data) const override;
+
+private:
+    /**
+     * @brief 释放所有缓冲区
+     */
+    void clear();
+
+    /**
+     * @brief 获取全部缓冲区对应的位图掩码
+     */
+    uint64_t fullMask() const;
+};
+
+#endif // FRAMEPOOL_H
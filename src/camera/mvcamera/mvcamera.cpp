@@ -42,8 +42,9 @@ void MVCamera::open(int frame_width,
 
     // 获得相机的特性描述结构体。该结构体中包含了相机可设置的各种参数的范围信息。决定了相关函数的参数
     CameraGetCapability(hCamera, &tCapability);
-    g_pRgbBuffer = (unsigned char *)malloc(
-        tCapability.sResolutionRange.iWidthMax * tCapability.sResolutionRange.iHeightMax * 3);
+    // ISP 输出直接写入帧缓冲池, 按最大分辨率预留缓冲区
+    frame_pool.reserve(FRAME_POOL_SIZE,
+                       tCapability.sResolutionRange.iWidthMax * tCapability.sResolutionRange.iHeightMax * 3);
     /* 让SDK进入工作模式，开始接收来自相机发送的图像数据。
        如果当前相机是触发模式，则需要接收到触发帧以后才会更新图像 */
     CameraPlay(hCamera);
@@ -59,6 +60,7 @@ void MVCamera::open(int frame_width,
     CameraSetAeState(hCamera, 0);
     // 设置曝光
     CameraSetExposureTime(hCamera, exposure_time);
+    this->exposure_time = exposure_time;
     // 设置帧率
     CameraSetFrameSpeed(hCamera, frame_speed);
     // 设置gamma
@@ -98,12 +100,10 @@ void MVCamera::getImage(Mat &image)
     // 从相机的缓冲区中接受一幅图像
     if (CameraGetImageBuffer(hCamera, &sFrameInfo, &pbyBuffer, 500) == CAMERA_STATUS_SUCCESS)
     {
-        // 将图像转换为RGB图像
-        CameraImageProcess(hCamera, pbyBuffer, g_pRgbBuffer, &sFrameInfo);
-        // 使用原图像生成OpenCV中的Mat
-        image = Mat(Size(sFrameInfo.iWidth, sFrameInfo.iHeight),
-                    CV_8UC3,
-                    g_pRgbBuffer);
+        stampFrame();
+        // 从帧缓冲池中申请图像, 并将图像转换为RGB图像直接写入其中
+        frame_pool.acquire(image, sFrameInfo.iWidth, sFrameInfo.iHeight);
+        CameraImageProcess(hCamera, pbyBuffer, image.data, &sFrameInfo);
 
         /* 在成功调用CameraGetImageBuffer后，必须调用CameraReleaseImageBuffer来释放获得的buffer
            否则再次调用CameraGetImageBuffer时，程序将被挂起一直阻塞，
@@ -119,7 +119,6 @@ void MVCamera::getImage(Mat &image)
 void MVCamera::close()
 {
     CameraUnInit(hCamera);
-    free(g_pRgbBuffer);
     is_open = false;
 }
 
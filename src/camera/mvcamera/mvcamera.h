@@ -30,9 +30,6 @@
 class MVCamera : public Camera
 {
 private:
-    /// 处理后图像输出的缓冲区
-    unsigned char *g_pRgbBuffer;
-
     /// 相机的句柄
     int hCamera;
 
@@ -88,7 +85,7 @@ public:
     bool isOpen();
 
     /**
-     * @brief 通过相机获取单张Mat类型图片
+     * @brief 通过相机获取单张Mat类型图片, ISP 处理结果直接写入帧缓冲池
      * @overload
      * 
      * @param image的引用，保存获取到的图像
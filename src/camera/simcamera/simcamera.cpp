@@ -0,0 +1,262 @@
+#include "simcamera.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std::chrono;
+
+/**
+ * @brief 在图像上填充一个旋转矩形
+ * @param image 需要绘制的图像
+ * @param rect 旋转矩形
+ * @param color 填充颜色
+ */
+static void fillRotatedRect(cv::Mat &image, const cv::RotatedRect &rect, const cv::Scalar &color)
+{
+    cv::Point2f vertices[4];
+    rect.points(vertices);
+    cv::Point points[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        points[i] = vertices[i];
+    }
+    cv::fillConvexPoly(image, points, 4, color, cv::LINE_AA);
+}
+
+SimCamera::SimCamera()
+{
+    frame_width = 0;
+    frame_height = 0;
+    next_index = 0;
+    frame_count = 0;
+    injected_drop_count = 0;
+    overrun_count = 0;
+    is_open = false;
+}
+
+SimCamera::~SimCamera()
+{
+    close();
+}
+
+void SimCamera::init(const cv::FileStorage &file_storage)
+{
+    cv::FileNode sim_camera = file_storage["sim_camera"];
+    SOURCE = sim_camera["SOURCE"];
+    REPLAY_PATH = static_cast<std::string>(sim_camera["REPLAY_PATH"]);
+    REPLAY_LOOP = sim_camera["REPLAY_LOOP"];
+    FRAME_RATE = sim_camera["FRAME_RATE"];
+    EXPOSURE_DELAY = sim_camera["EXPOSURE_DELAY"];
+    JITTER = sim_camera["JITTER"];
+    DROP_RATE = sim_camera["DROP_RATE"];
+    SEED = sim_camera["SEED"];
+    ARMOR_COLOR = sim_camera["ARMOR_COLOR"];
+    ARMOR_NUMBER = sim_camera["ARMOR_NUMBER"];
+
+    // 丢帧概率为 1 时永远取不到图像
+    DROP_RATE = std::min(std::max(DROP_RATE, 0.0), 0.99);
+    JITTER = std::max(JITTER, 0.0);
+}
+
+void SimCamera::open(int frame_width,
+                     int frame_height,
+                     int exposure_time,
+                     double frame_speed,
+                     double gamma,
+                     int contrast)
+{
+    double frame_rate = FRAME_RATE > 0 ? FRAME_RATE : frame_speed;
+    if (frame_width <= 0 || frame_height <= 0 || frame_rate <= 0)
+    {
+        throw CameraException("Invalid simulated camera parameters.");
+    }
+    if (SOURCE == SOURCE_REPLAY)
+    {
+        replay.open(REPLAY_PATH);
+        if (!replay.isOpened())
+        {
+            throw CameraException("Open simulated camera replay error: " + REPLAY_PATH);
+        }
+    }
+    this->frame_width = frame_width;
+    this->frame_height = frame_height;
+    frame_period = duration_cast<steady_clock::duration>(duration<double>(1.0 / frame_rate));
+    exposure_delay = microseconds(EXPOSURE_DELAY >= 0 ? EXPOSURE_DELAY : exposure_time);
+    frame_pool.reserve(FRAME_POOL_SIZE, (size_t)(frame_width * frame_height * 3));
+
+    random_engine.seed(SEED);
+    start_time = steady_clock::now();
+    last_delivery_time = start_time;
+    frame_timestamp = start_time;
+    next_index = 0;
+    frame_count = 0;
+    injected_drop_count = 0;
+    overrun_count = 0;
+    is_open = true;
+}
+
+bool SimCamera::isOpen()
+{
+    return is_open;
+}
+
+void SimCamera::getImage(cv::Mat &image)
+{
+    if (!is_open)
+    {
+        throw CameraException("Get image error. Camera is not opened.");
+    }
+
+    // 取图不及时: 之后的帧也已就绪, 说明这一帧已被覆盖, 直接跳到最近就绪的一帧
+    uint64_t index = next_index;
+    steady_clock::time_point now = steady_clock::now();
+    if (now > readyTime(index))
+    {
+        uint64_t latest = index + (now - readyTime(index)) / frame_period;
+        overrun_count += latest - index;
+        index = latest;
+    }
+
+    // 随机丢帧: 被丢掉的帧不输出, 继续等待下一帧
+    std::bernoulli_distribution drop(DROP_RATE);
+    while (drop(random_engine))
+    {
+        ++injected_drop_count;
+        ++index;
+    }
+
+    // 出图时间抖动, 但不早于上一帧, 保证帧序不乱
+    steady_clock::time_point delivery_time = readyTime(index);
+    if (JITTER > 0)
+    {
+        std::normal_distribution<double> jitter(0, JITTER);
+        delivery_time += duration_cast<steady_clock::duration>(duration<double, std::micro>(jitter(random_engine)));
+    }
+    delivery_time = std::max(delivery_time, last_delivery_time);
+    std::this_thread::sleep_until(delivery_time);
+    last_delivery_time = delivery_time;
+
+    frame_pool.acquire(image, frame_width, frame_height);
+    if (SOURCE == SOURCE_REPLAY)
+    {
+        if (!replayFrame(image, index - next_index))
+        {
+            // 回放结束, 与视频输入一样停止出图
+            image.release();
+            close();
+            return;
+        }
+    }
+    else
+    {
+        renderFrame(image, index);
+    }
+
+    // 仿真相机知道精确的曝光时刻, 不需要像真实相机那样估计
+    frame_timestamp = start_time + frame_period * static_cast<int64_t>(index);
+    next_index = index + 1;
+    ++frame_count;
+}
+
+void SimCamera::close()
+{
+    if (replay.isOpened())
+    {
+        replay.release();
+    }
+    is_open = false;
+}
+
+uint64_t SimCamera::getFrameCount() const
+{
+    return frame_count;
+}
+
+uint64_t SimCamera::getInjectedDropCount() const
+{
+    return injected_drop_count;
+}
+
+uint64_t SimCamera::getOverrunCount() const
+{
+    return overrun_count;
+}
+
+steady_clock::time_point SimCamera::readyTime(uint64_t index) const
+{
+    return start_time + frame_period * static_cast<int64_t>(index) + exposure_delay;
+}
+
+void SimCamera::renderFrame(cv::Mat &image, uint64_t index)
+{
+    image.setTo(cv::Scalar(25, 25, 25));
+
+    // 场景时间由帧号决定, 丢帧时装甲板会像真实相机一样跳一步
+    double t = duration<double>(frame_period).count() * index;
+    double scale = 1.0 + 0.35 * std::sin(2 * CV_PI * 0.13 * t);
+    float bar_length = static_cast<float>(frame_height / 9.0 * scale);
+    float bar_width = bar_length / 5;
+    float armor_width = bar_length * 2.4f;
+    cv::Point2f center(static_cast<float>(frame_width * (0.5 + 0.35 * std::sin(2 * CV_PI * 0.25 * t))),
+                       static_cast<float>(frame_height * (0.5 + 0.15 * std::sin(2 * CV_PI * 0.4 * t))));
+    float angle = static_cast<float>(12 * std::sin(2 * CV_PI * 0.3 * t));
+    cv::Point2f axis(std::cos(angle * static_cast<float>(CV_PI) / 180), std::sin(angle * static_cast<float>(CV_PI) / 180));
+
+    // 装甲板中间的数字贴纸
+    fillRotatedRect(image, cv::RotatedRect(center, cv::Size2f(armor_width - bar_width * 2, bar_length * 2), angle),
+                    cv::Scalar(70, 70, 70));
+    std::string number = std::to_string(ARMOR_NUMBER);
+    double font_scale = bar_length / 25.0;
+    int thickness = std::max(1, static_cast<int>(bar_length / 12));
+    int baseline = 0;
+    cv::Size text_size = cv::getTextSize(number, cv::FONT_HERSHEY_SIMPLEX, font_scale, thickness, &baseline);
+    cv::putText(image, number, cv::Point(cvRound(center.x - text_size.width / 2.0), cvRound(center.y + text_size.height / 2.0)),
+                cv::FONT_HERSHEY_SIMPLEX, font_scale, cv::Scalar(200, 200, 200), thickness, cv::LINE_AA);
+
+    // 两侧灯条, 中心过曝发白, 与真实相机拍到的灯条相近. 图像为 RGB 顺序
+    cv::Scalar bar_color = ARMOR_COLOR == COLOR_BLUE ? cv::Scalar(90, 140, 255) : cv::Scalar(255, 90, 90);
+    cv::Scalar core_color = ARMOR_COLOR == COLOR_BLUE ? cv::Scalar(240, 245, 255) : cv::Scalar(255, 240, 240);
+    for (int side = -1; side <= 1; side += 2)
+    {
+        cv::Point2f bar_center = center + axis * (side * armor_width / 2);
+        fillRotatedRect(image, cv::RotatedRect(bar_center, cv::Size2f(bar_width, bar_length), angle), bar_color);
+        fillRotatedRect(image, cv::RotatedRect(bar_center, cv::Size2f(bar_width / 3, bar_length * 0.9f), angle), core_color);
+    }
+}
+
+bool SimCamera::replayFrame(cv::Mat &image, uint64_t skip)
+{
+    // 被丢掉和被覆盖的帧也要从回放源中跳过, 保证回放时间轴与相机节拍一致
+    for (uint64_t i = 0; i < skip; ++i)
+    {
+        replay.grab();
+    }
+    if (!replay.read(replay_frame))
+    {
+        if (!REPLAY_LOOP)
+        {
+            return false;
+        }
+        replay.set(cv::CAP_PROP_POS_FRAMES, 0);
+        if (!replay.read(replay_frame))
+        {
+            return false;
+        }
+    }
+
+    // image 已从帧缓冲池中按设定尺寸分配, 这里只在原地写入
+    if (replay_frame.size() != image.size())
+    {
+        cv::resize(replay_frame, image, image.size());
+        cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    }
+    else
+    {
+        cv::cvtColor(replay_frame, image, cv::COLOR_BGR2RGB);
+    }
+    return true;
+}
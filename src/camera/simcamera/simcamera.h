@@ -0,0 +1,209 @@
+/**
+ * @file simcamera.h
+ * @brief 仿真相机
+ * @details 不依赖任何相机 SDK, 按设定帧率输出合成的装甲板场景或回放视频/图片序列, 图像同样来自帧缓冲池.
+ * 可以模拟曝光延迟、出图时间抖动和随机丢帧, 用于在没有相机的机器上按真实节拍对
+ * 采集-处理-发送整条流水线进行测试
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-07
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef SIMCAMERA_H
+#define SIMCAMERA_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include "camera.h"
+
+/**
+ * @brief 仿真相机类
+ * 相机按固定节拍触发曝光, 第 i 帧在 `开始时刻 + i * 帧间隔` 开始曝光,
+ * 经过曝光延迟和随机抖动后才能被取走. 取图不及时时, 已经过期的帧被丢弃, 只保留最近的一帧,
+ * 与工业相机只缓存最新一帧时的行为一致.
+ * 输出 RGB 顺序的三通道图像, 与大恒相机一致
+ */
+class SimCamera : public Camera
+{
+public:
+    /// 图像来源
+    enum Source
+    {
+        /// 合成的装甲板场景
+        SOURCE_SYNTHETIC = 0,
+        /// 回放视频文件或图片序列
+        SOURCE_REPLAY = 1
+    };
+
+private:
+    /// 图像来源
+    int SOURCE = SOURCE_SYNTHETIC;
+
+    /// 回放路径, 可以是视频文件, 也可以是 "img_%04d.png" 形式的图片序列
+    std::string REPLAY_PATH;
+
+    /// 回放结束后是否从头循环
+    int REPLAY_LOOP = 1;
+
+    /// 帧率, 小于等于 0 时使用 open() 传入的帧率
+    double FRAME_RATE = 0;
+
+    /// 曝光延迟, 单位为微秒, 小于 0 时使用 open() 传入的曝光时间
+    int EXPOSURE_DELAY = -1;
+
+    /// 出图时间抖动的标准差, 单位为微秒
+    double JITTER = 0;
+
+    /// 随机丢帧的概率
+    double DROP_RATE = 0;
+
+    /// 随机数种子
+    int SEED = 0;
+
+    /// 合成场景中装甲板的颜色, 1 是红色, 2 是蓝色
+    int ARMOR_COLOR = 1;
+
+    /// 合成场景中装甲板上的数字
+    int ARMOR_NUMBER = 3;
+
+    /// 图像宽度
+    int frame_width;
+
+    /// 图像高度
+    int frame_height;
+
+    /// 相邻两帧之间的时间间隔
+    std::chrono::steady_clock::duration frame_period;
+
+    /// 曝光延迟
+    std::chrono::steady_clock::duration exposure_delay;
+
+    /// 第 0 帧开始曝光的时刻
+    std::chrono::steady_clock::time_point start_time;
+
+    /// 上一帧被取走的时刻, 保证抖动后出图时间仍然单调
+    std::chrono::steady_clock::time_point last_delivery_time;
+
+    /// 下一个待输出的帧号
+    uint64_t next_index;
+
+    /// 已输出的帧数
+    uint64_t frame_count;
+
+    /// 随机注入的丢帧数
+    uint64_t injected_drop_count;
+
+    /// 取图不及时而被新帧覆盖的帧数
+    uint64_t overrun_count;
+
+    /// 随机数发生器
+    std::mt19937 random_engine;
+
+    /// 回放用的视频读取对象
+    cv::VideoCapture replay;
+
+    /// 回放时读出的原始图像, 尺寸不变时复用内存
+    cv::Mat replay_frame;
+
+    /// 相机状态
+    bool is_open;
+
+public:
+    /**
+     * @brief　默认构造函数
+     */
+    SimCamera();
+
+    /**
+     * @brief　默认析构函数
+     */
+    ~SimCamera();
+
+    /**
+     * @brief 读入仿真相机参数, 需在 open() 之前调用
+     * @param file_storage 配置文件的 FileStorage 对象
+     */
+    void init(const cv::FileStorage &file_storage);
+
+    /**
+     * @brief　打开仿真相机
+     * @param frame_width 图像长度
+     * @param frame_height 图像宽度
+     * @param exposure_time 曝光时间, 单位为微秒, 配置文件中未指定曝光延迟时作为曝光延迟
+     * @param frame_speed 帧率, 配置文件中未指定帧率时使用
+     * @param gamma gamma值, 仿真相机中不使用
+     * @param contrast 对比度, 仿真相机中不使用
+     */
+    void open(int frame_width = 1280,
+              int frame_height = 1024,
+              int exposure_time = 100,
+              double frame_speed = 210,
+              double gamma = 1, int contrast = 100);
+
+    /**
+     * @brief 等到下一帧可以取走时输出该帧, 写入帧缓冲池
+     * 回放结束且不循环时相机关闭, 输出空图像
+     * @param image 图像
+     */
+    void getImage(cv::Mat &image);
+
+    /**
+     * @brief　返回相机是否已开启
+     * @return true/false状态
+     */
+    bool isOpen();
+
+    /**
+     * @brief　关闭仿真相机
+     */
+    void close();
+
+    /**
+     * @brief 获取已输出的帧数
+     */
+    uint64_t getFrameCount() const;
+
+    /**
+     * @brief 获取随机注入的丢帧数
+     */
+    uint64_t getInjectedDropCount() const;
+
+    /**
+     * @brief 获取取图不及时而被覆盖的帧数
+     */
+    uint64_t getOverrunCount() const;
+
+private:
+    /**
+     * @brief 计算某一帧可以被取走的时刻
+     * @param index 帧号
+     * @return 开始曝光的时刻加上曝光延迟
+     */
+    std::chrono::steady_clock::time_point readyTime(uint64_t index) const;
+
+    /**
+     * @brief 绘制合成图像: 暗背景上一块按帧号运动的装甲板
+     * @param image 需要绘制的图像
+     * @param index 帧号, 决定装甲板的位置、大小和倾斜角
+     */
+    void renderFrame(cv::Mat &image, uint64_t index);
+
+    /**
+     * @brief 从回放源读出图像, 缩放到设定尺寸并转为 RGB 顺序
+     * @param image 需要写入的图像
+     * @param skip 读取前需要跳过的帧数
+     * @return 是否读到图像
+     */
+    bool replayFrame(cv::Mat &image, uint64_t skip);
+};
+
+#endif // SIMCAMERA_H
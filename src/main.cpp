@@ -1,4 +1,5 @@
 #include "workspace.h"
+#include "threadpool.h"
 
 void init();
 
@@ -26,6 +27,7 @@ void init()
     workspace.MODE = workspace_node["MODE"];
     workspace.USE_CAMERA = workspace_node["USE_CAMERA"];
     workspace.SAVE_VIDEO = workspace_node["SAVE_VIDEO"];
+    workspace.PIPELINE = workspace_node["PIPELINE"];
     workspace.DEBUG_INFO = file_storage["DEBUG_INFO"];
     workspace.FRAME_WIDTH = file_storage["FRAME_WIDTH"];
     workspace.FRAME_HEIGHT = file_storage["FRAME_HEIGHT"];
@@ -49,6 +51,19 @@ void init()
                         __FILE__, __FUNCTION__, __LINE__);
     }
 
+    // 使用仿真相机时替换掉默认的相机对象
+    if (workspace.USE_CAMERA == 2)
+    {
+        SimCamera *sim_camera = new SimCamera();
+        sim_camera->init(file_storage);
+        delete workspace.camera;
+        workspace.camera = sim_camera;
+    }
+
+    // 线程池要在各模块初始化之前按配置创建, 否则首次并行时按全部核心创建
+    ThreadPool::init(workspace_node["THREAD_POOL_THREADS"],
+                     static_cast<std::string>(workspace_node["THREAD_POOL_CORES"]));
+
     // 其它文件参数传入及初始化
     cv::FileNode arm_detect = workspace_node["arm_detect"];
     Armor::GAMMA_C = arm_detect["GAMMA_C"];
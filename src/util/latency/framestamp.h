@@ -0,0 +1,77 @@
+/**
+ * @file framestamp.h
+ * @brief 帧时间戳
+ * @details 每一帧图像从采集到发送的各个时刻, 随图像一起在线程之间传递,
+ * 用于计算真实的采集-发送延迟和各阶段的耗时. 所有时刻都取自单调时钟, 不受系统校时影响
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-08
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef FRAMESTAMP_H
+#define FRAMESTAMP_H
+
+#include <chrono>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief 帧时间戳结构体
+ * 时刻按流水线顺序排列, 后面的时刻总不早于前面的时刻
+ */
+struct FrameStamp {
+    /// 使用的时钟, 必须是单调时钟
+    typedef std::chrono::steady_clock Clock;
+
+    /// 开始曝光的时刻
+    Clock::time_point capture;
+
+    /// 放入图像邮箱的时刻
+    Clock::time_point enqueue;
+
+    /// 从图像邮箱取出的时刻
+    Clock::time_point dequeue;
+
+    /// 目标检测完成的时刻
+    Clock::time_point detect;
+
+    /// 坐标和角度解算完成的时刻
+    Clock::time_point solve;
+
+    /// 数据包发送完成的时刻
+    Clock::time_point sent;
+
+    /**
+     * @brief 获取当前时刻
+     */
+    static Clock::time_point now() {
+        return Clock::now();
+    }
+
+    /**
+     * @brief 计算两个时刻之间的时间
+     *
+     * @param from 起始时刻
+     * @param to 结束时刻
+     * @return 时间间隔, 单位为毫秒
+     */
+    static double elapsed(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+};
+
+/**
+ * @brief 带时间戳的图像, 图像邮箱中传递的帧类型
+ */
+struct StampedFrame {
+    /// 图像
+    cv::Mat image;
+
+    /// 时间戳
+    FrameStamp stamp;
+};
+
+#endif // FRAMESTAMP_H
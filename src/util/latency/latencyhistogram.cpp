@@ -0,0 +1,72 @@
+#include "latencyhistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+
+constexpr double LatencyHistogram::BUCKET_WIDTH;
+constexpr int LatencyHistogram::BUCKET_NUM;
+
+LatencyHistogram::LatencyHistogram(const std::string &name) : name(name) {
+    reset();
+}
+
+void LatencyHistogram::record(double milliseconds) {
+    // 时钟不会倒退, 负值只可能来自未打时间戳的帧, 按 0 处理
+    milliseconds = std::max(milliseconds, 0.0);
+    int index = std::min(static_cast<int>(milliseconds / BUCKET_WIDTH), BUCKET_NUM - 1);
+    ++buckets[index];
+    ++count;
+    sum += milliseconds;
+    max = std::max(max, milliseconds);
+}
+
+void LatencyHistogram::reset() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum = 0.0;
+    max = 0.0;
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return count;
+}
+
+double LatencyHistogram::getMean() const {
+    return count == 0 ? 0.0 : sum / count;
+}
+
+double LatencyHistogram::getMax() const {
+    return max;
+}
+
+double LatencyHistogram::getPercentile(double quantile) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    uint64_t target = static_cast<uint64_t>(std::ceil(std::min(std::max(quantile, 0.0), 1.0) * count));
+    target = std::max<uint64_t>(target, 1);
+    uint64_t accumulated = 0;
+    for (int i = 0; i < BUCKET_NUM - 1; ++i) {
+        accumulated += buckets[i];
+        if (accumulated >= target) {
+            return std::min((i + 1) * BUCKET_WIDTH, max);
+        }
+    }
+    // 落在溢出桶中, 只能给出最大值
+    return max;
+}
+
+std::ostream &operator<<(std::ostream &out, const LatencyHistogram &histogram) {
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(2)
+        << std::left << std::setw(16) << histogram.name << std::right
+        << " n: " << histogram.getCount()
+        << ", mean: " << histogram.getMean()
+        << ", p50: " << histogram.getPercentile(0.5)
+        << ", p99: " << histogram.getPercentile(0.99)
+        << ", max: " << histogram.getMax() << " ms" << std::endl;
+    out.flags(flags);
+    return out;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file latencyhistogram.h
+ * @brief 延迟直方图
+ * @details 以固定宽度的桶统计延迟分布, 记录一次只是一次数组自增, 不分配内存,
+ * 可以在每帧的热路径上调用, 按需输出均值、最大值和分位数
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-08
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief 延迟直方图类
+ * 桶宽 0.1 ms, 覆盖 0~100 ms, 超出范围的记录落入最后一个桶, 最大值单独记录
+ * @note 非线程安全, 只应由一个线程记录
+ */
+class LatencyHistogram {
+private:
+    /// 桶宽, 单位为毫秒
+    constexpr static double BUCKET_WIDTH = 0.1;
+
+    /// 桶的数量, 最后一个桶收纳超出范围的记录
+    constexpr static int BUCKET_NUM = 1001;
+
+    /// 直方图名称
+    std::string name;
+
+    /// 各个桶中的记录数
+    uint64_t buckets[BUCKET_NUM];
+
+    /// 总记录数
+    uint64_t count;
+
+    /// 所有记录之和
+    double sum;
+
+    /// 最大记录
+    double max;
+
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param name 直方图名称, 输出时使用
+     */
+    explicit LatencyHistogram(const std::string &name = "");
+
+    /**
+     * @brief 记录一次延迟
+     *
+     * @param milliseconds 延迟, 单位为毫秒
+     */
+    void record(double milliseconds);
+
+    /**
+     * @brief 清空所有记录
+     */
+    void reset();
+
+    /**
+     * @brief 获取总记录数
+     */
+    uint64_t getCount() const;
+
+    /**
+     * @brief 获取平均延迟, 单位为毫秒
+     */
+    double getMean() const;
+
+    /**
+     * @brief 获取最大延迟, 单位为毫秒
+     */
+    double getMax() const;
+
+    /**
+     * @brief 获取延迟的分位数
+     *
+     * @param quantile 分位, 取值范围 [0, 1]
+     * @return 该分位所在桶的上边界, 单位为毫秒
+     */
+    double getPercentile(double quantile) const;
+
+    /**
+     * @brief 输出统计结果: 名称、记录数、均值、中位数、p99 和最大值
+     */
+    friend std::ostream &operator<<(std::ostream &out, const LatencyHistogram &histogram);
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,118 @@
+/**
+ * @file blockingqueue.h
+ * @brief 有界阻塞队列
+ * @details 固定容量的先进先出队列, 队列满时生产者阻塞, 队列空时消费者阻塞,
+ * 用于流水线各级之间传递任务, 下游处理不过来时反压到上游
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-09
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef BLOCKINGQUEUE_H
+#define BLOCKINGQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 有界阻塞队列类
+ * 元素存放在预先分配好的环形数组中, 入队出队不分配内存, 适合传递指针等小对象
+ *
+ * @tparam T 元素类型, 需要可默认构造和拷贝
+ */
+template <class T>
+class BlockingQueue {
+private:
+    /// 环形数组
+    std::vector<T> items;
+
+    /// 队首下标
+    size_t head;
+
+    /// 队列中的元素个数
+    size_t count;
+
+    /// 保护队列状态的锁
+    mutable std::mutex mutex;
+
+    /// 队列非空条件
+    std::condition_variable not_empty;
+
+    /// 队列未满条件
+    std::condition_variable not_full;
+
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param capacity 队列容量
+     */
+    explicit BlockingQueue(size_t capacity) : items(capacity), head(0), count(0) {}
+
+    BlockingQueue(const BlockingQueue &) = delete;
+
+    BlockingQueue &operator=(const BlockingQueue &) = delete;
+
+    /**
+     * @brief 元素入队, 队列满时阻塞等待
+     *
+     * @param item 入队的元素
+     */
+    void push(const T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return count < items.size(); });
+        items[(head + count) % items.size()] = item;
+        ++count;
+        lock.unlock();
+        not_empty.notify_one();
+    }
+
+    /**
+     * @brief 尝试入队, 队列满时不等待
+     *
+     * @param item 入队的元素
+     * @return 是否入队成功
+     */
+    bool tryPush(const T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (count == items.size()) {
+            return false;
+        }
+        items[(head + count) % items.size()] = item;
+        ++count;
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief 元素出队, 队列空时阻塞等待
+     *
+     * @return 队首元素
+     */
+    T pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return count > 0; });
+        T item = items[head];
+        head = (head + 1) % items.size();
+        --count;
+        lock.unlock();
+        not_full.notify_one();
+        return item;
+    }
+
+    /**
+     * @brief 获取队列中的元素个数
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+};
+
+#endif // BLOCKINGQUEUE_H
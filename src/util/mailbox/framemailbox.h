@@ -0,0 +1,246 @@
+/**
+ * @file framemailbox.h
+ * @brief 最新帧邮箱
+ * @details 基于三缓冲的单生产者/单消费者无锁"最新帧"邮箱, 用于图像接收线程向图像处理线程传递图像.
+ * 生产者总是写入自己独占的后台缓冲区, 写完后与中间缓冲区原子交换; 消费者读取时再与中间缓冲区交换,
+ * 因此数据通路上没有锁, 也不会产生堆内存分配. 消费者没有新帧时阻塞等待, 不再空转占满一个核.
+ * 消费者可以在读到新帧之后继续持有旧帧, 持有的槽位由邮箱标记为占用, 生产者换用备用槽位, 不会覆盖它们.
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-06
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef FRAMEMAILBOX_H
+#define FRAMEMAILBOX_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief 最新帧邮箱类
+ * 三个槽位分别由生产者(后台)、消费者(前台)和邮箱(中间)持有, 中间槽位的下标和"有新帧"标志位
+ * 打包在一个原子变量里, 双方只通过原子交换来转移槽位的所有权.
+ * 每次发布都会给帧打上递增的序号, 据此统计被覆盖和被丢弃的帧数.
+ * read() 取出的槽位被标记为占用, 直到消费者调用 release() 归还. 占用的槽位经中间槽位回到生产者手中时,
+ * 生产者把它换成 N - 3 个备用槽位中已归还的一个, 因此生产者总是在无人引用的槽位上原地写入新帧.
+ *
+ * @tparam T 槽位中存放的帧类型, 需要可默认构造
+ * @tparam N 槽位数, 消费者同时持有的帧不超过 N - 3 个时生产者不会等待
+ * @note 只允许一个线程调用生产者接口, 一个线程调用消费者接口
+ */
+template <class T, int N = 3>
+class FrameMailbox {
+private:
+    static_assert(N >= 3, "a frame mailbox needs at least three slots");
+
+    /// 中间槽位状态中表示"有未读新帧"的标志位
+    constexpr static uint32_t FRESH_BIT = 0x80000000u;
+
+    /// 中间槽位状态中的下标掩码
+    constexpr static uint32_t INDEX_MASK = FRESH_BIT - 1;
+
+    /// 帧槽位
+    T slots[N];
+
+    /// 每个槽位中帧的发布序号, 序号从 1 开始
+    uint64_t sequences[N];
+
+    /// 槽位是否仍被消费者持有, 由 read() 置位, release() 清除
+    std::atomic<bool> busy[N];
+
+    /// 生产者持有的备用槽位下标, 只用 3 号及以后的元素
+    uint32_t spares[N];
+
+    /// 中间槽位的下标和新帧标志位
+    std::atomic<uint32_t> middle;
+
+    /// 生产者独占的槽位下标
+    uint32_t back;
+
+    /// 消费者独占的槽位下标
+    uint32_t front;
+
+    /// 已发布的帧数, 只由生产者修改
+    std::atomic<uint64_t> published_count;
+
+    /// 未被读取就被新帧覆盖的帧数, 只由生产者修改
+    std::atomic<uint64_t> overwritten_count;
+
+    /// 消费者根据序号间隔统计到的丢帧数, 只由消费者修改
+    std::atomic<uint64_t> dropped_count;
+
+    /// 消费者上一次读到的帧序号
+    uint64_t last_sequence;
+
+    /// 消费者是否正在等待新帧
+    std::atomic<bool> waiting;
+
+    /// 邮箱是否已关闭, 关闭后消费者不再阻塞
+    std::atomic<bool> closed;
+
+    /// 仅用于消费者阻塞等待的锁和条件变量, 不保护任何数据
+    std::mutex wait_mutex;
+    std::condition_variable wait_condition;
+
+public:
+    /**
+     * @brief 默认构造函数, 0 号槽位归生产者, 1 号归邮箱, 2 号归消费者, 其余为生产者的备用槽位
+     */
+    FrameMailbox() : middle(1),
+                     back(0),
+                     front(2),
+                     published_count(0),
+                     overwritten_count(0),
+                     dropped_count(0),
+                     last_sequence(0),
+                     waiting(false),
+                     closed(false) {
+        for (int i = 0; i < N; ++i) {
+            sequences[i] = 0;
+            busy[i].store(false, std::memory_order_relaxed);
+            spares[i] = i;
+        }
+    }
+
+    FrameMailbox(const FrameMailbox &) = delete;
+
+    FrameMailbox &operator=(const FrameMailbox &) = delete;
+
+    /**
+     * @brief 生产者接口: 获取当前可写的槽位, 直接在其中填充新帧以复用槽位内存
+     * 换回的槽位仍被消费者持有时, 换成一个已归还的备用槽位; 备用槽位都被持有时让出 CPU 等待归还
+     *
+     * @return 生产者独占且无人引用的槽位引用, 在调用 publish() 之前一直有效
+     */
+    T &writeBuffer() {
+        while (busy[back].load(std::memory_order_acquire)) {
+            for (int i = 3; i < N; ++i) {
+                if (!busy[spares[i]].load(std::memory_order_acquire)) {
+                    std::swap(back, spares[i]);
+                    break;
+                }
+            }
+            if (busy[back].load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+        return slots[back];
+    }
+
+    /**
+     * @brief 生产者接口: 发布 writeBuffer() 中已经写好的帧, 并换回一个新的可写槽位
+     *
+     * @return 本次发布的帧序号
+     */
+    uint64_t publish() {
+        uint64_t sequence = published_count.load(std::memory_order_relaxed) + 1;
+        sequences[back] = sequence;
+        uint32_t previous = middle.exchange(back | FRESH_BIT, std::memory_order_seq_cst);
+        back = previous & INDEX_MASK;
+        published_count.store(sequence, std::memory_order_relaxed);
+        if (previous & FRESH_BIT) {
+            overwritten_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 只有消费者真正睡眠时才去碰锁, 正常情况下发布过程完全无锁
+        if (waiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            wait_condition.notify_one();
+        }
+        return sequence;
+    }
+
+    /**
+     * @brief 消费者接口: 取出最新的一帧并标记为占用, 没有新帧时阻塞等待
+     *
+     * @param frame 指向取出的帧, 在对它调用 release() 之前一直有效
+     * @param timeout_ms 最长等待时间, 单位为毫秒
+     * @return 是否取到新帧
+     *   @retval true 取到新帧
+     *   @retval false 等待超时或邮箱已关闭
+     */
+    bool read(T *&frame, int timeout_ms = 100) {
+        if (!(middle.load(std::memory_order_seq_cst) & FRESH_BIT)) {
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            waiting.store(true, std::memory_order_seq_cst);
+            wait_condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+                return (middle.load(std::memory_order_seq_cst) & FRESH_BIT) || closed.load();
+            });
+            waiting.store(false, std::memory_order_relaxed);
+            if (!(middle.load(std::memory_order_seq_cst) & FRESH_BIT)) {
+                return false;
+            }
+        }
+
+        uint32_t previous = middle.exchange(front, std::memory_order_seq_cst);
+        front = previous & INDEX_MASK;
+
+        // 序号不连续说明中间有帧在被读到之前就被覆盖了
+        uint64_t sequence = sequences[front];
+        if (last_sequence != 0 && sequence > last_sequence + 1) {
+            dropped_count.fetch_add(sequence - last_sequence - 1, std::memory_order_relaxed);
+        }
+        last_sequence = sequence;
+
+        // 置位先于下一次 read() 把槽位交还给中间槽位, 生产者换回它时一定能看到
+        busy[front].store(true, std::memory_order_relaxed);
+        frame = &slots[front];
+        return true;
+    }
+
+    /**
+     * @brief 消费者接口: 归还 read() 取出的帧, 之后生产者可以在其槽位上写入新帧
+     *
+     * @param frame read() 取出的帧
+     */
+    void release(const T *frame) {
+        busy[frame - slots].store(false, std::memory_order_release);
+    }
+
+    /**
+     * @brief 关闭邮箱, 唤醒正在等待的消费者
+     */
+    void close() {
+        closed.store(true);
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        wait_condition.notify_all();
+    }
+
+    /**
+     * @brief 获取已发布的帧数
+     */
+    uint64_t getPublishedCount() const {
+        return published_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 获取未被读取就被新帧覆盖的帧数
+     */
+    uint64_t getOverwrittenCount() const {
+        return overwritten_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 获取消费者根据帧序号统计到的丢帧数
+     */
+    uint64_t getDroppedCount() const {
+        return dropped_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 获取消费者最近一次读到的帧序号
+     */
+    uint64_t getLastSequence() const {
+        return last_sequence;
+    }
+};
+
+#endif // FRAMEMAILBOX_H
@@ -0,0 +1,21 @@
+#include "threadpool.h"
+
+#include <sstream>
+#include <vector>
+
+void ThreadPool::init(int threads, const std::string &cores) {
+    // 解析逗号分隔的核心编号
+    std::vector<int> core_ids;
+    std::stringstream stream(cores);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.find_first_not_of(" \t") != std::string::npos) {
+            core_ids.push_back(std::stoi(item));
+        }
+    }
+    thread_pool_init(threads, core_ids.empty() ? nullptr : core_ids.data(), static_cast<int>(core_ids.size()));
+}
+
+int ThreadPool::threads() {
+    return thread_pool_threads();
+}
@@ -0,0 +1,74 @@
+/**
+ * @file threadpool.h
+ * @brief 全局线程池
+ * @details 对 darknet 常驻线程池的 C++ 封装, 分类器和视觉代码共用同一组工作线程.
+ * 工作线程只在初始化时创建一次, 可以绑定到指定核心, 循环之间在条件变量上休眠;
+ * 工作量低于阈值的循环、嵌套的循环以及线程池被其他线程占用时, 直接在调用线程上串行执行
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-14
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <string>
+
+#include <darknet.h>
+
+/**
+ * @brief 线程池类
+ * 只有静态成员, 线程池本身在 darknet 中, 整个进程只有一个
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief 重新创建工作线程, 不能在并行循环内部调用
+     *
+     * @param threads 参与并行循环的线程数, 包括调用线程, 0 表示使用全部在线核心或全部指定核心
+     * @param cores 工作线程绑定的核心, 逗号分隔, 如 "2,3", 为空时不绑定
+     */
+    static void init(int threads, const std::string &cores = "");
+
+    /**
+     * @brief 参与并行循环的线程数, 线程池尚未创建时为 0
+     */
+    static int threads();
+
+    /**
+     * @brief 把 [begin, end) 分块交给线程池执行
+     *
+     * @param begin 起始下标
+     * @param end 结束下标, 不包含
+     * @param work 整个循环的工作量, 约为乘加次数, 低于阈值时串行执行
+     * @param function 以 (块起始, 块结束) 调用, 各块互不重叠, 可能在不同线程上同时执行
+     */
+    template <class Function>
+    static void parallelFor(int begin, int end, double work, const Function &function) {
+        if (end <= begin) {
+            return;
+        }
+        Range<Function> range{begin, &function};
+        parallel_for(end - begin, work, &Range<Function>::run, &range);
+    }
+
+private:
+    /**
+     * @brief 把 C++ 可调用对象转成 darknet 的回调
+     */
+    template <class Function>
+    struct Range {
+        int offset;
+        const Function *function;
+
+        static void run(void *args, int begin, int end) {
+            Range *range = static_cast<Range *>(args);
+            (*range->function)(range->offset + begin, range->offset + end);
+        }
+    };
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,102 @@
+#include "imagesampler.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <dirent.h>
+
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+/**
+ * @brief 目录中已有样本的最大编号加一, 没有样本时为 0
+ */
+static uint64_t nextSampleIndex(const std::string &directory) {
+    uint64_t next = 0;
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) {
+        return next;
+    }
+    while (dirent *entry = readdir(dir)) {
+        char *end = nullptr;
+        unsigned long long index = strtoull(entry->d_name, &end, 10);
+        // 只认 "<编号>.jpg" 形式的文件名
+        if (end != entry->d_name && std::string(end) == ".jpg" && index + 1 > next) {
+            next = index + 1;
+        }
+    }
+    closedir(dir);
+    return next;
+}
+
+ImageSampler::ImageSampler() : interval(0),
+                               first_index(0),
+                               submit_count(0),
+                               saved_count(0),
+                               dropped_count(0),
+                               queue(QUEUE_CAPACITY) {}
+
+ImageSampler::~ImageSampler() {
+    close();
+}
+
+void ImageSampler::open(const std::string &directory, int interval) {
+    close();
+    if (interval <= 0) {
+        return;
+    }
+    this->directory = directory;
+    this->interval = interval;
+    // 接着目录中已有的样本编号, 重启后不覆盖之前采集的样本
+    first_index = nextSampleIndex(directory);
+    submit_count = 0;
+    saved_count = 0;
+    dropped_count = 0;
+    writer = std::thread(&ImageSampler::writeFunc, this);
+}
+
+void ImageSampler::close() {
+    if (!writer.joinable()) {
+        return;
+    }
+    // 空图像排在剩余样本之后, 写入线程处理完它们才会退出
+    queue.push(cv::Mat());
+    writer.join();
+}
+
+bool ImageSampler::isOpen() const {
+    return writer.joinable();
+}
+
+void ImageSampler::submit(const cv::Mat &image) {
+    if (!isOpen() || image.empty()) {
+        return;
+    }
+    if (submit_count++ % interval != 0) {
+        return;
+    }
+    if (!queue.tryPush(image.clone())) {
+        ++dropped_count;
+    }
+}
+
+uint64_t ImageSampler::getSavedCount() const {
+    return saved_count.load();
+}
+
+uint64_t ImageSampler::getDroppedCount() const {
+    return dropped_count;
+}
+
+void ImageSampler::writeFunc() {
+    char name[32];
+    for (;;) {
+        cv::Mat image = queue.pop();
+        if (image.empty()) {
+            break;
+        }
+        uint64_t index = saved_count.load();
+        snprintf(name, sizeof(name), "/%06llu.jpg", static_cast<unsigned long long>(first_index + index));
+        cv::imwrite(directory + name, image);
+        saved_count.store(index + 1);
+    }
+}
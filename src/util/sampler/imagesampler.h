@@ -0,0 +1,112 @@
+/**
+ * @file imagesampler.h
+ * @brief 异步图像采样器
+ * @details 按固定间隔从检测线程提交的图像中抽取样本, 由后台线程写入磁盘,
+ * 检测线程只做一次小图像的拷贝, 不等待磁盘 I/O. 写入跟不上时直接丢弃样本
+ * @author 董行健
+ * @version 2021 Season
+ * @update
+ * @email dannydxj@icloud.com
+ * @date 2021-03-13
+ * @license Copyright© 2021 HITwh HERO-RoboMaster Group
+ */
+
+#ifndef IMAGESAMPLER_H
+#define IMAGESAMPLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+
+#include "blockingqueue.h"
+
+/**
+ * @brief 异步图像采样器类
+ * 图像按提交顺序编号保存为 "<目录>/<编号>.jpg", 编号接着目录中已有样本的最大编号, 不覆盖已有样本
+ */
+class ImageSampler {
+private:
+    /// 等待写入的样本数上限
+    static const size_t QUEUE_CAPACITY = 16;
+
+    /// 保存目录
+    std::string directory;
+
+    /// 采样间隔, 每提交多少张图像保存一张
+    int interval;
+
+    /// 本次开启后首个样本的编号
+    uint64_t first_index;
+
+    /// 已提交的图像数
+    uint64_t submit_count;
+
+    /// 已写入磁盘的样本数
+    std::atomic<uint64_t> saved_count;
+
+    /// 队列已满而丢弃的样本数
+    uint64_t dropped_count;
+
+    /// 等待写入的样本, 空图像表示停止写入线程
+    BlockingQueue<cv::Mat> queue;
+
+    /// 写入线程
+    std::thread writer;
+
+public:
+    /**
+     * @brief 构造函数, 采样器初始为关闭状态
+     */
+    ImageSampler();
+
+    /**
+     * @brief 析构函数, 写完队列中剩余的样本后退出
+     */
+    ~ImageSampler();
+
+    /**
+     * @brief 开启采样, 间隔不大于 0 时不开启
+     *
+     * @param directory 保存目录, 需事先存在
+     * @param interval 采样间隔
+     */
+    void open(const std::string &directory, int interval);
+
+    /**
+     * @brief 关闭采样, 等待写入线程写完队列中剩余的样本
+     */
+    void close();
+
+    /**
+     * @brief 返回采样器是否已开启
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief 提交一张图像, 按采样间隔决定是否保存, 不阻塞
+     *
+     * @param image 图像, 被选中时拷贝一份, 调用后可以立即改写
+     */
+    void submit(const cv::Mat &image);
+
+    /**
+     * @brief 获取已写入磁盘的样本数
+     */
+    uint64_t getSavedCount() const;
+
+    /**
+     * @brief 获取队列已满而丢弃的样本数
+     */
+    uint64_t getDroppedCount() const;
+
+private:
+    /**
+     * @brief 写入线程函数
+     */
+    void writeFunc();
+};
+
+#endif // IMAGESAMPLER_H
@@ -3,6 +3,7 @@
 #include "util.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -22,12 +23,43 @@ Workspace::~Workspace()
 
 void Workspace::run()
 {
+    report_start_time = FrameStamp::now();
+    // 固定模式下发给电控的模式不随帧变化, 在各线程启动前设置一次, 之后只有解算线程写 send_pack
+    switch (MODE)
+    {
+    case MODE_ARMOR1:
+    case MODE_ARMOR2:
+    case MODE_SMALLRUNE:
+    case MODE_BIGRUNE:
+    case MODE_HERO:
+    case MODE_ENGINEER:
+        send_pack.mode = MODE;
+        break;
+    default:
+        break;
+    }
     thread image_receiving_thread(&Workspace::imageReceivingFunc, this);
-    thread image_processing_thread(&Workspace::imageProcessingFunc, this);
     thread message_communicating_thread(&Workspace::messageCommunicatingFunc, this);
+    if (PIPELINE)
+    {
+        for (auto &task : frame_tasks)
+        {
+            free_tasks.push(&task);
+        }
+        thread preprocessing_thread(&Workspace::preprocessingFunc, this);
+        thread detecting_thread(&Workspace::detectingFunc, this);
+        thread solving_thread(&Workspace::solvingFunc, this);
+        preprocessing_thread.join();
+        detecting_thread.join();
+        solving_thread.join();
+    }
+    else
+    {
+        thread image_processing_thread(&Workspace::imageProcessingFunc, this);
+        image_processing_thread.join();
+    }
 
     image_receiving_thread.join();
-    image_processing_thread.join();
     message_communicating_thread.join();
 }
 
@@ -72,40 +104,60 @@ void Workspace::imageReceivingFunc()
         }
     }
 
+    // 相机输出的 RGB 图像, 来自帧缓冲池, 转换到邮箱槽位后即可在下一帧复用
+    Mat camera_image;
     while (true)
     {
         static Timer timer;
         timer.start();
-        Mat image;
+        // 直接写入邮箱的后台槽位
+        StampedFrame &frame = image_mailbox.writeBuffer();
+        Mat &image = frame.image;
         if (USE_CAMERA)
         {
-            cv::cvtColor(image, image, CV_RGB2BGR);
-            if (image_buffer.size() < MAX_IMAGE_BUFFER_SIZE)
+            camera->getImage(camera_image);
+            if (camera_image.empty())
             {
-                camera->getImage(image);
-                image_buffer.emplace_back(image);
-                if (SAVE_VIDEO == 1)
+                // 仿真相机回放结束后关闭, 与视频输入一样退出
+                if (!camera->isOpen())
                 {
-                    writer.write(image);
+                    cerr << "相机已关闭\n";
+                    image_mailbox.close();
+                    exit(0);
                 }
+                continue;
+            }
+            frame.stamp.capture = camera->getFrameTimestamp();
+            // 原地转换会先拷贝一份源图像, 改为转换到槽位自己的图像中; 槽位无人引用, 尺寸不变时不重新分配
+            cv::cvtColor(camera_image, image, CV_RGB2BGR);
+            if (SAVE_VIDEO == 1)
+            {
+                writer.write(image);
             }
         }
         else
         {
+            // 邮箱只交出处理线程已归还的槽位, 直接在槽位的图像上原地读入
             cap >> image;
             if (image.empty())
             {
                 cerr << "视频为空\n";
+                image_mailbox.close();
                 exit(0);
             }
-            if (image_buffer.size() < MAX_IMAGE_BUFFER_SIZE)
-            {
-                image_buffer.emplace_back(image);
-            }
+            frame.stamp.capture = FrameStamp::now();
         }
+        frame.stamp.enqueue = FrameStamp::now();
+        image_mailbox.publish();
         if (RUNNING_TIME)
         {
             timer.printTime("图像接收");
+            if (USE_CAMERA)
+            {
+                const FramePool &frame_pool = camera->getFramePool();
+                cout << "frame pool in use: " << frame_pool.inUse() << "/" << frame_pool.capacity()
+                     << ", misses: " << frame_pool.getMissCount() << endl;
+            }
         }
         timer.stop();
     }
@@ -113,132 +165,251 @@ void Workspace::imageReceivingFunc()
 
 void Workspace::imageProcessingFunc()
 {
-    ostringstream ostr;
-    Timer timer;
+    FrameTask task;
     while (true)
     {
         try
         {
-            timer.start();
-
-            if (image_buffer.empty())
+            // 没有新帧时阻塞等待, 不再空转
+            if (!receiveTask(task))
             {
                 continue;
             }
+            preprocessTask(task);
+            detectTask(task);
+            solveTask(task);
+            sendTask(task);
+        }
+        catch (Exception &e)
+        {
+            Debugger::warning(e.what(), __FILE__, __FUNCTION__, __LINE__);
+        }
+    }
+}
 
-            image_buffer_mutex.lock();
-            image_original = image_buffer.back();
-            image_buffer.clear();
-            image_buffer_mutex.unlock();
-
-            setModeAndColor();
+void Workspace::preprocessingFunc()
+{
+    while (true)
+    {
+        // 没有空闲任务说明下游处理不过来, 在这里阻塞, 新帧留在邮箱中被覆盖
+        FrameTask *task = free_tasks.pop();
+        while (!receiveTask(*task))
+        {
+        }
+        try
+        {
+            preprocessTask(*task);
+        }
+        catch (Exception &e)
+        {
+            task->is_valid = false;
+            Debugger::warning(e.what(), __FILE__, __FUNCTION__, __LINE__);
+        }
+        preprocessed_tasks.push(task);
+    }
+}
 
-            //TODO RUNNING_TIME for each module.
-            switch (read_pack.mode)
-            {
-            case Mode::MODE_ARMOR1:
-            case Mode::MODE_ARMOR2:
-            {
-                bool has_target = armor_detector.run(image_original, read_pack.enemy_color, target_armor);
-                if (has_target)
-                {
-                    // 解算成世界坐标
-                    target_solver.run(target_armor, target);
-                    send_pack.set(target);
-                    // 解算云台角度
-                    AngleSolver::run(target, 20, read_pack.ptz_pitch, send_pack.pred_yaw, send_pack.pred_pitch);
-                }
-                else
-                {
-                    send_pack.clear();
-                }
-                break;
-            }
-            case Mode::MODE_SMALLRUNE:
+void Workspace::detectingFunc()
+{
+    while (true)
+    {
+        FrameTask *task = preprocessed_tasks.pop();
+        try
+        {
+            if (task->is_valid)
             {
-                if (energy.run(image_original, read_pack.enemy_color, target))
-                {
-                    send_pack.set(target);
-                    AngleSolver::run(target, 30, read_pack.ptz_pitch, send_pack.pred_yaw, send_pack.pred_pitch);
-                    cout << "test rune here\n";
-                    cout << energy.isCalibrated << '\n';
-                    cout << send_pack;
-                    if (!energy.isCalibrated &&
-                        Util::equalZero(send_pack.pred_yaw) &&
-                        Util::equalZero(send_pack.pred_pitch))
-                    {
-                        energy.isCalibrated = true;
-                        energy.setOriginPtzPitch(read_pack.ptz_pitch);
-                        energy.setOriginPtzYaw(read_pack.ptz_yaw);
-                    }
-                }
-                else
-                {
-                    if (energy.isCalibrated)
-                    {
-                        send_pack.pred_pitch = energy.getOriginPtzPitch() - read_pack.ptz_pitch;
-                        send_pack.pred_yaw = energy.getOriginPtzYaw() - read_pack.ptz_yaw;
-                    }
-                    else
-                    {
-                        send_pack.clear();
-                        //send_pack.pred_pitch = 0.0;
-                        //send_pack.pred_yaw = 0.0;
-                    }
-                }
-                break;
-            }
-            default:
-                send_pack.x = 0.0;
-                send_pack.y = 0.0;
-                send_pack.z = 0.0;
-                send_pack.pred_yaw = 0.0;
-                send_pack.pred_pitch = 0.0;
+                detectTask(*task);
             }
+        }
+        catch (Exception &e)
+        {
+            task->is_valid = false;
+            Debugger::warning(e.what(), __FILE__, __FUNCTION__, __LINE__);
+        }
+        detected_tasks.push(task);
+    }
+}
 
-            //if ((read_pack.mode == Mode::MODE_ARMOR1) || (read_pack.mode == Mode::MODE_ARMOR2)) {
-            //    bool has_target = armor_detector.run(image_original, read_pack.enemy_color, target_armor);
-            //    if (has_target) {
-            //        // 解算成世界坐标
-            //        target_solver.run(target_armor, target);
-            //
-            //        send_pack.set(target);
-            //        // 解算云台角度
-            //        AngleSolver::run(target, 20, read_pack.ptz_pitch, send_pack.pred_yaw, send_pack.pred_pitch);
-            //    } else {
-            //        send_pack.clear();
-            //    }
-            //}
-
-            send_pack.time_delay = timer.getTime();
-            if (RUNNING_TIME)
+void Workspace::solvingFunc()
+{
+    while (true)
+    {
+        FrameTask *task = detected_tasks.pop();
+        try
+        {
+            if (task->is_valid)
             {
-                timer.printTime("图像预处理");
+                solveTask(*task);
+                sendTask(*task);
             }
-            timer.stop();
+        }
+        catch (Exception &e)
+        {
+            Debugger::warning(e.what(), __FILE__, __FUNCTION__, __LINE__);
+        }
+        // 任务处理完毕, 把帧归还给图像邮箱后交还给第一级
+        releaseFrame(*task);
+        free_tasks.push(task);
+    }
+}
 
-            if (USE_SERIAL)
-            {
-                serial_port.sendData(send_pack);
-            }
-            else if (USE_CAN != 2)
+bool Workspace::receiveTask(FrameTask &task)
+{
+    // 串行模式下同一个任务反复使用, 取新帧前先归还上一帧
+    releaseFrame(task);
+    StampedFrame *frame = nullptr;
+    if (!image_mailbox.read(frame))
+    {
+        return false;
+    }
+    task.frame = frame;
+    task.stamp = frame->stamp;
+    task.stamp.dequeue = FrameStamp::now();
+    task.image = frame->image;
+
+    // 模式、颜色和云台姿态取自取帧时刻, 之后各阶段都使用这份快照
+    setModeAndColor();
+    task.mode = read_pack.mode;
+    task.enemy_color = read_pack.enemy_color;
+    task.ptz_pitch = read_pack.ptz_pitch;
+    task.ptz_yaw = read_pack.ptz_yaw;
+    task.has_target = false;
+    task.is_valid = true;
+    return true;
+}
+
+void Workspace::releaseFrame(FrameTask &task)
+{
+    task.image.release();
+    if (task.frame != nullptr)
+    {
+        image_mailbox.release(task.frame);
+        task.frame = nullptr;
+    }
+}
+
+void Workspace::preprocessTask(FrameTask &task)
+{
+    if (task.mode == Mode::MODE_ARMOR1 || task.mode == Mode::MODE_ARMOR2)
+    {
+        armor_detector.preprocess(task.image, task.enemy_color, task.detection);
+    }
+}
+
+void Workspace::detectTask(FrameTask &task)
+{
+    switch (task.mode)
+    {
+    case Mode::MODE_ARMOR1:
+    case Mode::MODE_ARMOR2:
+        task.has_target = armor_detector.detect(task.detection, task.target_armor);
+        break;
+    case Mode::MODE_SMALLRUNE:
+        task.has_target = energy.run(task.image, task.enemy_color, task.target);
+        break;
+    default:
+        task.has_target = false;
+    }
+    task.stamp.detect = FrameStamp::now();
+}
+
+void Workspace::solveTask(FrameTask &task)
+{
+    //TODO RUNNING_TIME for each module.
+    switch (task.mode)
+    {
+    case Mode::MODE_ARMOR1:
+    case Mode::MODE_ARMOR2:
+    {
+        if (task.has_target)
+        {
+            // 解算成世界坐标
+            target_solver.run(task.target_armor, task.target);
+            send_pack.set(task.target);
+            // 解算云台角度
+            AngleSolver::run(task.target, 20, task.ptz_pitch, send_pack.pred_yaw, send_pack.pred_pitch);
+        }
+        else
+        {
+            send_pack.clear();
+        }
+        break;
+    }
+    case Mode::MODE_SMALLRUNE:
+    {
+        if (task.has_target)
+        {
+            send_pack.set(task.target);
+            AngleSolver::run(task.target, 30, task.ptz_pitch, send_pack.pred_yaw, send_pack.pred_pitch);
+            cout << "test rune here\n";
+            cout << energy.isCalibrated << '\n';
+            cout << send_pack;
+            if (!energy.isCalibrated &&
+                Util::equalZero(send_pack.pred_yaw) &&
+                Util::equalZero(send_pack.pred_pitch))
             {
-                can_node.send(send_pack);
+                energy.isCalibrated = true;
+                energy.setOriginPtzPitch(task.ptz_pitch);
+                energy.setOriginPtzYaw(task.ptz_yaw);
             }
-
-            if (DEBUG_INFO)
+        }
+        else
+        {
+            if (energy.isCalibrated)
             {
-                cout << target << read_pack << send_pack;
+                send_pack.pred_pitch = energy.getOriginPtzPitch() - task.ptz_pitch;
+                send_pack.pred_yaw = energy.getOriginPtzYaw() - task.ptz_yaw;
             }
-            if (SHOW_IMAGE)
+            else
             {
-                showImage();
+                send_pack.clear();
+                //send_pack.pred_pitch = 0.0;
+                //send_pack.pred_yaw = 0.0;
             }
         }
-        catch (Exception &e)
-        {
-            Debugger::warning(e.what(), __FILE__, __FUNCTION__, __LINE__);
-        }
+        break;
+    }
+    default:
+        send_pack.x = 0.0;
+        send_pack.y = 0.0;
+        send_pack.z = 0.0;
+        send_pack.pred_yaw = 0.0;
+        send_pack.pred_pitch = 0.0;
+    }
+    task.stamp.solve = FrameStamp::now();
+}
+
+void Workspace::sendTask(FrameTask &task)
+{
+    // 发给电控的是从开始曝光到发送的真实延迟, 包含传输和排队的时间.
+    // 串口和 CAN 都按一个字节发送, 超过 255 ms 时取 255, 否则会回绕成很小的延迟
+    send_pack.time_delay = min(FrameStamp::elapsed(task.stamp.capture, FrameStamp::now()), 255.0);
+    if (RUNNING_TIME)
+    {
+        cout << "图像处理 time costs: " << FrameStamp::elapsed(task.stamp.dequeue, task.stamp.solve) << "ms" << endl;
+        cout << "frames published: " << image_mailbox.getPublishedCount()
+             << ", overwritten: " << image_mailbox.getOverwrittenCount()
+             << ", dropped: " << image_mailbox.getDroppedCount() << endl;
+    }
+
+    if (USE_SERIAL)
+    {
+        serial_port.sendData(send_pack);
+    }
+    else if (USE_CAN != 2)
+    {
+        can_node.send(send_pack);
+    }
+    task.stamp.sent = FrameStamp::now();
+    recordLatency(task.stamp);
+
+    if (DEBUG_INFO)
+    {
+        cout << task.target << read_pack << send_pack;
+    }
+    if (SHOW_IMAGE)
+    {
+        showImage(task);
     }
 }
 
@@ -296,6 +467,43 @@ void Workspace::messageCommunicatingFunc()
     }
 }
 
+void Workspace::recordLatency(const FrameStamp &stamp)
+{
+    capture_latency.record(FrameStamp::elapsed(stamp.capture, stamp.enqueue));
+    queue_latency.record(FrameStamp::elapsed(stamp.enqueue, stamp.dequeue));
+    detect_latency.record(FrameStamp::elapsed(stamp.dequeue, stamp.detect));
+    solve_latency.record(FrameStamp::elapsed(stamp.detect, stamp.solve));
+    send_latency.record(FrameStamp::elapsed(stamp.solve, stamp.sent));
+    total_latency.record(FrameStamp::elapsed(stamp.capture, stamp.sent));
+
+    if (total_latency.getCount() >= LATENCY_REPORT_INTERVAL)
+    {
+        if (RUNNING_TIME)
+        {
+            FrameStamp::Clock::time_point now = FrameStamp::now();
+            cout << (PIPELINE ? "pipelined" : "serial") << " throughput: "
+                 << total_latency.getCount() * 1000.0 / FrameStamp::elapsed(report_start_time, now) << " fps" << endl;
+            const NumberCache &number_cache = armor_detector.getNumberCache();
+            if (number_cache.enabled())
+            {
+                uint64_t hits = number_cache.getHits();
+                uint64_t lookups = hits + number_cache.getMisses();
+                cout << "number cache hits: " << hits << "/" << lookups
+                     << " (" << (lookups ? hits * 100.0 / lookups : 0.0) << "%)" << endl;
+            }
+            cout << capture_latency << queue_latency << detect_latency
+                 << solve_latency << send_latency << total_latency;
+            report_start_time = now;
+        }
+        capture_latency.reset();
+        queue_latency.reset();
+        detect_latency.reset();
+        solve_latency.reset();
+        send_latency.reset();
+        total_latency.reset();
+    }
+}
+
 void Workspace::openSerialPort()
 {
     FileStorage file_storage(PARAM_PATH, FileStorage::READ);
@@ -335,7 +543,7 @@ void Workspace::setModeAndColor()
     case MODE_BIGRUNE:
     case MODE_HERO:
     case MODE_ENGINEER:
-        send_pack.mode = read_pack.mode = MODE;
+        read_pack.mode = MODE;
         break;
     case MODE_DEFAULT:
         Debugger::warning("default MODE.", __FILE__, __FUNCTION__, __LINE__);
@@ -363,32 +571,40 @@ void Workspace::setModeAndColor()
     }
 }
 
-void Workspace::showImage()
+void Workspace::showImage(FrameTask &task)
 {
     string window_name_target = "with target";
     string window_name_proc = "processed binary";
     namedWindow(window_name_target, 1);
     namedWindow(window_name_proc, 1);
 
-    copyMakeBorder(armor_detector.processed_image,
-                   armor_detector.processed_image, 0,
-                   FRAME_HEIGHT - armor_detector.processed_image.rows, 0,
-                   FRAME_WIDTH - armor_detector.processed_image.cols,
+    Mat &processed_image = task.detection.processed_image;
+    if (processed_image.empty())
+    {
+        processed_image = Mat::zeros(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+    }
+    copyMakeBorder(processed_image,
+                   processed_image, 0,
+                   FRAME_HEIGHT - processed_image.rows, 0,
+                   FRAME_WIDTH - processed_image.cols,
                    BORDER_CONSTANT, Scalar(255, 255, 255));
     if (TRACKBAR)
         Debugger::trackbar(this->armor_detector, window_name_target, window_name_proc);
 
-    Mat image_draw = image_original.clone();
+    Mat image_draw = task.image.clone();
     // cv::cvtColor(image_draw, image_draw, CV_RGB2BGR);
-    Debugger::drawTypeValue(target, image_draw);
+    Debugger::drawTypeValue(task.target, image_draw);
     Debugger::drawTypeValue(read_pack, image_draw);
     Debugger::drawTypeValue(send_pack, image_draw);
-    Debugger::drawArmor(target_armor, image_draw);
+    if (task.has_target)
+    {
+        Debugger::drawArmor(task.target_armor, image_draw);
+    }
 
     imshow(window_name_target, image_draw);
-    imshow(window_name_proc, armor_detector.processed_image);
+    imshow(window_name_proc, processed_image);
     // cv::cvtColor(image_original, image_original, CV_RGB2BGR);
-    imshow("original", image_original);
+    imshow("original", task.image);
     waitKey(1);
 }
 
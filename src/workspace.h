@@ -13,8 +13,6 @@
 #ifndef WORKSPACE_H
 #define WORKSPACE_H
 
-#include <mutex>
-
 #include "anglesolver.h"
 #include "armor.h"
 #include "armordetector.h"
@@ -22,27 +20,68 @@
 #include "camera.h"
 #include "dhcamera.h"
 #include "mvcamera.h"
+#include "simcamera.h"
 #include "serialport.h"
 #include "cannode.h"
 #include "targetsolver.h"
 #include "energy.h"
+#include "framemailbox.h"
+#include "blockingqueue.h"
+#include "framestamp.h"
+#include "latencyhistogram.h"
 
 /// 配置文件路径<br>
 /// 开自启时需改为绝对路径
 const static std::string PARAM_PATH = "../param/param.xml";
 
+/**
+ * @brief 一帧图像的处理任务
+ * 串行模式下在同一线程中依次经过各个阶段, 流水线模式下在各级线程之间传递
+ */
+struct FrameTask {
+    /// 取自图像邮箱的帧, 任务结束前一直占用它的槽位
+    const StampedFrame *frame = nullptr;
+
+    /// 图像, 引用邮箱槽位中的图像
+    cv::Mat image;
+
+    /// 时间戳
+    FrameStamp stamp;
+
+    /// 取帧时刻的工作模式
+    int mode = MODE_DEFAULT;
+
+    /// 取帧时刻的敌方颜色
+    int enemy_color = COLOR_DEFAULT;
+
+    /// 取帧时刻的云台 pitch 角
+    double ptz_pitch = 0.0;
+
+    /// 取帧时刻的云台 yaw 角
+    double ptz_yaw = 0.0;
+
+    /// 装甲板检测的中间结果
+    DetectionFrame detection;
+
+    /// 是否找到目标
+    bool has_target = false;
+
+    /// 目标装甲板
+    Armor target_armor;
+
+    /// 目标三维坐标
+    Target target;
+
+    /// 任务是否有效, 处理过程中出现异常时置为 false, 不再发送
+    bool is_valid = true;
+};
+
 /**
  * @brief 工作类
  * 完成多线程, 图像接收, 图像处理, 通信功能
  */
 class Workspace {
 private:
-    /// 图片缓冲队列大小
-    constexpr static int MAX_IMAGE_BUFFER_SIZE = 10;
-
-    /// 线程锁
-    std::mutex image_buffer_mutex;
-
     /// 文件输出流
     std::ofstream outfile;
 
@@ -66,17 +105,20 @@ private:
     SerialPort serial_port;
     CanNode can_node;
 
-    ///图像缓冲区
-    std::vector<cv::Mat> image_buffer;
+    /// 流水线中同时处理的最大帧数
+    constexpr static int PIPELINE_DEPTH = 4;
 
-    /// 当前图像
-    cv::Mat image_original;
+    /// 图像邮箱, 无锁地把最新一帧连同时间戳从接收线程交给处理线程<br>
+    /// 每个流水线任务最多占用一个槽位, 另需三个槽位做三缓冲
+    FrameMailbox<StampedFrame, PIPELINE_DEPTH + 3> image_mailbox;
 
-    ///目标装甲板
-    Armor target_armor;
-
-    /// 目标三维坐标
-    Target target;
+    /// 各阶段延迟直方图, 只由图像处理线程记录
+    LatencyHistogram capture_latency{"capture"};
+    LatencyHistogram queue_latency{"queue"};
+    LatencyHistogram detect_latency{"detect"};
+    LatencyHistogram solve_latency{"solve"};
+    LatencyHistogram send_latency{"send"};
+    LatencyHistogram total_latency{"capture->sent"};
 
     /// MCU通信发送数据包
     SendPack send_pack;
@@ -110,7 +152,7 @@ private:
     /// 6:工程取弹<br>
     int MODE = MODE_DEFAULT;
 
-    /// 是否使用相机，是1否0
+    /// 是否使用相机：0 使用视频传入, 1 使用工业相机, 2 使用仿真相机
     /// ***注意：不使用相机时默认为使用视频传入***
     int USE_CAMERA = 1;
 
@@ -135,6 +177,27 @@ private:
     /// 当前帧图片运算时间, 子弹发射延迟中要考虑进去
     float delay_time;
 
+    /// 打印延迟统计的间隔帧数
+    constexpr static int LATENCY_REPORT_INTERVAL = 1000;
+
+    /// 本次延迟统计开始的时刻, 用于计算吞吐量
+    FrameStamp::Clock::time_point report_start_time;
+
+    /// 是否使用流水线模式处理图像, 1 是, 0 否
+    int PIPELINE = 0;
+
+    /// 流水线任务, 在三级之间循环使用
+    FrameTask frame_tasks[PIPELINE_DEPTH];
+
+    /// 空闲任务, 由第三级交还给第一级
+    BlockingQueue<FrameTask *> free_tasks{PIPELINE_DEPTH};
+
+    /// 预处理完成的任务, 由第一级交给第二级
+    BlockingQueue<FrameTask *> preprocessed_tasks{PIPELINE_DEPTH};
+
+    /// 检测完成的任务, 由第二级交给第三级
+    BlockingQueue<FrameTask *> detected_tasks{PIPELINE_DEPTH};
+
     /// 测试视频输入路径
     std::string VIDEO_PATH;
 
@@ -170,6 +233,64 @@ private:
      */
     void imageProcessingFunc();
 
+    /**
+     * @brief 流水线第一级线程: 取帧和图像预处理
+     */
+    void preprocessingFunc();
+
+    /**
+     * @brief 流水线第二级线程: 寻找灯条, 匹配和识别装甲板
+     */
+    void detectingFunc();
+
+    /**
+     * @brief 流水线第三级线程: 坐标和角度解算, 每帧解算完成后即向MCU发送数据包
+     */
+    void solvingFunc();
+
+    /**
+     * @brief 从图像邮箱中取出最新一帧, 填写到任务中
+     *
+     * @param task 需要填写的任务
+     * @return 是否取到新帧
+     */
+    bool receiveTask(FrameTask &task);
+
+    /**
+     * @brief 任务不再使用图像时把帧归还给图像邮箱, 之后接收线程可以在该槽位上写入新帧
+     *
+     * @param task 当前任务
+     */
+    void releaseFrame(FrameTask &task);
+
+    /**
+     * @brief 预处理阶段
+     *
+     * @param task 当前任务
+     */
+    void preprocessTask(FrameTask &task);
+
+    /**
+     * @brief 检测阶段
+     *
+     * @param task 当前任务
+     */
+    void detectTask(FrameTask &task);
+
+    /**
+     * @brief 解算阶段, 填写 `send_pack`
+     *
+     * @param task 当前任务
+     */
+    void solveTask(FrameTask &task);
+
+    /**
+     * @brief 发送阶段, 按解算完成的先后发送 `send_pack` 并记录延迟
+     *
+     * @param task 当前任务
+     */
+    void sendTask(FrameTask &task);
+
     /**
      * @brief 通信线程, 读取MCU发送的数据包
      */
@@ -188,8 +309,17 @@ private:
 
     /**
      * @brief 调试时显示图像 & 创建滚动条
+     *
+     * @param task 刚发送完的任务
+     */
+    void showImage(FrameTask &task);
+
+    /**
+     * @brief 记录一帧各阶段的延迟, 开启 RUNNING_TIME 时定期打印统计结果
+     *
+     * @param stamp 已发送帧的时间戳
      */
-    void showImage();
+    void recordLatency(const FrameStamp &stamp);
 
     /**
      * @brief 自动匹配相机类型